@@ -293,6 +293,7 @@ enum {
   USB_REQ_LIMIT_VOLT   = 0x1A,
   USB_REQ_PULL         = 0x1B,
   USB_REQ_TEST_LEDS    = 0x1C,
+  USB_REQ_USB_FRAME    = 0x1D,
   // Cypress requests
   USB_REQ_CYPRESS_EEPROM_DB = 0xA9,
   // libfx2 requests
@@ -792,6 +793,26 @@ void handle_pending_usb_setup() {
     return;
   }
 
+  // USB frame number request
+  if(req_dir_in &&
+     req->bRequest == USB_REQ_USB_FRAME &&
+     req->wLength == 3) {
+    uint8_t frame_h;
+    pending_setup = false;
+
+    while(EP0CS & _BUSY);
+    // USBFRAMEL and USBFRAMEH are not latched together; if the frame number rolls over between
+    // reading the two halves, read them again.
+    do {
+      frame_h = USBFRAMEH;
+      EP0BUF[0] = USBFRAMEL;
+      EP0BUF[2] = MICROFRAME;
+    } while(frame_h != USBFRAMEH);
+    EP0BUF[1] = frame_h;
+    SETUP_EP0_BUF(3);
+    return;
+  }
+
   // Only used by old checkouts of software, can be removed.
   if(req_dir_in &&
      req->bRequest == USB_REQ_API_LEVEL &&
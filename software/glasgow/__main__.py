@@ -0,0 +1,20 @@
+import sys
+
+
+# This entry point is invoked when running `glasgow` or `python -m glasgow`. It is separate from
+# `glasgow.cli` so that the import profiler can be installed before the command line interface
+# and everything it depends on is imported.
+def run_main():
+    if "--profile-startup" in sys.argv[1:]:
+        from .support.import_profile import ImportProfiler
+        import_profiler = ImportProfiler()
+        import_profiler.install()
+    else:
+        import_profiler = None
+
+    from .cli import run_main
+    run_main(import_profiler=import_profiler)
+
+
+if __name__ == "__main__":
+    run_main()
@@ -17,7 +17,7 @@ __all__ = [
     "ClockingError",
     "PullState", "GlasgowPort", "GlasgowVio", "GlasgowPin",
     "AbstractRORegister", "AbstractRWRegister", "ClockDivisor",
-    "AbstractInPipe", "AbstractOutPipe", "AbstractInOutPipe",
+    "PipeTuning", "AbstractInPipe", "AbstractOutPipe", "AbstractInOutPipe",
     "AbstractAssembly"
 ]
 
@@ -200,6 +200,47 @@ class ClockDivisor:
         await self._register.set(divisor)
 
 
+@dataclass(frozen=True)
+class PipeTuning:
+    """Host-side transfer parameters of a pipe.
+
+    A pipe transfers data in USB transfers of ``packets_per_xfer`` packets, keeping up to
+    ``xfers_per_queue`` transfers in flight. Large transfers reduce CPU load and are necessary to
+    sustain high throughput, while small transfers reduce the latency of interactive protocols.
+    A value of ``None`` selects the default of the assembly.
+
+    If ``adaptive`` is set, the size of IN transfers starts at one packet and grows up to
+    ``packets_per_xfer`` packets while the device keeps filling them completely, shrinking back
+    when it does not. Each of the transfers in flight is resized independently.
+
+    The predefined profiles are available as ``"throughput"`` (the default), ``"latency"``,
+    and ``"adaptive"``; see :meth:`cast`.
+    """
+    packets_per_xfer: Optional[int] = None
+    xfers_per_queue:  Optional[int] = None
+    adaptive:         bool          = False
+
+    def __post_init__(self):
+        if self.packets_per_xfer is not None and self.packets_per_xfer < 1:
+            raise ValueError(f"packets per transfer must be positive, not {self.packets_per_xfer}")
+        if self.xfers_per_queue is not None and self.xfers_per_queue < 1:
+            raise ValueError(f"transfers per queue must be positive, not {self.xfers_per_queue}")
+
+    @classmethod
+    def cast(cls, value: 'PipeTuning | str | None') -> 'PipeTuning':
+        match value:
+            case None | "throughput":
+                return cls()
+            case "latency":
+                return cls(packets_per_xfer=4, xfers_per_queue=8)
+            case "adaptive":
+                return cls(adaptive=True)
+            case PipeTuning():
+                return value
+            case _:
+                raise ValueError(f"{value!r} is not a valid pipe tuning profile")
+
+
 class AbstractInPipe(metaclass=ABCMeta):
     @property
     @abstractmethod
@@ -210,6 +251,10 @@ class AbstractInPipe(metaclass=ABCMeta):
     async def recv(self, length) -> memoryview:
         pass
 
+    @abstractmethod
+    async def recv_into(self, buffer: bytearray | memoryview) -> int:
+        pass
+
     @abstractmethod
     async def reset(self):
         pass
@@ -310,18 +355,23 @@ class AbstractAssembly(metaclass=ABCMeta):
 
     @abstractmethod
     def add_in_pipe(self, in_stream, *, in_flush=C(1),
-                    fifo_depth=None, buffer_size=None) -> AbstractInPipe:
+                    fifo_depth=None, buffer_size=None, tuning=None) -> AbstractInPipe:
         pass
 
     @abstractmethod
     def add_out_pipe(self, out_stream, *,
-                     fifo_depth=None, buffer_size=None) -> AbstractOutPipe:
+                     fifo_depth=None, buffer_size=None, tuning=None) -> AbstractOutPipe:
         pass
 
     @abstractmethod
     def add_inout_pipe(self, in_stream, out_stream, *, in_flush=C(1),
-                       in_fifo_depth=None, in_buffer_size=None,
-                       out_fifo_depth=None, out_buffer_size=None) -> AbstractInOutPipe:
+                       in_fifo_depth=None, in_buffer_size=None, in_tuning=None,
+                       out_fifo_depth=None, out_buffer_size=None, out_tuning=None
+                       ) -> AbstractInOutPipe:
+        pass
+
+    @abstractmethod
+    def use_pipe_registers(self):
         pass
 
     @abstractmethod
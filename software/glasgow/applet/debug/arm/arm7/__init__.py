@@ -772,6 +772,9 @@ class DebugARM7Interface(GDBRemote):
         self._context  = None
         self._breakpts = {} # {(address, kind): saved_code}
 
+        # The core has no notion of which memory is RAM and which is MMIO; the user has to tell.
+        self.cacheable_memory = [] # [range(start, stop)]
+
     def _log(self, message, *args):
         self._logger.log(self._level, "ARM7: " + message, *args)
 
@@ -1110,6 +1113,10 @@ class DebugARM7Interface(GDBRemote):
         assert self._is_halted
         setattr(self._context, self.GDBRegister(number).name, value)
 
+    def target_memory_cacheable(self, address: int, length: int) -> bool:
+        return any(address in region and address + length <= region.stop
+                   for region in self.cacheable_memory)
+
     async def target_read_memory(self, address: int, length: int) -> bytes:
         assert self._is_halted
         # GDB server protocol doesn't require any particular access size or alignment, and notes
@@ -1132,23 +1139,27 @@ class DebugARM7Interface(GDBRemote):
                     length, address, data)
             return (data & mask).to_bytes(length, byteorder=self._endian)
         elif length > 0:
-            head_bytes = 4 - (address & 0x3) if address & 0x3 else 0
+            head_bytes = min(length, 4 - (address & 0x3) if address & 0x3 else 0)
             tail_bytes = (length - head_bytes) & 0x3
             mid_words  = (length - head_bytes - tail_bytes) // 4
+            # Words are transferred using every register except r0 (which holds the address) and
+            # r15, so that each system speed access (the slowest part of the sequence, requiring
+            # a restart and a poll) moves as much data as possible. The entire transfer is
+            # submitted as one transaction, with one round trip for all of the data.
             async with self.queue() as txn:
                 txn.a_ldr(0, address)                   # ldr  r0, <address>
                 if head_bytes > 0:
                     with txn.repeat(head_bytes):
                         txn.a_ldrb_sys(1, 0, 1)         # ldrb r1, [r0], #1
                         txn.a_str(1)                    # str  <data>, r1
-                if mid_words > 14:
+                if mid_words >= 14:
                     with txn.repeat(mid_words // 14):
                         txn.a_ldm_sys(0, 0x7ffe, w=1)   # ldm  r0!, {r1-r14}
                         txn.a_stm(0, 0x7ffe)            # stm  <data>, {r1-r14}
-                if mid_words > 0:
-                    with txn.repeat(mid_words % 14):
-                        txn.a_ldm_sys(0, 0x2, w=1)      # ldm  r0!, {r1}
-                        txn.a_str(1)                    # str  <data>, r1
+                if mid_words % 14 > 0:
+                    mask = ((1 << mid_words % 14) - 1) << 1
+                    txn.a_ldm_sys(0, mask, w=1)         # ldm  r0!, {r1-rN}
+                    txn.a_stm(0, mask)                  # stm  <data>, {r1-rN}
                 if tail_bytes > 0:
                     with txn.repeat(tail_bytes):
                         txn.a_ldrb_sys(1, 0, 1)         # ldrb r1, [r0], #1
@@ -1176,7 +1187,7 @@ class DebugARM7Interface(GDBRemote):
                     case 2: txn.a_strh_sys(1, 0)        # strh r1, [r0]
                     case 4: txn.a_stm_sys(0, 0x2)       # stm  r0, {r1}
         else:
-            head_bytes = 4 - (address & 0x3) if address & 0x3 else 0
+            head_bytes = min(len(data), 4 - (address & 0x3) if address & 0x3 else 0)
             tail_bytes = (len(data) - head_bytes) & 0x3
             mid_bytes  = (len(data) - head_bytes - tail_bytes)
             head_data  = data[:head_bytes]
@@ -1190,16 +1201,12 @@ class DebugARM7Interface(GDBRemote):
                 for byte in head_data:
                     txn.a_ldr(1, byte)                  # ldr  r1, <byte>
                     txn.a_strb_sys(1, 0, 1)             # strb r1, [r0], #1
-                index = 0
-                while index + 14 < len(mid_words):
+                # See comment in `target_read_memory()`.
+                for index in range(0, len(mid_words), 14):
                     chunk = mid_words[index:index + 14]
-                    txn.a_ldm(0, 0x7ffe, chunk)         # ldm  <chunk>, {r1-r14}
-                    txn.a_stm_sys(0, 0x7ffe, w=1)       # stm  r0!, {r1-r14}
-                    index += 14
-                while index < len(mid_words):
-                    txn.a_ldr(1, mid_words[index])      # ldr  r1, <word>
-                    txn.a_stm_sys(0, 0x2, w=1)          # stm  r0!, {r1}
-                    index += 1
+                    mask  = ((1 << len(chunk)) - 1) << 1
+                    txn.a_ldm(0, mask, chunk)           # ldm  <chunk>, {r1-rN}
+                    txn.a_stm_sys(0, mask, w=1)         # stm  r0!, {r1-rN}
                 for byte in tail_data:
                     txn.a_ldr(1, byte)                  # ldr  r1, <byte>
                     txn.a_strb_sys(1, 0, 1)             # strb r1, [r0], #1
@@ -1365,6 +1372,9 @@ class DebugARM7Applet(GlasgowAppletV2):
             return int(arg, 0)
         def length(arg):
             return int(arg, 0)
+        def memory_range(arg):
+            address, length = map(lambda x: int(x, 0), arg.split(","))
+            return range(address, address + length)
 
         p_operation = parser.add_subparsers(dest="operation", metavar="OPERATION", required=True)
 
@@ -1386,6 +1396,11 @@ class DebugARM7Applet(GlasgowAppletV2):
         p_gdb = p_operation.add_parser(
             "gdb", help="start a GDB remote protocol server")
         ServerEndpoint.add_argument(p_gdb, "gdb_endpoint", default="tcp::1234")
+        p_gdb.add_argument(
+            "--cache", metavar="ADDRESS,LENGTH", type=memory_range, action="append", default=[],
+            dest="cacheable_memory",
+            help="cache reads of LENGTH bytes of memory (not MMIO!) at ADDRESS while halted "
+                 "(may be repeated)")
 
     async def run(self, args):
         match args.operation:
@@ -1405,6 +1420,7 @@ class DebugARM7Applet(GlasgowAppletV2):
 
             case "gdb":
                 endpoint = await ServerEndpoint("GDB socket", self.logger, args.gdb_endpoint)
+                self.arm_iface.cacheable_memory = args.cacheable_memory
                 while True:
                     await self.arm_iface.gdb_run(endpoint)
                     if not self.arm_iface.target_running():
@@ -1,4 +1,7 @@
 import os
+import random
+import asyncio
+import logging
 import unittest
 
 from amaranth import *
@@ -8,8 +11,167 @@ from amaranth.lib import io, wiring
 from .....gateware.ports import PortGroup
 from .....gateware.stream import stream_get, stream_put
 from .....hardware.assembly import HardwareAssembly
+from .....simulation.assembly import ModelAssembly
 from .... import *
-from . import DebugARM7Applet, DebugARM7Sequencer
+from . import DebugARM7Applet, DebugARM7Sequencer, DebugARM7Opcode, DebugARM7Interface
+
+
+class _SimulatedARM7:
+    """Model of an ARM7TDMI core in debug state, at the level of sequencer commands.
+
+    Only the instructions used for memory accesses are implemented. The core is connected to
+    a single region of RAM, and counts the scans and system speed accesses it performs.
+    """
+
+    def __init__(self, base, size, endian):
+        self.base    = base
+        self.memory  = bytearray(size)
+        self.endian  = endian
+        self.regs    = [0] * 16
+        self.counts  = {opcode: 0 for opcode in DebugARM7Opcode}
+
+        self._skip   = 0     # pipeline refill after a debug speed load or store
+        self._loads  = []    # registers waiting for data on the bus
+        self._stores = []    # values waiting to be read from the bus
+        self._sys    = False # next instruction executes at system speed
+        self._insn   = None  # instruction to execute at system speed on restart
+        self._output = bytearray()
+
+    def _mem_slice(self, address, size):
+        offset = address - self.base
+        assert 0 <= offset and offset + size <= len(self.memory), \
+            f"access of size {size} at {address:#010x} is out of bounds"
+        return slice(offset, offset + size)
+
+    def _execute(self, insn, *, system=False):
+        rn, rt = (insn >> 16) & 0xf, (insn >> 12) & 0xf
+        if insn == 0xe1a08008: # mov r8, r8
+            pass
+        elif insn & 0x0e000000 == 0x08000000: # ldm/stm
+            regs = [reg for reg in range(16) if insn & (1 << reg)]
+            load, writeback = insn & (1 << 20), insn & (1 << 21)
+            if system:
+                address = self.regs[rn]
+                for reg in regs:
+                    span = self._mem_slice(address, 4)
+                    if load:
+                        self.regs[reg] = int.from_bytes(self.memory[span], self.endian)
+                    else:
+                        self.memory[span] = self.regs[reg].to_bytes(4, self.endian)
+                    address += 4
+                if writeback:
+                    self.regs[rn] = address
+            elif load:
+                self._skip, self._loads = 2, regs
+            else:
+                self._skip, self._stores = 2, [self.regs[reg] for reg in regs]
+        elif insn & 0x0c000000 == 0x04000000: # ldr/str/ldrb/strb
+            load, byte, imm = insn & (1 << 20), insn & (1 << 22), insn & 0xfff
+            if system:
+                assert byte and not insn & (1 << 24), "only post-indexed byte access is modelled"
+                span = self._mem_slice(self.regs[rn], 1)
+                if load:
+                    self.regs[rt] = self.memory[span][0]
+                else:
+                    self.memory[span] = bytes([self.regs[rt] & 0xff])
+                self.regs[rn] += imm
+            elif load:
+                assert rn == 15, "only literal loads are modelled at debug speed"
+                self._skip, self._loads = 2, [rt]
+            else:
+                self._skip, self._stores = 2, [self.regs[rt]]
+        elif insn & 0x0e0000f0 == 0x000000b0 and system: # ldrh/strh
+            load, imm = insn & (1 << 20), ((insn >> 4) & 0xf0) | (insn & 0xf)
+            span = self._mem_slice(self.regs[rn], 2)
+            if load:
+                self.regs[rt] = int.from_bytes(self.memory[span], self.endian)
+            else:
+                self.memory[span] = (self.regs[rt] & 0xffff).to_bytes(2, self.endian)
+            self.regs[rn] += imm
+        else:
+            assert False, f"instruction {insn:08x} is not modelled"
+
+    async def send(self, buffer):
+        buffer = bytearray(buffer)
+        while buffer:
+            header = buffer.pop(0)
+            opcode, arg = DebugARM7Opcode(header >> 5), header & 0x1f
+            self.counts[opcode] += 1
+            match opcode:
+                case DebugARM7Opcode.PUT_BUS:
+                    word = int.from_bytes(buffer[:4], "little")
+                    del buffer[:4]
+                    if self._skip:
+                        self._skip -= 1
+                    elif self._loads:
+                        self.regs[self._loads.pop(0)] = word
+                    elif self._sys:
+                        self._sys, self._insn = False, word
+                    else:
+                        self._execute(word)
+                        self._sys = bool(arg)
+                case DebugARM7Opcode.GET_BUS:
+                    self._output += self._stores.pop(0).to_bytes(4, "little")
+                case DebugARM7Opcode.RESTART:
+                    insn, self._insn = self._insn, None
+                    self._execute(insn, system=True)
+                case DebugARM7Opcode.POLL_ACK:
+                    pass
+                case _:
+                    assert False, f"command {opcode} is not modelled"
+
+    async def flush(self, **kwargs):
+        pass
+
+    async def recv(self, length):
+        data, self._output = self._output[:length], self._output[length:]
+        assert len(data) == length
+        return data
+
+
+class DebugARM7MemoryTestCase(unittest.TestCase):
+    base = 0x4000_0000
+
+    def setUp(self):
+        self.core  = _SimulatedARM7(self.base, 0x2000, "big")
+        self.iface = DebugARM7Interface(logging.getLogger(__name__),
+            ModelAssembly(self.core), tck=None, tms=None, tdo=None, tdi=None, endian="big")
+        self.iface._context = object() # halted
+
+    def test_read_write(self):
+        rng = random.Random(0)
+        for offset in range(4):
+            for length in (*range(13), 55, 56, 57, 60, 100):
+                with self.subTest(offset=offset, length=length):
+                    address = self.base + 0x100 + offset
+                    data = rng.randbytes(length)
+                    asyncio.run(self.iface.target_write_memory(address, data))
+                    self.assertEqual(self.core.memory[0x100 + offset:][:length], data)
+                    self.assertEqual(asyncio.run(self.iface.target_read_memory(address, length)),
+                                     data)
+
+    def test_throughput(self):
+        # Every word moved costs one bus scan, plus a share of the instructions and of the system
+        # speed access (restart and poll) that moves up to 14 words at once. The number of scans
+        # per word is what bounds the transfer rate over JTAG.
+        for words in (20, 1024):
+            with self.subTest(words=words):
+                data = random.Random(0).randbytes(words * 4)
+                accesses = -(-words // 14)
+
+                self.core.counts = {opcode: 0 for opcode in DebugARM7Opcode}
+                asyncio.run(self.iface.target_write_memory(self.base, data))
+                counts = self.core.counts
+                self.assertEqual(counts[DebugARM7Opcode.RESTART], accesses)
+                self.assertLessEqual(counts[DebugARM7Opcode.PUT_BUS], words + 10 * accesses + 5)
+
+                self.core.counts = {opcode: 0 for opcode in DebugARM7Opcode}
+                self.assertEqual(asyncio.run(self.iface.target_read_memory(self.base, len(data))),
+                                 data)
+                counts = self.core.counts
+                self.assertEqual(counts[DebugARM7Opcode.RESTART], accesses)
+                self.assertEqual(counts[DebugARM7Opcode.GET_BUS], words)
+                self.assertLessEqual(counts[DebugARM7Opcode.PUT_BUS], 9 * accesses + 5)
 
 
 class DebugARM7AppletTestCase(GlasgowAppletV2TestCase, applet=DebugARM7Applet):
@@ -57,7 +57,7 @@ class EJTAGDebugInterface(aobject, GDBRemote):
         self._impcode = DR_IMPCODE.from_bits(impcode_bits)
         self._log("read IMPCODE %s", self._impcode.bits_repr())
 
-    async def _exchange_control(self, **fields):
+    async def _shift_control(self, **fields):
         control = self._control.copy()
         control.PrAcc = 1
         if self._impcode.EJTAGver > 0:
@@ -72,8 +72,10 @@ class EJTAGDebugInterface(aobject, GDBRemote):
         control_bits = control.to_bits()
         await self.lower.write_ir(IR_CONTROL)
 
-        control_bits = await self.lower.exchange_dr(control_bits)
-        new_control = DR_CONTROL.from_bits(control_bits)
+        return control, await self.lower.exchange_dr(control_bits)
+
+    def _decode_control(self, control, control_bits):
+        new_control = DR_CONTROL.from_bits(bits(control_bits))
         self._log("read CONTROL %s", new_control.bits_repr(omit_zero=True))
 
         if self._impcode.EJTAGver > 0 and control.Rocc and new_control.Rocc:
@@ -81,6 +83,9 @@ class EJTAGDebugInterface(aobject, GDBRemote):
 
         return new_control
 
+    async def _exchange_control(self, **fields):
+        return self._decode_control(*await self._shift_control(**fields))
+
     async def _enable_probe(self):
         self._control.ProbEn   = 1
         self._control.ProbTrap = 1
@@ -96,14 +101,20 @@ class EJTAGDebugInterface(aobject, GDBRemote):
         assert self._address_length is not None
         self._log("scan ADDRESS length=%d", self._address_length)
 
-    async def _read_address(self):
+    async def _shift_address(self):
         await self.lower.write_ir(IR_ADDRESS)
-        address_bits = await self.lower.read_dr(self._address_length)
+        return await self.lower.read_dr(self._address_length)
+
+    def _decode_address(self, address_bits):
+        address_bits = bits(address_bits)
         address_bits = address_bits + address_bits[-1:] * (64 - self._address_length)
         address = int(address_bits) & self._mask
         self._log("read ADDRESS %#0.*x", self._prec, address)
         return address
 
+    async def _read_address(self):
+        return self._decode_address(await self._shift_address())
+
     async def _write_address(self, address):
         # See _read_address. NB: ADDRESS is only writable in EJTAG v1.x/2.0 with DMAAcc.
         self._log("write ADDRESS %#0.*x", self._prec, address)
@@ -251,7 +262,12 @@ class EJTAGDebugInterface(aobject, GDBRemote):
 
         for step in range(max_steps):
             for _ in range(3):
-                control = await self._exchange_control()
+                # ADDRESS is only meaningful once PrAcc is set, but reading it speculatively
+                # together with CONTROL saves a USB roundtrip on every processor access.
+                async with self.lower.queue():
+                    control_req, control_bits = await self._shift_control()
+                    address_bits = await self._shift_address()
+                control = self._decode_control(control_req, control_bits)
                 if step == 0 and not control.DM:
                     raise EJTAGError("Exec_PrAcc: DM low on entry")
                 elif not control.DM:
@@ -263,7 +279,7 @@ class EJTAGDebugInterface(aobject, GDBRemote):
             else:
                 raise EJTAGError("Exec_PrAcc: PrAcc stuck low")
 
-            address = await self._read_address()
+            address = self._decode_address(address_bits)
             if step > 0 and address == code_beg:
                 self._log("Exec_PrAcc: debug suspend")
                 self._change_state(suspend_state)
@@ -786,6 +802,11 @@ class EJTAGDebugInterface(aobject, GDBRemote):
         else:
             raise EJTAGError("setting register %d not supported" % number)
 
+    def target_memory_cacheable(self, address, length):
+        # KSEG0 is unmapped and cached; memory-mapped I/O is accessed through KSEG1 instead.
+        kseg0 = 0x8000_0000 if self._ws == 4 else 0xffff_ffff_8000_0000
+        return kseg0 <= address and address + length <= kseg0 + 0x2000_0000
+
     async def target_read_memory(self, address, length):
         self._check_state("read memory", "Stopped")
         if address % self._ws == 0 and length == self._ws:
@@ -10,11 +10,11 @@ from ... import *
 
 
 class AnalyzerSubtarget(Elaboratable):
-    def __init__(self, ports, in_fifo):
+    def __init__(self, ports, in_fifo, compress=False):
         self.ports   = ports
         self.in_fifo = in_fifo
 
-        self.analyzer = EventAnalyzer(in_fifo)
+        self.analyzer = EventAnalyzer(in_fifo, compress=compress)
         self.event_source = self.analyzer.add_event_source("pin", "change", len(self.ports.i))
 
     def elaborate(self, platform):
@@ -36,14 +36,17 @@ class AnalyzerSubtarget(Elaboratable):
 
 
 class AnalyzerInterface:
-    def __init__(self, interface, event_sources):
+    def __init__(self, interface, event_sources, compressed=False):
         self.lower   = interface
-        self.decoder = TraceDecoder(event_sources)
+        self.decoder = TraceDecoder(event_sources, compressed=compressed)
 
     async def read(self):
         self.decoder.process(await self.lower.read())
         return self.decoder.flush()
 
+    async def read_columns(self):
+        return self.decoder.process_columns(await self.lower.read())
+
 
 class AnalyzerApplet(GlasgowApplet):
     logger = logging.getLogger(__name__)
@@ -61,16 +64,24 @@ class AnalyzerApplet(GlasgowApplet):
         parser.add_argument(
             "--pin-names", metavar="NAMES", dest="names", default=None,
             help="optional comma separated list of pin names")
+        parser.add_argument(
+            "--compress", default=False, action="store_true",
+            help="compress repetitive waveforms (such as clocks) in gateware, to capture them "
+                 "at higher rates without overrunning the FIFO; waveforms that repeat less often "
+                 "than every 65536 cycles are not compressed, and waveforms that do not repeat "
+                 "are captured at a somewhat lower rate")
 
     def build(self, target, args):
         self.mux_interface = iface = target.multiplexer.claim_interface(self, args)
         subtarget = iface.add_subtarget(AnalyzerSubtarget(
             ports=iface.get_port_group(i = args.i),
             in_fifo=iface.get_in_fifo(),
+            compress=args.compress,
         ))
 
         self._sample_freq = target.sys_clk_freq
         self._event_sources = subtarget.analyzer.event_sources
+        self._compressed = args.compress
 
     @classmethod
     def add_run_arguments(cls, parser, access):
@@ -93,7 +104,7 @@ class AnalyzerApplet(GlasgowApplet):
             pull_low = set(args.i)
         iface = await device.demultiplexer.claim_interface(self, self.mux_interface, args,
                                                            pull_low=pull_low, pull_high=pull_high)
-        return AnalyzerInterface(iface, self._event_sources)
+        return AnalyzerInterface(iface, self._event_sources, compressed=self._compressed)
 
     @classmethod
     def add_interact_arguments(cls, parser):
@@ -117,23 +128,28 @@ class AnalyzerApplet(GlasgowApplet):
                 var_type="wire", size=1, init=0))
 
         try:
-            overrun = False
             timestamp = 0
-            while not overrun:
-                for cycle, events in await iface.read():
+            value = 0
+            while not iface.decoder.is_done():
+                columns = await iface.read_columns()
+                for cycle, source, new_value in \
+                        zip(columns.timestamps, columns.sources, columns.values):
+                    if source == TraceColumns.THROTTLE:
+                        continue
                     timestamp = cycle * 1_000_000_000 // self._sample_freq
-
-                    if events == "overrun":
-                        self.logger.error("FIFO overrun, shutting down")
-                        for signal in signals:
-                            vcd_writer.change(signal, timestamp, "x")
-                        overrun = True
-                        break
-
-                    if "pin" in events: # could be also "throttle"
-                        value = events["pin"]
-                        for bit, signal in enumerate(signals):
-                            vcd_writer.change(signal, timestamp, (value >> bit) & 1)
+                    # only emit the pins that have changed; the rest would be ignored by the VCD
+                    # writer anyway
+                    changed, value = value ^ new_value, new_value
+                    while changed:
+                        bit = changed.bit_length() - 1
+                        vcd_writer.change(signals[bit], timestamp, (value >> bit) & 1)
+                        changed &= ~(1 << bit)
+
+            if iface.decoder.is_overrun():
+                timestamp = iface.decoder.timestamp * 1_000_000_000 // self._sample_freq
+                self.logger.error("FIFO overrun, shutting down")
+                for signal in signals:
+                    vcd_writer.change(signal, timestamp, "x")
 
         finally:
             vcd_writer.close(timestamp)
@@ -6,3 +6,7 @@ class AnalyzerAppletTestCase(GlasgowAppletTestCase, applet=AnalyzerApplet):
     @synthesis_test
     def test_build(self):
         self.assertBuilds()
+
+    @synthesis_test
+    def test_build_compress(self):
+        self.assertBuilds(args=["--compress"])
@@ -22,11 +22,13 @@
 import struct
 import logging
 import argparse
+import contextlib
 import enum
 from amaranth import *
 from amaranth.lib import io, cdc
 
 from ....support.bits import *
+from ....support.lazy import *
 from ....support.logging import *
 from ....support.arepl import *
 from ....database.jedec import *
@@ -324,6 +326,7 @@ class JTAGProbeInterface:
         self.has_trst    = has_trst
         self._state      = JTAGState.UNKNOWN
         self._current_ir = None
+        self._queue      = None # [(bit counts, resolve)] while queueing
 
     def _log_l(self, message, *args):
         self._logger.log(self._level, "JTAG-L: " + message, *args)
@@ -331,12 +334,89 @@ class JTAGProbeInterface:
     def _log_h(self, message, *args):
         self._logger.log(self._level, "JTAG-H: " + message, *args)
 
+    def _log_h_result(self, message, *args):
+        # Within a `queue()` block, the results are logged once their placeholders are resolved.
+        if self._queue is None:
+            self._log_h(message, *args)
+        else:
+            self._queue.append(((), lambda tdo_bits: self._log_h(message, *args)))
+
     # Low-level operations
 
     async def flush(self):
         self._log_l("flush")
         await self.lower.flush()
 
+    # Within an `async with iface.queue():` block, operations that read TDO (or aux) data do not
+    # wait for it to arrive. Instead, they return a `lazy` placeholder, and the commands keep
+    # accumulating in the OUT buffer. When the block is exited, everything is submitted at once,
+    # and all of the placeholders are resolved after a single USB roundtrip. The placeholders must
+    # not be used until then. Nested blocks are merely re-entrant: their placeholders are resolved
+    # together with those of the outermost block, when it is exited.
+
+    @contextlib.asynccontextmanager
+    async def queue(self):
+        is_outer = self._queue is None
+        if is_outer:
+            self._log_l("queue")
+            self._queue = []
+        try:
+            yield
+        finally:
+            if is_outer:
+                try:
+                    await self._resolve_queue()
+                finally:
+                    self._queue = None
+
+    async def resolve_queue(self):
+        """Submit the commands issued so far within a :meth:`queue` block, and resolve their
+        placeholders, without leaving the block."""
+        assert self._queue is not None, "resolve_queue() called outside of a queue() block"
+        await self._resolve_queue()
+
+    async def _resolve_queue(self):
+        pending = self._queue[:]
+        self._queue.clear()
+        if not pending:
+            return
+        self._log_l("resolve count=%d", sum(1 for counts, _ in pending if counts))
+        tdo_length = sum((count + 7) // 8 for counts, _ in pending for count in counts)
+        tdo_bytes = bytes(await self.lower.read(tdo_length)) if tdo_length else b""
+        offset = 0
+        for counts, resolve in pending:
+            tdo_bits = bits()
+            for count in counts:
+                tdo_bits += bits(tdo_bytes[offset:offset + (count + 7) // 8], count)
+                offset += (count + 7) // 8
+            resolve(tdo_bits)
+
+    @contextlib.asynccontextmanager
+    async def _immediate(self):
+        # Operations that branch on data read from the target cannot be queued.
+        queue = self._queue
+        if queue is not None:
+            await self._resolve_queue()
+            self._queue = None
+        try:
+            yield
+        finally:
+            self._queue = queue
+
+    async def _read_bits(self, counts, finish):
+        if self._queue is None:
+            tdo_bits = bits()
+            for count in counts:
+                tdo_bits += bits(await self.lower.read((count + 7) // 8), count)
+            return finish(tdo_bits)
+        else:
+            result = []
+            self._queue.append((counts, lambda tdo_bits: result.append(finish(tdo_bits))))
+            def get():
+                assert result, "Attempted to use TDO data before submitting the queue"
+                return result[0]
+            return lazy(get)
+
     async def set_aux(self, value):
         self._log_l("set aux=%s", format(value, "08b"))
         await self.lower.write(struct.pack("<BB",
@@ -345,9 +425,11 @@ class JTAGProbeInterface:
     async def get_aux(self):
         await self.lower.write(struct.pack("<B",
             CMD_GET_AUX))
-        value, = await self.lower.read(1)
-        self._log_l("get aux=%s", format(value, "08b"))
-        return value
+        def finish(value_bits):
+            value = int(value_bits)
+            self._log_l("get aux=%s", format(value, "08b"))
+            return value
+        return await self._read_bits([8], finish)
 
     async def set_trst(self, active):
         if not self.has_trst:
@@ -399,21 +481,22 @@ class JTAGProbeInterface:
     async def shift_tdio(self, tdi_bits, *, prefix=0, suffix=0, last=True):
         assert self._state in (JTAGState.IRSHIFT, JTAGState.DRSHIFT)
         tdi_bits = bits(tdi_bits)
-        tdo_bits = bits()
         self._log_l("shift tdio-i=%d,<%s>,%d", prefix, dump_bin(tdi_bits), suffix)
         await self._shift_dummy(prefix)
+        counts = []
         for tdi_bits, chunk_last in self._chunk_bits(tdi_bits, last and suffix == 0):
             await self.lower.write(struct.pack("<BH",
                 CMD_SHIFT_TDIO|BIT_DATA_IN|BIT_DATA_OUT|(BIT_LAST if chunk_last else 0),
                 len(tdi_bits)))
             tdi_bytes = bytes(tdi_bits)
             await self.lower.write(tdi_bytes)
-            tdo_bytes = await self.lower.read(len(tdi_bytes))
-            tdo_bits += bits(tdo_bytes, len(tdi_bits))
+            counts.append(len(tdi_bits))
         await self._shift_dummy(suffix, last)
-        self._log_l("shift tdio-o=%d,<%s>,%d", prefix, dump_bin(tdo_bits), suffix)
         self._shift_last(last)
-        return tdo_bits
+        def finish(tdo_bits):
+            self._log_l("shift tdio-o=%d,<%s>,%d", prefix, dump_bin(tdo_bits), suffix)
+            return tdo_bits
+        return await self._read_bits(counts, finish)
 
     async def shift_tdi(self, tdi_bits, *, prefix=0, suffix=0, last=True):
         assert self._state in (JTAGState.IRSHIFT, JTAGState.DRSHIFT)
@@ -431,18 +514,19 @@ class JTAGProbeInterface:
 
     async def shift_tdo(self, count, *, prefix=0, suffix=0, last=True):
         assert self._state in (JTAGState.IRSHIFT, JTAGState.DRSHIFT)
-        tdo_bits = bits()
         await self._shift_dummy(prefix)
+        counts = []
         for count, chunk_last in self._chunk_count(count, last and suffix == 0):
             await self.lower.write(struct.pack("<BH",
                 CMD_SHIFT_TDIO|BIT_DATA_IN|(BIT_LAST if chunk_last else 0),
                 count))
-            tdo_bytes = await self.lower.read((count + 7) // 8)
-            tdo_bits += bits(tdo_bytes, count)
+            counts.append(count)
         await self._shift_dummy(suffix, last)
-        self._log_l("shift tdo=%d,<%s>,%d", prefix, dump_bin(tdo_bits), suffix)
         self._shift_last(last)
-        return tdo_bits
+        def finish(tdo_bits):
+            self._log_l("shift tdo=%d,<%s>,%d", prefix, dump_bin(tdo_bits), suffix)
+            return tdo_bits
+        return await self._read_bits(counts, finish)
 
     async def pulse_tck(self, count):
         assert self._state in (JTAGState.IDLE, JTAGState.IRPAUSE, JTAGState.DRPAUSE)
@@ -648,7 +732,7 @@ class JTAGProbeInterface:
             await self.enter_shift_ir()
             data = await self.shift_tdio(data, prefix=prefix, suffix=suffix)
         await self.enter_update_ir()
-        self._log_h("exchange ir-o=%d,<%s>,%d", prefix, dump_bin(data), suffix)
+        self._log_h_result("exchange ir-o=%d,<%s>,%d", prefix, dump_bin(data), suffix)
         return data
 
     async def read_ir(self, count, *, prefix=0, suffix=0):
@@ -660,7 +744,7 @@ class JTAGProbeInterface:
             await self.enter_shift_ir()
             data = await self.shift_tdo(count, prefix=prefix, suffix=suffix)
         await self.enter_update_ir()
-        self._log_h("read ir=%d,<%s>,%d", prefix, dump_bin(data), suffix)
+        self._log_h_result("read ir=%d,<%s>,%d", prefix, dump_bin(data), suffix)
         return data
 
     async def write_ir(self, data, *, prefix=0, suffix=0, elide=True):
@@ -686,7 +770,7 @@ class JTAGProbeInterface:
             await self.enter_shift_dr()
             data = await self.shift_tdio(data, prefix=prefix, suffix=suffix)
         await self.enter_update_dr()
-        self._log_h("exchange dr-o=%d,<%s>,%d", prefix, dump_bin(data), suffix)
+        self._log_h_result("exchange dr-o=%d,<%s>,%d", prefix, dump_bin(data), suffix)
         return data
 
     async def read_dr(self, count, *, prefix=0, suffix=0):
@@ -697,7 +781,7 @@ class JTAGProbeInterface:
             await self.enter_shift_dr()
             data = await self.shift_tdo(count, prefix=prefix, suffix=suffix)
         await self.enter_update_dr()
-        self._log_h("read dr=%d,<%s>,%d", prefix, dump_bin(data), suffix)
+        self._log_h_result("read dr=%d,<%s>,%d", prefix, dump_bin(data), suffix)
         return data
 
     async def write_dr(self, data, *, prefix=0, suffix=0):
@@ -713,6 +797,11 @@ class JTAGProbeInterface:
     # Shift chain introspection
 
     async def _scan_xr(self, xr, *, max_length=None, check=True, idempotent=True):
+        async with self._immediate():
+            return await self._scan_xr_immediate(xr,
+                max_length=max_length, check=check, idempotent=idempotent)
+
+    async def _scan_xr_immediate(self, xr, *, max_length, check, idempotent):
         assert xr in ("ir", "dr")
         if idempotent:
             self._log_h("scan %s idempotent", xr)
@@ -935,6 +1024,9 @@ class TAPInterface:
     async def flush(self):
         await self.lower.flush()
 
+    def queue(self):
+        return self.lower.queue()
+
     async def test_reset(self):
         await self.lower.test_reset()
 
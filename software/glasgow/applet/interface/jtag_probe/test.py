@@ -1,8 +1,12 @@
+import struct
+import asyncio
+import logging
 import unittest
 
 from ....support.bits import *
 from ... import *
 from . import JTAGProbeApplet, JTAGProbeInterface, JTAGProbeError
+from . import CMD_MASK, CMD_SHIFT_TMS, CMD_SHIFT_TDIO, CMD_GET_AUX, BIT_DATA_OUT, BIT_DATA_IN
 
 
 class JTAGInterrogationTestCase(unittest.TestCase):
@@ -125,6 +129,126 @@ class JTAGInterrogationTestCase(unittest.TestCase):
                          [3, 5])
 
 
+class _LoopbackInterface:
+    # Connects TDI to TDO, and counts the number of times data has been read.
+    def __init__(self):
+        self.reads  = 0
+        self._out   = bytearray()
+        self._in    = bytearray()
+
+    async def write(self, data):
+        self._out += bytes(data)
+
+    async def flush(self):
+        while self._out:
+            cmd = self._out.pop(0)
+            if cmd & CMD_MASK in (CMD_SHIFT_TMS, CMD_SHIFT_TDIO):
+                count, = struct.unpack("<H", self._out[:2])
+                del self._out[:2]
+                data = bytes((count + 7) // 8)
+                if cmd & BIT_DATA_OUT:
+                    data = bytes(self._out[:len(data)])
+                    del self._out[:len(data)]
+                if cmd & CMD_MASK == CMD_SHIFT_TDIO and cmd & BIT_DATA_IN:
+                    self._in += data
+            elif cmd & CMD_MASK == CMD_GET_AUX:
+                self._in.append(0x5a)
+            else:
+                del self._out[:1]
+
+    async def read(self, length):
+        await self.flush()
+        self.reads += 1
+        data, self._in = bytes(self._in[:length]), self._in[length:]
+        assert len(data) == length
+        return data
+
+
+class JTAGQueueTestCase(unittest.TestCase):
+    def setUp(self):
+        self.lower = _LoopbackInterface()
+        self.iface = JTAGProbeInterface(interface=self.lower, logger=JTAGProbeApplet.logger)
+
+    def run_async(self, coro):
+        asyncio.new_event_loop().run_until_complete(coro)
+
+    def test_immediate(self):
+        async def case():
+            await self.iface.test_reset()
+            self.assertEqual(await self.iface.exchange_dr(bits("10110")), bits("10110"))
+            self.assertEqual(await self.iface.read_dr(4), bits("0000"))
+            self.assertEqual(self.lower.reads, 2)
+        self.run_async(case())
+
+    def test_queue(self):
+        async def case():
+            await self.iface.test_reset()
+            async with self.iface.queue():
+                data_1 = await self.iface.exchange_ir(bits("1101"))
+                data_2 = await self.iface.exchange_dr(bits("0" * 70000 + "1"))
+                data_3 = await self.iface.get_aux()
+                data_4 = await self.iface.exchange_dr(bits("011"))
+                self.assertEqual(self.lower.reads, 0)
+            self.assertEqual(self.lower.reads, 1)
+            self.assertEqual(data_1, bits("1101"))
+            self.assertEqual(data_2, bits("0" * 70000 + "1"))
+            self.assertEqual(data_3, 0x5a)
+            self.assertEqual(data_4, bits("011"))
+        self.run_async(case())
+
+    def test_queue_unresolved(self):
+        async def case():
+            await self.iface.test_reset()
+            async with self.iface.queue():
+                data = await self.iface.exchange_dr(bits("1"))
+                with self.assertRaisesRegex(AssertionError,
+                        r"^Attempted to use TDO data before submitting the queue$"):
+                    int(data)
+        self.run_async(case())
+
+    def test_queue_scan(self):
+        async def case():
+            await self.iface.test_reset()
+            async with self.iface.queue():
+                data_1 = await self.iface.exchange_dr(bits("0110"))
+                # Scanning needs the data immediately, so the queue is resolved first.
+                self.assertEqual(len(await self.iface.scan_dr(check=False)), 0)
+                self.assertEqual(int(data_1), 0b0110)
+                data_2 = await self.iface.exchange_dr(bits("1"))
+            self.assertEqual(data_2, bits("1"))
+        self.run_async(case())
+
+    def test_queue_nested(self):
+        async def case():
+            await self.iface.test_reset()
+            async with self.iface.queue():
+                data_1 = await self.iface.exchange_dr(bits("0110"))
+                async with self.iface.queue():
+                    data_2 = await self.iface.exchange_dr(bits("1"))
+                # Nested blocks are resolved together with the outermost one.
+                self.assertEqual(self.lower.reads, 0)
+            self.assertEqual(self.lower.reads, 1)
+            self.assertEqual(data_1, bits("0110"))
+            self.assertEqual(data_2, bits("1"))
+        self.run_async(case())
+
+    def test_queue_log(self):
+        async def case():
+            await self.iface.test_reset()
+            with self.assertLogs(JTAGProbeApplet.logger, level=logging.DEBUG) as logs:
+                async with self.iface.queue():
+                    await self.iface.exchange_dr(bits("0110"))
+                    await self.iface.read_dr(4)
+                    self.assertNotIn("dr-o", "".join(logs.output))
+            messages = [record.getMessage() for record in logs.records]
+            resolved = messages[messages.index("JTAG-L: resolve count=2"):]
+            self.assertEqual([message for message in resolved if message.startswith("JTAG-H")], [
+                "JTAG-H: exchange dr-o=0,<0110>,0",
+                "JTAG-H: read dr=0,<0000>,0",
+            ])
+        self.run_async(case())
+
+
 class JTAGProbeAppletTestCase(GlasgowAppletTestCase, applet=JTAGProbeApplet):
     @synthesis_test
     def test_build(self):
@@ -3,6 +3,7 @@
 # Ref: http://www.jtagtest.com/pdf/svf_specification.pdf
 # Accession: G00023
 
+import mmap
 import struct
 import logging
 import argparse
@@ -44,6 +45,10 @@ class SVFOperation:
 
 
 class SVFInterface(SVFEventHandler):
+    # Amount of data that may be shifted (whether its TDO is compared or not) before the queued
+    # commands are submitted and their results checked.
+    max_queued_bits = 1 << 20
+
     def __init__(self, interface, logger, frequency):
         self.lower   = interface
         self._logger = logger
@@ -58,6 +63,11 @@ class SVFInterface(SVFEventHandler):
         self._hdr    = SVFOperation()
         self._tdr    = SVFOperation()
 
+        self._position     = None
+        self._line_column  = None
+        self._pending      = [] # [(command, position, tdo, op)]
+        self._queued_bits  = 0
+
     def _log(self, message, *args, level=None):
         self._logger.log(self._level if level is None else level, "SVF: " + message, *args)
 
@@ -220,28 +230,39 @@ class SVFInterface(SVFEventHandler):
     async def svf_tdr(self, tdi, smask, tdo, mask):
         self._tdr = SVFOperation(tdi, smask, tdo, mask)
 
-    async def svf_sir(self, tdi, smask, tdo, mask):
-        op = self._hir + SVFOperation(tdi, smask, tdo, mask) + self._tir
-        await self.lower.enter_shift_ir()
+    def _defer_check(self, command, tdo, op):
+        self._pending.append((command, self._position, tdo, op))
+
+    def _check(self):
+        pending, self._pending, self._queued_bits = self._pending, [], 0
+        for command, position, tdo, op in pending:
+            if tdo & op.mask != op.tdo & op.mask:
+                raise SVFError("%s command at line %d, column %d failed: TDO <%s> & <%s> != <%s>"
+                               % (command, *self._line_column(position),
+                                  dump_bin(bits(tdo)), dump_bin(op.mask), dump_bin(op.tdo)))
+
+    async def _shift(self, command, op):
         if op.tdo is None:
+            if self._pending:
+                # A shift that is not checked usually changes the state of the target (e.g. erases
+                # or programs it); only do that once the checks before it (e.g. of IDCODE) pass.
+                await self.lower.resolve_queue()
+                self._check()
             await self.lower.shift_tdi(op.tdi)
         else:
-            tdo = await self.lower.shift_tdio(op.tdi)
-            if tdo & op.mask != op.tdo & op.mask:
-                raise SVFError("SIR command failed: TDO <%s> & <%s> != <%s>"
-                               % (dump_bin(tdo), dump_bin(op.mask), dump_bin(op.tdo)))
+            self._defer_check(command, await self.lower.shift_tdio(op.tdi), op)
+        self._queued_bits += len(op.tdi)
+
+    async def svf_sir(self, tdi, smask, tdo, mask):
+        op = self._hir + SVFOperation(tdi, smask, tdo, mask) + self._tir
+        await self.lower.enter_shift_ir()
+        await self._shift("SIR", op)
         await self._enter_state(self._endir)
 
     async def svf_sdr(self, tdi, smask, tdo, mask):
         op = self._hdr + SVFOperation(tdi, smask, tdo, mask) + self._tdr
         await self.lower.enter_shift_dr()
-        if op.tdo is None:
-            await self.lower.shift_tdi(op.tdi)
-        else:
-            tdo = await self.lower.shift_tdio(op.tdi)
-            if tdo & op.mask != op.tdo & op.mask:
-                raise SVFError("SDR command failed: TDO <%s> & <%s> != <%s>"
-                               % (dump_bin(tdo), dump_bin(op.mask), dump_bin(op.tdo)))
+        await self._shift("SDR", op)
         await self._enter_state(self._enddr)
 
     async def svf_runtest(self, run_state, run_count, run_clock, min_time, max_time, end_state):
@@ -263,6 +284,38 @@ class SVFInterface(SVFEventHandler):
     async def svf_pio(self, vector):
         raise SVFError("the PIO command is not supported")
 
+    async def play(self, parser):
+        """Play every command from ``parser``.
+
+        The commands are queued and submitted to the probe in batches; comparisons of TDO data
+        are performed once the results for the entire batch arrive. This lets the host parse
+        the next commands while the probe is still shifting the previous ones. A batch ends early
+        at a shift whose TDO is not compared that follows one whose TDO is, so that a failed
+        comparison stops playback before the target is e.g. erased or programmed.
+        """
+        self._line_column = parser.line_column
+        done = False
+        while not done:
+            try:
+                async with self.lower.queue():
+                    while self._queued_bits < self.max_queued_bits:
+                        coro = parser.parse_command()
+                        if not coro:
+                            done = True
+                            break
+
+                        self._position = parser.last_command_position()
+                        for line in parser.last_command().split("\n"):
+                            line = line.strip()
+                            if line: self._log(line)
+
+                        await coro
+            except SVFError:
+                # A comparison that failed earlier is the more relevant error.
+                self._check()
+                raise
+            self._check()
+
 
 class JTAGSVFApplet(JTAGProbeApplet):
     logger = logging.getLogger(__name__)
@@ -285,17 +338,14 @@ class JTAGSVFApplet(JTAGProbeApplet):
     @classmethod
     def add_interact_arguments(cls, parser):
         parser.add_argument(
-            "svf_file", metavar="SVF-FILE", type=argparse.FileType("r"),
+            "svf_file", metavar="SVF-FILE", type=argparse.FileType("rb"),
             help="test vector to play")
 
     async def interact(self, device, args, svf_iface):
-        svf_parser = SVFParser(args.svf_file.read(), svf_iface)
-        while True:
-            coro = svf_parser.parse_command()
-            if not coro: break
-
-            for line in svf_parser.last_command().split("\n"):
-                line = line.strip()
-                if line: svf_iface._log(line)
-
-            await coro
+        try:
+            # Test vectors for large devices can be hundreds of megabytes in size; the lexer
+            # works directly on the memory-mapped file, only touching it as it advances.
+            svf_buffer = mmap.mmap(args.svf_file.fileno(), 0, access=mmap.ACCESS_READ)
+        except (OSError, ValueError): # not a regular file (e.g. a pipe), or an empty one
+            svf_buffer = args.svf_file.read()
+        await svf_iface.play(SVFParser(svf_buffer, svf_iface))
@@ -0,0 +1,50 @@
+import asyncio
+import unittest
+
+from ....protocol.jtag_svf import SVFParser
+from ..jtag_probe import JTAGProbeInterface
+from ..jtag_probe.test import _LoopbackInterface
+from . import SVFError, SVFInterface, JTAGSVFApplet
+
+
+class _RecordingInterface(_LoopbackInterface):
+    # Connects TDI to TDO, and records everything that is sent to the probe.
+    def __init__(self):
+        super().__init__()
+        self.sent = bytearray()
+
+    async def write(self, data):
+        self.sent += bytes(data)
+        await super().write(data)
+
+
+class SVFInterfaceTestCase(unittest.TestCase):
+    def setUp(self):
+        self.lower = _RecordingInterface()
+        self.iface = SVFInterface(
+            JTAGProbeInterface(interface=self.lower, logger=JTAGSVFApplet.logger),
+            JTAGSVFApplet.logger, frequency=1e6)
+
+    def play(self, svf):
+        asyncio.new_event_loop().run_until_complete(self.iface.play(SVFParser(svf, self.iface)))
+
+    def test_check_pass(self):
+        self.play("STATE RESET;\n"
+                  "SDR 8 TDI (5a) TDO (5a);\n"
+                  "SDR 32 TDI (deadbeef);\n")
+        self.assertIn(b"\xef\xbe\xad\xde", self.lower.sent)
+        self.assertEqual(self.lower.reads, 1)
+
+    def test_check_fail_before_write(self):
+        with self.assertRaisesRegex(SVFError,
+                r"^SDR command at line 2, column 1 failed: "):
+            self.play("STATE RESET;\n"
+                      "SDR 8 TDI (00) TDO (ff);\n"
+                      "SDR 32 TDI (deadbeef);\n")
+        self.assertNotIn(b"\xef\xbe\xad\xde", self.lower.sent)
+
+    def test_batch_size(self):
+        self.iface.max_queued_bits = 64
+        self.play("STATE RESET;\n" +
+                  "SDR 32 TDI (00000000) TDO (00000000);\n" * 3)
+        self.assertEqual(self.lower.reads, 2)
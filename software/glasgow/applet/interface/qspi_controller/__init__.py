@@ -6,14 +6,15 @@ import struct
 from amaranth import *
 from amaranth.lib import enum, data, wiring, stream, io
 from amaranth.lib.wiring import In, Out, connect, flipped
+from amaranth.lib.crc.catalog import CRC32_ISO_HDLC
 
 from glasgow.support.logging import dump_hex
 from glasgow.gateware import qspi
 from glasgow.abstract import AbstractAssembly, ClockDivisor
-from glasgow.applet import GlasgowAppletV2
+from glasgow.applet import GlasgowAppletError, GlasgowAppletV2
 
 
-__all__ = ["QSPIControllerComponent", "QSPIControllerInterface"]
+__all__ = ["QSPIControllerComponent", "QSPIControllerError", "QSPIControllerInterface"]
 
 
 class QSPICommand(enum.Enum, shape=4):
@@ -21,6 +22,17 @@ class QSPICommand(enum.Enum, shape=4):
     Transfer = 1
     Delay    = 2
     Sync     = 3
+    Poll     = 4
+    Digest   = 5
+
+
+class QSPIPollStatus(enum.Enum, shape=8):
+    Done    = 0
+    Timeout = 1
+
+
+class QSPIControllerError(GlasgowAppletError):
+    pass
 
 
 class QSPIControllerComponent(wiring.Component):
@@ -46,6 +58,10 @@ class QSPIControllerComponent(wiring.Component):
             offset=1 if self._offset is None else self._offset)
         m.d.comb += ctrl.divisor.eq(self.divisor)
 
+        m.submodules.crc = crc = CRC32_ISO_HDLC(data_width=8).create()
+        crc_start  = Signal(init=1)
+        crc_finish = Signal()
+
         command = Signal(QSPICommand)
         chip    = Signal(range(1 + len(self._ports.cs)))
         mode    = Signal(qspi.Mode)
@@ -56,6 +72,11 @@ class QSPIControllerComponent(wiring.Component):
         o_count = Signal(16)
         i_count = Signal(16)
         timer   = Signal(range(self._us_cycles))
+        p_cmd   = Signal(8)
+        p_mask  = Signal(8)
+        p_data  = Signal(8)
+        p_left  = Signal(32)
+        p_stat  = Signal(QSPIPollStatus)
         with m.FSM():
             with m.State("Read-Command"):
                 m.d.comb += self.o_flush.eq(1)
@@ -73,6 +94,35 @@ class QSPIControllerComponent(wiring.Component):
                             m.next = "Read-Count-0:8"
                         with m.Case(QSPICommand.Sync):
                             m.next = "Sync"
+                        with m.Case(QSPICommand.Poll):
+                            m.d.sync += chip.eq(self.i_stream.payload[:4])
+                            m.next = "Read-Poll-Command"
+                        with m.Case(QSPICommand.Digest):
+                            m.d.sync += mode.eq(self.i_stream.payload[:3])
+                            m.d.sync += crc_finish.eq(self.i_stream.payload[3])
+                            m.next = "Read-Count-0:8"
+
+            with m.State("Read-Poll-Command"):
+                m.d.comb += self.i_stream.ready.eq(1)
+                with m.If(self.i_stream.valid):
+                    m.d.sync += p_cmd.eq(self.i_stream.payload)
+                    m.next = "Read-Poll-Mask"
+
+            with m.State("Read-Poll-Mask"):
+                m.d.comb += self.i_stream.ready.eq(1)
+                with m.If(self.i_stream.valid):
+                    m.d.sync += p_mask.eq(self.i_stream.payload)
+                    m.next = "Read-Poll-Limit-0:8"
+
+            for offset in range(0, 32, 8):
+                with m.State(f"Read-Poll-Limit-{offset}:{offset + 8}"):
+                    m.d.comb += self.i_stream.ready.eq(1)
+                    with m.If(self.i_stream.valid):
+                        m.d.sync += p_left[offset:offset + 8].eq(self.i_stream.payload)
+                        if offset + 8 < 32:
+                            m.next = f"Read-Poll-Limit-{offset + 8}:{offset + 16}"
+                        else:
+                            m.next = "Read-Count-0:8"
 
             with m.State("Read-Count-0:8"):
                 m.d.comb += self.i_stream.ready.eq(1)
@@ -87,10 +137,12 @@ class QSPIControllerComponent(wiring.Component):
                     m.d.sync += o_count[8:16].eq(self.i_stream.payload)
                     m.d.sync += i_count[8:16].eq(self.i_stream.payload)
                     with m.Switch(command):
-                        with m.Case(QSPICommand.Transfer):
+                        with m.Case(QSPICommand.Transfer, QSPICommand.Digest):
                             m.next = "Transfer"
                         with m.Case(QSPICommand.Delay):
                             m.next = "Delay"
+                        with m.Case(QSPICommand.Poll):
+                            m.next = "Poll-Put"
 
             with m.State("Transfer"):
                 m.d.comb += [
@@ -108,13 +160,27 @@ class QSPIControllerComponent(wiring.Component):
                     with m.If(ctrl.i_stream.valid & ctrl.i_stream.ready):
                         m.d.sync += o_count.eq(o_count - 1)
                 with m.If(i_count != 0):
-                    with m.If(is_get):
+                    with m.If(is_get & (command == QSPICommand.Digest)):
+                        # Received octets are consumed by the CRC instead of being sent out.
+                        m.d.comb += ctrl.o_stream.ready.eq(1)
+                        m.d.comb += [
+                            crc.start.eq(crc_start),
+                            crc.data.eq(ctrl.o_stream.p.data),
+                            crc.valid.eq(ctrl.o_stream.valid),
+                        ]
+                        with m.If(ctrl.o_stream.valid):
+                            m.d.sync += crc_start.eq(0)
+                            m.d.sync += i_count.eq(i_count - 1)
+                    with m.Elif(is_get):
                         m.d.comb += self.o_stream.valid.eq(ctrl.o_stream.valid)
                         m.d.comb += ctrl.o_stream.ready.eq(self.o_stream.ready)
                         with m.If(ctrl.o_stream.valid & ctrl.o_stream.ready):
                             m.d.sync += i_count.eq(i_count - 1)
                 with m.If((o_count == 0) & ((i_count == 0) | ~is_get)):
-                    m.next = "Read-Command"
+                    with m.If((command == QSPICommand.Digest) & crc_finish):
+                        m.next = "Digest"
+                    with m.Else():
+                        m.next = "Read-Command"
 
             with m.State("Delay"):
                 with m.If(i_count == 0):
@@ -125,11 +191,91 @@ class QSPIControllerComponent(wiring.Component):
                 with m.Else():
                     m.d.sync += timer.eq(timer - 1)
 
+            with m.State("Digest"):
+                crc_offset = Signal(2)
+                m.d.comb += self.o_stream.payload.eq(crc.crc.word_select(crc_offset, 8))
+                m.d.comb += self.o_stream.valid.eq(1)
+                with m.If(self.o_stream.ready):
+                    m.d.sync += crc_offset.eq(crc_offset + 1)
+                    with m.If(crc_offset == 3):
+                        m.d.sync += crc_start.eq(1)
+                        m.next = "Read-Command"
+
             with m.State("Sync"):
                 m.d.comb += self.o_stream.valid.eq(1)
                 with m.If(self.o_stream.ready):
                     m.next = "Read-Command"
 
+            # The poll repeatedly selects the chip, sends the command, and receives one octet,
+            # until the octet masked with `p_mask` is zero, or until `p_left` octets have been
+            # received (a chip that is absent, or stuck busy, must not hang the controller).
+            # The interval between the polls is in `o_count` (reloaded into `i_count` each time),
+            # in microseconds. The poll status is sent first, followed by the last octet.
+            with m.State("Poll-Put"):
+                m.d.comb += [
+                    ctrl.i_stream.p.chip.eq(chip),
+                    ctrl.i_stream.p.mode.eq(qspi.Mode.PutX1),
+                    ctrl.i_stream.p.data.eq(p_cmd),
+                    ctrl.i_stream.valid.eq(1),
+                ]
+                with m.If(ctrl.i_stream.ready):
+                    m.next = "Poll-Get"
+
+            with m.State("Poll-Get"):
+                m.d.comb += [
+                    ctrl.i_stream.p.chip.eq(chip),
+                    ctrl.i_stream.p.mode.eq(qspi.Mode.GetX1),
+                    ctrl.i_stream.valid.eq(1),
+                ]
+                with m.If(ctrl.i_stream.ready):
+                    m.next = "Poll-Deselect"
+
+            with m.State("Poll-Deselect"):
+                m.d.comb += [
+                    ctrl.i_stream.p.chip.eq(0),
+                    ctrl.i_stream.p.mode.eq(qspi.Mode.Dummy),
+                    ctrl.i_stream.valid.eq(1),
+                ]
+                with m.If(ctrl.i_stream.ready):
+                    m.next = "Poll-Check"
+
+            with m.State("Poll-Check"):
+                m.d.comb += ctrl.o_stream.ready.eq(1)
+                with m.If(ctrl.o_stream.valid):
+                    m.d.sync += p_data.eq(ctrl.o_stream.p.data)
+                    m.d.sync += p_left.eq(p_left - 1)
+                    with m.If((ctrl.o_stream.p.data & p_mask) == 0):
+                        m.d.sync += p_stat.eq(QSPIPollStatus.Done)
+                        m.next = "Poll-Status"
+                    with m.Elif(p_left == 1):
+                        m.d.sync += p_stat.eq(QSPIPollStatus.Timeout)
+                        m.next = "Poll-Status"
+                    with m.Else():
+                        m.d.sync += i_count.eq(o_count)
+                        m.next = "Poll-Wait"
+
+            with m.State("Poll-Wait"):
+                with m.If(i_count == 0):
+                    m.next = "Poll-Put"
+                with m.Elif(timer == 0):
+                    m.d.sync += i_count.eq(i_count - 1)
+                    m.d.sync += timer.eq(self._us_cycles - 1)
+                with m.Else():
+                    m.d.sync += timer.eq(timer - 1)
+
+            with m.State("Poll-Status"):
+                m.d.comb += self.o_stream.payload.eq(p_stat)
+                m.d.comb += self.o_stream.valid.eq(1)
+                with m.If(self.o_stream.ready):
+                    m.next = "Poll-Done"
+
+            with m.State("Poll-Done"):
+                m.d.comb += self.o_stream.payload.eq(p_data)
+                m.d.comb += self.o_stream.valid.eq(1)
+                with m.If(self.o_stream.ready):
+                    m.d.sync += chip.eq(0)
+                    m.next = "Read-Command"
+
         return m
 
 
@@ -212,6 +358,27 @@ class QSPIControllerInterface:
         self._log("read=<%s>", dump_hex(octets))
         return octets
 
+    async def digest(self, count: int, *, chunk_size: int | None = None,
+                     x: Literal[1, 2, 4] = 1) -> list[int]:
+        """Read ``count`` octets, but return only the CRC-32 of every ``chunk_size`` of them.
+
+        The checksums are computed by the controller, and are the same as :func:`zlib.crc32`.
+        """
+        assert self._active is not None, "no chip selected"
+        mode = {1: qspi.Mode.GetX1, 2: qspi.Mode.GetX2, 4: qspi.Mode.GetX4}[x]
+        if chunk_size is None:
+            chunk_size = count
+        chunks = list(self._chunked(range(count), count=chunk_size))
+        for chunk in chunks:
+            for part in self._chunked(chunk):
+                finish = part.stop == chunk.stop
+                await self._pipe.send(struct.pack("<BH",
+                    (QSPICommand.Digest.value << 4) | (finish << 3) | mode.value, len(part)))
+        await self._pipe.flush()
+        digests = list(struct.unpack(f"<{len(chunks)}L", await self._pipe.recv(4 * len(chunks))))
+        self._log("digest=<%s>", " ".join(f"{digest:08x}" for digest in digests))
+        return digests
+
     async def dummy(self, count: int):
         # We intentionally allow sending dummy cycles with no chip selected.
         self._log("dummy=%d", count)
@@ -231,6 +398,46 @@ class QSPIControllerInterface:
             await self._pipe.send(struct.pack("<BH",
                 (QSPICommand.Delay.value << 4), len(chunk)))
 
+    async def submit_poll(self, command: int, mask: int, *, index=0, interval_us: int = 0,
+                          max_polls: int = 0x10000):
+        """Poll a status register until the bits in ``mask`` are cleared.
+
+        The chip ``index`` is repeatedly selected, sent ``command``, and one octet is read from it
+        in SPI mode, every ``interval_us`` microseconds; no host round trip is involved. Once the
+        octet masked with ``mask`` is zero (with ``mask=0``, after the first read), the octet is
+        queued to be retrieved by :meth:`collect_polls`, and the next command is executed.
+
+        If the octet is still not zero after it has been read ``max_polls`` times, the poll times
+        out; the last octet is queued all the same, and :meth:`collect_polls` raises an exception.
+        """
+        assert self._active is None, "chip already selected"
+        assert index in range(8)
+        assert max_polls in range(1, 1 << 32)
+        self._log("poll cmd=%02X mask=%02X interval=%d max=%d",
+                  command, mask, interval_us, max_polls)
+        await self._pipe.send(struct.pack("<BBBLH",
+            (QSPICommand.Poll.value << 4) | (1 + index), command, mask, max_polls, interval_us))
+
+    async def collect_polls(self, count: int) -> memoryview:
+        """Retrieve the final octets of the ``count`` earliest polls submitted.
+
+        Raises :class:`QSPIControllerError` if any of these polls timed out. The final octets of
+        all ``count`` polls are retrieved before raising; they are available as the ``octets``
+        attribute of the exception, and the position of the first poll that timed out as
+        the ``index`` attribute.
+        """
+        await self._pipe.flush()
+        response = await self._pipe.recv(2 * count)
+        statuses, octets = response[0::2], response[1::2]
+        self._log("poll=<%s>", dump_hex(octets))
+        for index, status in enumerate(statuses):
+            if QSPIPollStatus(status) == QSPIPollStatus.Timeout:
+                error = QSPIControllerError(
+                    f"poll {index} of {count} timed out (last octet {octets[index]:#04x})")
+                error.index, error.octets = index, octets
+                raise error
+        return octets
+
     async def synchronize(self):
         self._log("sync-o")
         await self._pipe.send(struct.pack("<B",
@@ -1,10 +1,126 @@
+import zlib
+import random
+import logging
+
 from amaranth import *
 
+from glasgow.simulation.assembly import SimulationAssembly
 from glasgow.applet import GlasgowAppletV2TestCase, synthesis_test
-from . import QSPIControllerApplet
+from . import QSPIControllerError, QSPIControllerInterface, QSPIControllerApplet
+
+
+logger = logging.getLogger(__name__)
 
 
 class QSPIControllerAppletTestCase(GlasgowAppletV2TestCase, applet=QSPIControllerApplet):
     @synthesis_test
     def test_build(self):
         self.assertBuilds()
+
+    def test_sim_digest(self):
+        assembly = SimulationAssembly()
+
+        iface = QSPIControllerInterface(logger, assembly, cs="A5", sck="A0", io="A1:4")
+
+        sck = assembly.get_pin("A0")
+        io  = (
+            assembly.get_pin("A1") + assembly.get_pin("A2") +
+            assembly.get_pin("A3") + assembly.get_pin("A4")
+        )
+        # Longer than the 0xffff octets that a single transfer command can read.
+        memory = random.Random(0).randbytes(0x10100)
+
+        async def flash_testbench(ctx):
+            # Ignores commands and sends `memory` in quad mode, changing the data on SCK falling
+            # edges so that it is stable when sampled on SCK rising edges.
+            for octet in memory:
+                for nibble in (octet >> 4, octet & 0xf):
+                    ctx.set(io.i, nibble)
+                    await ctx.posedge(sck.o)
+                    await ctx.negedge(sck.o)
+        assembly.add_testbench(flash_testbench, background=True)
+
+        async def iface_testbench(ctx):
+            await iface.clock.set_frequency(250_000)
+            async with iface.select():
+                self.assertEqual(await iface.digest(0x10010, x=4),
+                                 [zlib.crc32(memory[:0x10010])])
+            async with iface.select():
+                self.assertEqual(await iface.digest(0xf0, chunk_size=0x40, x=4), [
+                    zlib.crc32(memory[0x10010:0x10050]),
+                    zlib.crc32(memory[0x10050:0x10090]),
+                    zlib.crc32(memory[0x10090:0x10100]),
+                ])
+
+        assembly.run(iface_testbench)
+
+    def test_sim_poll(self):
+        assembly = SimulationAssembly()
+
+        iface = QSPIControllerInterface(logger, assembly, cs="A5", sck="A0", io="A1:4")
+
+        cs   = assembly.get_pin("A5")
+        sck  = assembly.get_pin("A0")
+        copi = assembly.get_pin("A1")
+        cipo = assembly.get_pin("A2")
+        # The status octet returned for each selection; the last one is repeated indefinitely.
+        statuses = [0x03, 0x03, 0x02, 0xa5, 0xff]
+        selections = [] # (command, selected at cycle, deselected at cycle)
+
+        async def flash_testbench(ctx):
+            # Samples the pins every cycle (the sampling rate is much higher than SCK frequency);
+            # receives a command octet, then sends a status octet, changing the data on SCK
+            # falling edges so that it is stable when sampled on SCK rising edges.
+            cycle = 0
+            selected = False
+            sck_prev = 0
+            while True:
+                await ctx.tick()
+                cycle += 1
+                cs_o, sck_o = ctx.get(cs.o), ctx.get(sck.o)
+                if not selected and not cs_o:
+                    selected, start, bits, command = True, cycle, 0, 0
+                    status = statuses[min(len(selections), len(statuses) - 1)]
+                elif selected and cs_o:
+                    selected = False
+                    selections.append((command, start, cycle))
+                elif selected and sck_o and not sck_prev:
+                    if bits < 8:
+                        command = (command << 1) | ctx.get(copi.o)
+                    bits += 1
+                elif selected and not sck_o and sck_prev:
+                    if bits in range(8, 16):
+                        ctx.set(cipo.i, (status >> (15 - bits)) & 1)
+                sck_prev = sck_o
+        assembly.add_testbench(flash_testbench, background=True)
+
+        async def iface_testbench(ctx):
+            await iface.clock.set_frequency(250_000)
+            # Polls until bit 0 is clear, 20 us apart (the simulated clock runs at 1 MHz).
+            await iface.submit_poll(0x05, 0x01, interval_us=20)
+            # With `mask=0`, reads the status once regardless of its value.
+            await iface.submit_poll(0x05, 0x00)
+            self.assertEqual(bytes(await iface.collect_polls(2)), b"\x02\xa5")
+            # The final octet may be received before the chip is deselected.
+            for _ in range(64):
+                await ctx.tick()
+            self.assertEqual([command for command, *_ in selections], [0x05] * 4)
+            for (_, _, deselected_at), (_, selected_at, _) in zip(selections, selections[1:3]):
+                self.assertGreaterEqual(selected_at - deselected_at, 20)
+
+            # Gives up after the status has been read `max_polls` times.
+            await iface.submit_poll(0x35, 0x80, max_polls=3)
+            with self.assertRaisesRegex(QSPIControllerError,
+                    r"^poll 0 of 1 timed out \(last octet 0xff\)$") as cm:
+                await iface.collect_polls(1)
+            self.assertEqual(bytes(cm.exception.octets), b"\xff")
+            self.assertEqual([command for command, *_ in selections[4:]], [0x35] * 3)
+
+            # The controller keeps executing commands after a timeout.
+            await iface.synchronize()
+            for _ in range(64):
+                await ctx.tick()
+            self.assertEqual(len(selections), 7)
+            self.assertEqual(ctx.get(cs.o), 1)
+
+        assembly.run(iface_testbench)
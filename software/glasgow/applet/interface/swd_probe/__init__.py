@@ -7,6 +7,7 @@
 # instructed in the comment there.
 
 from typing import Optional, AsyncIterator
+import functools
 import logging
 import struct
 
@@ -23,7 +24,7 @@ from glasgow.abstract import AbstractAssembly
 from glasgow.applet import GlasgowAppletError, GlasgowAppletV2
 
 
-__all__ = ["SWDProbeException", "SWDProbeComponent", "SWDProbeInterface"]
+__all__ = ["SWDProbeException", "SWDProbeComponent", "SWDProbeBatch", "SWDProbeInterface"]
 
 
 class SWDProbeException(GlasgowAppletError):
@@ -31,10 +32,12 @@ class SWDProbeException(GlasgowAppletError):
         Error   = "error"   # parity error or invalid acknowledgement
         Fault   = "fault"   # target returned a FAULT response
         Timeout = "timeout" # too many retries for a WAIT response
+        Skipped = "skipped" # an earlier queued transaction has failed
         Other   = "other"   # unspecified
 
     def __init__(self, message, *, kind: Kind = Kind.Other):
-        self.kind = kind
+        self.kind    = kind
+        self.results = None # set by `SWDProbeBatch.execute()`
         super().__init__(message)
 
 
@@ -68,9 +71,10 @@ class SWDProbeComponent(wiring.Component):
     divisor: In(16)
     timeout: In(16, init=~0)
 
-    def __init__(self, ports, *, offset=None):
+    def __init__(self, ports, *, offset=None, sticky=False):
         self._ports  = ports
         self._offset = offset
+        self._sticky = sticky
 
         super().__init__()
 
@@ -80,7 +84,8 @@ class SWDProbeComponent(wiring.Component):
         m.submodules.ctrl = ctrl = swd.Controller(self._ports,
             # Offset sampling by ~10 ns to compensate for 10..15 ns of roundtrip delay caused by
             # the level shifters (5 ns each) and FPGA clock-to-out (5 ns).
-            offset=1 if self._offset is None else self._offset)
+            offset=1 if self._offset is None else self._offset,
+            sticky=self._sticky)
         m.d.comb += ctrl.divisor.eq(self.divisor)
         m.d.comb += ctrl.timeout.eq(self.timeout)
 
@@ -150,15 +155,177 @@ class SWDProbeComponent(wiring.Component):
         return m
 
 
+@functools.cache
+def _transfer_command(ap_ndp: int, r_nw: int, addr: int) -> int:
+    return SWDCommand.const({
+        "cmd": swd.Command.Transfer,
+        "arg": {"transfer": {"ap_ndp": ap_ndp, "r_nw": r_nw, "addr23": addr >> 2}}
+    }).as_value().value
+
+
+@functools.cache
+def _transfer_response(response: int) -> tuple[swd.Response, swd.Ack]:
+    response = data.Const(SWDResponse, response)
+    return response.rsp, response.ack
+
+
+class SWDProbeBatch:
+    """A queue of DP and AP transactions.
+
+    Transactions added to a batch are not performed until :meth:`execute` is called, at which
+    point all of them are sent to the probe at once and their acknowledgements and data are
+    collected together. This takes a single USB round trip regardless of the number of
+    transactions in the batch.
+
+    The probe retries transfers that receive a WAIT response by itself. If a transaction fails,
+    the probe skips every transaction after it in the batch, and :meth:`execute` raises
+    an exception describing the first failure.
+
+    The probe keeps skipping transactions, including those in later batches, until
+    :meth:`SWDProbeInterface.clear_errors` or :meth:`SWDProbeInterface.line_reset` is called.
+    Reads of DP DPIDR and DP CTRL/STAT are the only exception; they are always performed, so
+    that the cause of the failure can be examined.
+    """
+
+    def __init__(self, iface: "SWDProbeInterface"):
+        self._iface  = iface
+        self._select = iface._select
+        self._buffer = bytearray()
+        self._queue  = [] # (ap_ndp, r_nw, addr, data)
+
+    def __len__(self):
+        return len(self._queue)
+
+    def _transfer(self, *, ap_ndp: int, r_nw: int, addr: int, data: Optional[int] = None):
+        assert addr in range(0, 0x10, 4)
+        self._buffer.append(_transfer_command(ap_ndp, r_nw, addr))
+        if not r_nw:
+            self._buffer += struct.pack("<L", data)
+        self._queue.append((ap_ndp, r_nw, addr, data))
+
+    def _update_select(self, **kwargs):
+        if self._select is None:
+            select = DP_SELECT(**kwargs)
+        else:
+            select = self._select.copy()
+            for field, value in kwargs.items():
+                setattr(select, field, value)
+        if select != self._select:
+            self._transfer(ap_ndp=0, r_nw=0, addr=DP_SELECT_addr, data=select.to_int())
+            self._select = select
+
+    def _select_dp_addr(self, addr: int):
+        if addr & 0xf == 0x4: # banked
+            self._update_select(DPBANKSEL=addr >> 4)
+
+    def _select_ap_addr(self, ap: int, reg: int):
+        self._update_select(APSEL=ap, APBANKSEL=reg >> 4)
+
+    def dp_read(self, reg: int):
+        """Queue a read of DP register, switching the DP bank if necessary."""
+        self._select_dp_addr(reg)
+        self._transfer(ap_ndp=0, r_nw=1, addr=reg & 0xf)
+
+    def dp_write(self, reg: int, data: int):
+        """Queue a write of DP register, switching the DP bank if necessary."""
+        self._select_dp_addr(reg)
+        self._transfer(ap_ndp=0, r_nw=0, addr=reg & 0xf, data=data)
+        if reg == DP_SELECT_addr:
+            self._select = DP_SELECT.from_int(data)
+
+    def ap_read(self, ap: int, reg: int):
+        """Queue a read of AP register, switching the AP and AP bank if necessary."""
+        self._select_ap_addr(ap, reg)
+        self._transfer(ap_ndp=1, r_nw=1, addr=reg & 0xf)
+
+    def ap_write(self, ap: int, reg: int, data: int):
+        """Queue a write of AP register, switching the AP and AP bank if necessary."""
+        self._select_ap_addr(ap, reg)
+        self._transfer(ap_ndp=1, r_nw=0, addr=reg & 0xf, data=data)
+
+    async def execute(self) -> list[int]:
+        """Perform all queued transactions.
+
+        Returns the data of every queued read, in the order in which the reads were queued.
+        The batch is empty afterwards, and may be reused.
+
+        If a transaction fails, the raised :class:`SWDProbeException` has the ``results``
+        attribute set to the same list, where the reads that were not performed are ``None``.
+        """
+        iface, queue, buffer = self._iface, self._queue, self._buffer
+        self._queue, self._buffer = [], bytearray()
+        if not queue:
+            return []
+
+        await iface._pipe.send(buffer)
+        await iface._pipe.flush()
+
+        results = []
+        failure = None
+        select  = iface._select
+        for ap_ndp, r_nw, addr, wdata in queue:
+            rsp, ack = _transfer_response((await iface._pipe.recv(1))[0])
+            if rsp == swd.Response.Data:
+                rdata, = struct.unpack("<L", await iface._pipe.recv(4))
+                results.append(rdata)
+            elif r_nw:
+                results.append(None)
+
+            match rsp, ack:
+                case swd.Response.Error, _:
+                    exn = SWDProbeException("communication error",
+                        kind=SWDProbeException.Kind.Error)
+                case swd.Response.Skipped, _:
+                    exn = SWDProbeException("transaction skipped after an earlier failure; "
+                                            "clear errors or perform a line reset to resume",
+                        kind=SWDProbeException.Kind.Skipped)
+                case _, swd.Ack.FAULT:
+                    exn = SWDProbeException("transaction fault",
+                        kind=SWDProbeException.Kind.Fault)
+                case _, swd.Ack.WAIT:
+                    exn = SWDProbeException("wait timeout",
+                        kind=SWDProbeException.Kind.Timeout)
+                case _:
+                    assert ack == swd.Ack.OK
+                    exn = None
+
+            if failure is None:
+                failure = exn
+            if not ap_ndp and not r_nw and addr == DP_SELECT_addr:
+                # Transactions that received FAULT or WAIT, or were skipped, have not been
+                # performed, but those with a communication error may or may not have been.
+                if exn is None:
+                    select = DP_SELECT.from_int(wdata)
+                elif exn.kind == SWDProbeException.Kind.Error:
+                    select = None
+            if iface._logger.isEnabledFor(iface._level):
+                port = "ap" if ap_ndp else "dp"
+                if exn is not None:
+                    iface._log(f"{'rd' if r_nw else 'wr'} {port} addr={addr:#x} "
+                               f"{exn.kind.value}")
+                elif r_nw:
+                    iface._log(f"rd {port} addr={addr:#x} data={rdata:#010x}")
+                else:
+                    iface._log(f"wr {port} addr={addr:#x} data={wdata:#010x}")
+
+        iface._select = self._select = select
+        if failure is not None:
+            failure.results = results
+            raise failure
+        return results
+
+
 class SWDProbeInterface:
     def __init__(self, logger, assembly: AbstractAssembly, *, swclk, swdio):
         self._logger = logger
         self._level  = logging.DEBUG if self._logger.name == __name__ else logging.TRACE
 
         ports = assembly.add_port_group(swclk=swclk, swdio=swdio)
-        component = assembly.add_submodule(SWDProbeComponent(ports))
+        component = assembly.add_submodule(SWDProbeComponent(ports, sticky=True))
+        # Single accesses need low latency, but block transfers return many responses at once;
+        # adaptive tuning grows the IN transfers only while the device keeps filling them.
         self._pipe = assembly.add_inout_pipe(component.o_stream, component.i_stream,
-            in_flush=component.o_flush)
+            in_flush=component.o_flush, in_tuning="adaptive", out_tuning="latency")
         self._clock = assembly.add_clock_divisor(component.divisor,
             ref_period=assembly.sys_clk_period, name="swclk")
         self._timeout = assembly.add_rw_register(component.timeout)
@@ -183,98 +350,140 @@ class SWDProbeInterface:
             await self._pipe.send(struct.pack("<L", chunk.to_int()))
         await self._pipe.flush()
 
-    async def _send_transfer(self, **kwargs):
-        await self._send_command(cmd=swd.Command.Transfer,
-            arg={"transfer": kwargs})
-
-    async def _recv_ack(self):
-        await self._pipe.flush()
-        response = data.Const(SWDResponse, (await self._pipe.recv(1))[0])
-        if response.rsp == swd.Response.Error:
-            raise SWDProbeException("communication error", kind=SWDProbeException.Kind.Error)
-        if response.ack == swd.Ack.FAULT:
-            raise SWDProbeException("transaction fault", kind=SWDProbeException.Kind.Fault)
-        if response.ack == swd.Ack.WAIT:
-            raise SWDProbeException("wait timeout", kind=SWDProbeException.Kind.Timeout)
-        assert response.ack == swd.Ack.OK
-
     async def line_reset(self):
         """Perform a line reset sequence."""
         self._log("line-reset")
         await self._send_sequence(SWJ_line_reset_seq)
         self._select = None
 
+    async def clear_errors(self):
+        """Clear sticky error flags in the DP, and resume transactions after a failure.
+
+        Once a transaction fails, the probe skips every following transaction (other than reads
+        of DP DPIDR and DP CTRL/STAT) until DP ABORT is written, which this method does. If
+        the failure was a communication error, a line reset may be required instead.
+        """
+        await self.dp_write(DP_ABORT_addr,
+            DP_ABORT(STKCMPCLR=1, STKERRCLR=1, WDERRCLR=1, ORUNERRCLR=1).to_int())
+
     async def jtag_to_swd(self):
         """Perform a JTAG-to-SWD switch sequence."""
         self._log("jtag-to-swd")
         await self._send_sequence(SWJ_jtag_to_swd_switch_seq)
 
-    async def _raw_read(self, *, ap_ndp: bool, addr: int) -> int:
-        assert addr in range(0, 0x10, 4)
-        await self._send_transfer(ap_ndp=ap_ndp, r_nw=1, addr23=addr >> 2)
-        try:
-            await self._recv_ack()
-            data, = struct.unpack("<L", await self._pipe.recv(4))
-            self._log(f"rd {'ap' if ap_ndp else 'dp'} addr={addr:#x} data={data:#010x}")
-        except SWDProbeException as exn:
-            self._log(f"rd {'ap' if ap_ndp else 'dp'} addr={addr:#x} {exn.kind.value}")
-            raise
-        return data
+    async def set_wait_retries(self, count: int):
+        """Set how many times a transfer is retried after a WAIT response.
 
-    async def _raw_write(self, *, ap_ndp: bool, addr: int, data: int):
-        assert addr in range(0, 0x10, 4)
-        await self._send_transfer(ap_ndp=ap_ndp, r_nw=0, addr23=addr >> 2)
-        await self._pipe.send(struct.pack("<L", data))
-        try:
-            await self._recv_ack()
-            self._log(f"wr {'ap' if ap_ndp else 'dp'} addr={addr:#x} data={data:#010x}")
-        except SWDProbeException as exn:
-            self._log(f"wr {'ap' if ap_ndp else 'dp'} addr={addr:#x} {exn.kind.value}")
-            raise
-
-    async def _update_select(self, **kwargs):
-        if self._select is None:
-            select = DP_SELECT(**kwargs)
-        else:
-            select = self._select.copy()
-            for field, value in kwargs.items():
-                setattr(select, field, value)
-        if select != self._select:
-            await self._raw_write(ap_ndp=0, addr=DP_SELECT_addr, data=select.to_int())
+        The retries are performed by the gateware without involving the host; once the limit is
+        reached, the transfer fails with :attr:`SWDProbeException.Kind.Timeout`.
+        """
+        assert count in range(1 << 16)
+        await self._timeout.set(count)
 
-    async def _select_dp_addr(self, addr: int):
-        if addr & 0xf == 0x4: # banked
-            await self._update_select(DPBANKSEL=addr >> 4)
+    def batch(self) -> SWDProbeBatch:
+        """Create a queue of DP and AP transactions.
+
+        See :class:`SWDProbeBatch` for details.
+        """
+        return SWDProbeBatch(self)
 
     async def dp_read(self, reg: int) -> int:
         """Read DP register, switching the DP bank if necessary."""
-        await self._select_dp_addr(reg)
-        return await self._raw_read(ap_ndp=0, addr=reg & 0xf)
+        batch = self.batch()
+        batch.dp_read(reg)
+        data, = await batch.execute()
+        return data
 
     async def dp_write(self, reg: int, data: int):
         """Write DP register, switching the DP bank if necessary."""
-        await self._select_dp_addr(reg)
-        return await self._raw_write(ap_ndp=0, addr=reg & 0xf, data=data)
-
-    async def _select_ap_addr(self, ap: int, reg: int):
-        await self._update_select(APSEL=ap, APBANKSEL=reg >> 4)
+        batch = self.batch()
+        batch.dp_write(reg, data)
+        await batch.execute()
 
     async def ap_read(self, ap: int, reg: int) -> int:
-        """Read AP register, switching the AP and AP bank if necessary."""
-        await self._select_ap_addr(ap, reg)
-        return await self._raw_read(ap_ndp=1, addr=reg & 0xf)
+        """Read AP register, switching the AP and AP bank if necessary.
+
+        AP reads are posted: the returned value is the result of the *previous* AP read, and
+        the result of this read is returned by the next AP read or a read of DP RDBUFF.
+        """
+        batch = self.batch()
+        batch.ap_read(ap, reg)
+        data, = await batch.execute()
+        return data
 
     async def ap_write(self, ap: int, reg: int, data: int):
         """Write AP register, switching the AP and AP bank if necessary."""
-        await self._select_ap_addr(ap, reg)
-        return await self._raw_write(ap_ndp=1, addr=reg & 0xf, data=data)
+        batch = self.batch()
+        batch.ap_write(ap, reg, data)
+        await batch.execute()
+
+    async def _mem_ap_setup(self, ap: int):
+        batch = self.batch()
+        batch.ap_read(ap, MEM_AP_CSW_addr)
+        batch.dp_read(DP_RDBUFF_addr)
+        _, csw_value = await batch.execute()
+        csw = MEM_AP_CSW.from_int(csw_value)
+        if csw.Size != MEM_AP_CSW_SIZE.WORD or csw.AddrInc != MEM_AP_CSW_ADDRINC.SINGLE:
+            csw.Size    = MEM_AP_CSW_SIZE.WORD
+            csw.AddrInc = MEM_AP_CSW_ADDRINC.SINGLE
+            await self.ap_write(ap, MEM_AP_CSW_addr, csw.to_int())
+
+    @staticmethod
+    def _mem_ap_chunks(address: int, count: int):
+        while count > 0:
+            chunk = min(count, (MEM_AP_TAR_INC_BOUNDARY -
+                                address % MEM_AP_TAR_INC_BOUNDARY) // 4)
+            yield address, chunk
+            address += chunk * 4
+            count   -= chunk
+
+    async def mem_ap_read_block(self, ap: int, address: int, count: int) -> list[int]:
+        """Read ``count`` words starting at ``address`` through MEM-AP ``ap``.
+
+        The reads use TAR auto-increment and are all queued together, so that the entire block
+        is transferred in a single round trip. ``address`` must be word-aligned.
+        """
+        assert address % 4 == 0
+        await self._mem_ap_setup(ap)
+        batch = self.batch()
+        for chunk_address, chunk_count in self._mem_ap_chunks(address, count):
+            batch.ap_write(ap, MEM_AP_TAR_addr, chunk_address)
+            for _ in range(chunk_count):
+                batch.ap_read(ap, MEM_AP_DRW_addr)
+            batch.dp_read(DP_RDBUFF_addr)
+        results = await batch.execute()
+        words = []
+        for _, chunk_count in self._mem_ap_chunks(address, count):
+            # The first read of each chunk returns a stale value because AP reads are posted.
+            words += results[1:chunk_count + 1]
+            results = results[chunk_count + 1:]
+        return words
+
+    async def mem_ap_write_block(self, ap: int, address: int, words: list[int]):
+        """Write ``words`` starting at ``address`` through MEM-AP ``ap``.
+
+        The writes use TAR auto-increment and are all queued together, so that the entire block
+        is transferred in a single round trip. ``address`` must be word-aligned.
+        """
+        assert address % 4 == 0
+        await self._mem_ap_setup(ap)
+        batch = self.batch()
+        offset = 0
+        for chunk_address, chunk_count in self._mem_ap_chunks(address, len(words)):
+            batch.ap_write(ap, MEM_AP_TAR_addr, chunk_address)
+            for word in words[offset:offset + chunk_count]:
+                batch.ap_write(ap, MEM_AP_DRW_addr, word)
+            offset += chunk_count
+        # AP writes are posted as well; reading RDBUFF waits until the last one completes, and
+        # reports its failure if it does not.
+        batch.dp_read(DP_RDBUFF_addr)
+        await batch.execute()
 
     async def initialize(self) -> DP_DPIDR:
         await self.jtag_to_swd()
         await self.line_reset()
         dpidr = DP_DPIDR.from_int(await self.dp_read(reg=DP_DPIDR_addr))
-        await self.dp_write(reg=DP_ABORT_addr,
-            data=DP_ABORT(STKCMPCLR=1, STKERRCLR=1, WDERRCLR=1, ORUNERRCLR=1).to_int())
+        await self.clear_errors()
         await self.dp_write(reg=DP_CTRL_STAT_addr,
             data=DP_CTRL_STAT(CDBGPWRUPREQ=1).to_int())
         ctrl_stat = DP_CTRL_STAT.from_int(await self.dp_read(reg=DP_CTRL_STAT_addr))
@@ -1,7 +1,14 @@
+import asyncio
+import struct
+import unittest
+
+from glasgow.arch.arm.dap import *
+from glasgow.gateware import swd
+from glasgow.simulation.assembly import ModelAssembly
 from glasgow.applet import GlasgowAppletV2TestCase, synthesis_test
 from glasgow.applet import applet_v2_simulation_test, applet_v2_hardware_test
 
-from . import SWDProbeException, SWDProbeApplet
+from . import SWDProbeException, SWDProbeInterface, SWDProbeApplet
 
 
 class SWDProbeAppletTestCase(GlasgowAppletV2TestCase, applet=SWDProbeApplet):
@@ -19,3 +26,218 @@ class SWDProbeAppletTestCase(GlasgowAppletV2TestCase, applet=SWDProbeApplet):
     @applet_v2_hardware_test(args="-V 3.3", mock="swd_iface._pipe")
     async def test_loopback_hw(self, applet):
         await applet.swd_iface.initialize()
+
+
+class _MockTarget:
+    # Emulates the probe gateware (in sticky mode) together with a target that has a single
+    # MEM-AP at index 0 that faults on accesses to `fault_addrs`.
+    def __init__(self):
+        self.flushes     = 0
+        self.selects     = []
+        self.memory      = {}
+        self.fault_addrs = set()
+        self._out        = bytearray()
+        self._in         = bytearray()
+        self._failed     = False
+        self._stickyerr  = False
+        self._select     = DP_SELECT()
+        self._csw        = 0
+        self._tar        = 0
+        self._rdbuff     = 0
+
+    async def send(self, data):
+        self._out += bytes(data)
+
+    async def flush(self):
+        self.flushes += 1
+        while self._out:
+            command = self._out.pop(0)
+            if command & 0x20: # sequence
+                del self._out[:4]
+                self._failed = False
+                continue
+            ap_ndp, r_nw, addr = command & 1, (command >> 1) & 1, command & 0xc
+            wdata = None
+            if not r_nw:
+                wdata, = struct.unpack("<L", self._out[:4])
+                del self._out[:4]
+            if self._failed and not (
+                    (not ap_ndp and not r_nw and addr == DP_ABORT_addr) or
+                    (not ap_ndp and r_nw and addr in (DP_DPIDR_addr, DP_CTRL_STAT_addr))):
+                self._in.append(swd.Response.Skipped.value << 4)
+                continue
+            ack, rdata = self._transfer(ap_ndp, r_nw, addr, wdata)
+            if not ap_ndp and not r_nw and addr == DP_ABORT_addr:
+                self._failed = False
+            if ack == swd.Ack.FAULT:
+                self._failed = True
+                self._in.append(swd.Response.NoData.value << 4 | ack.value)
+            elif r_nw:
+                self._in.append(swd.Response.Data.value << 4 | ack.value)
+                self._in += struct.pack("<L", rdata)
+            else:
+                self._in.append(swd.Response.NoData.value << 4 | ack.value)
+
+    def _transfer(self, ap_ndp, r_nw, addr, wdata):
+        if not ap_ndp:
+            match r_nw, addr:
+                case 1, 0x0:
+                    return swd.Ack.OK, 0x2ba01477
+                case 0, 0x0:
+                    self._stickyerr = False
+                case 1, 0x4:
+                    return swd.Ack.OK, DP_CTRL_STAT(STICKYERR=self._stickyerr).to_int()
+                case 0, 0x8:
+                    self._select = DP_SELECT.from_int(wdata)
+                    self.selects.append(self._select)
+                case 1, 0xc:
+                    return swd.Ack.OK, self._rdbuff
+            return swd.Ack.OK, None
+        if self._stickyerr:
+            return swd.Ack.FAULT, None
+        if self._select.APSEL != 0:
+            rdata = 0
+        else:
+            match (self._select.APBANKSEL << 4) | addr:
+                case 0x00 if r_nw:
+                    rdata = self._csw
+                case 0x00:
+                    self._csw = wdata
+                case 0x04 if r_nw:
+                    rdata = self._tar
+                case 0x04:
+                    self._tar = wdata
+                case 0x0c:
+                    if self._tar in self.fault_addrs:
+                        self._stickyerr = True
+                        return swd.Ack.FAULT, None
+                    if r_nw:
+                        rdata = self.memory.get(self._tar, 0)
+                    else:
+                        self.memory[self._tar] = wdata
+                    # TAR only increments within a 1 KiB block.
+                    self._tar = (self._tar & ~0x3ff) | ((self._tar + 4) & 0x3ff)
+                case 0xfc:
+                    rdata = 0x24770011
+                case _:
+                    rdata = 0
+        if not r_nw:
+            return swd.Ack.OK, None
+        # AP reads are posted.
+        rdata, self._rdbuff = self._rdbuff, rdata
+        return swd.Ack.OK, rdata
+
+    async def recv(self, length):
+        data, self._in = bytes(self._in[:length]), self._in[length:]
+        assert len(data) == length
+        return data
+
+
+class SWDProbeInterfaceTestCase(unittest.TestCase):
+    def setUp(self):
+        self.target = _MockTarget()
+        self.iface  = SWDProbeInterface(SWDProbeApplet.logger, ModelAssembly(self.target),
+                                        swclk=None, swdio=None)
+
+    def run_async(self, coro):
+        asyncio.new_event_loop().run_until_complete(coro)
+
+    def test_select_cache(self):
+        async def case():
+            batch = self.iface.batch()
+            batch.ap_read(0, MEM_AP_CSW_addr)
+            batch.ap_read(0, MEM_AP_TAR_addr)
+            batch.ap_read(1, AP_IDR_addr)
+            batch.dp_read(DP_RDBUFF_addr)
+            await batch.execute()
+            self.assertEqual(self.target.selects, [
+                DP_SELECT(APSEL=0, APBANKSEL=0),
+                DP_SELECT(APSEL=1, APBANKSEL=0xf),
+            ])
+            # The cache persists across batches...
+            batch.ap_read(1, AP_IDR_addr)
+            batch.dp_read(DP_RDBUFF_addr)
+            await batch.execute()
+            self.assertEqual(len(self.target.selects), 2)
+            # ... but not across a line reset.
+            await self.iface.line_reset()
+            await self.iface.ap_read(1, AP_IDR_addr)
+            self.assertEqual(len(self.target.selects), 3)
+        self.run_async(case())
+
+    def test_results(self):
+        async def case():
+            self.target.memory.update({0x1000: 0x11111111, 0x1004: 0x22222222})
+            batch = self.iface.batch()
+            batch.ap_write(0, MEM_AP_TAR_addr, 0x1000)
+            batch.ap_read(0, MEM_AP_DRW_addr)
+            batch.dp_write(DP_CTRL_STAT_addr, 0)
+            batch.ap_read(0, MEM_AP_DRW_addr)
+            batch.dp_read(DP_DPIDR_addr)
+            batch.dp_read(DP_RDBUFF_addr)
+            self.assertEqual(len(batch), 7) # including the SELECT write
+            self.assertEqual(await batch.execute(),
+                             [0x00000000, 0x11111111, 0x2ba01477, 0x22222222])
+            self.assertEqual(len(batch), 0)
+            self.assertEqual(self.target.flushes, 1)
+        self.run_async(case())
+
+    def test_failure(self):
+        async def case():
+            self.target.memory.update({0x1000: 0x11111111, 0x1004: 0x22222222})
+            self.target.fault_addrs.add(0x1004)
+            batch = self.iface.batch()
+            batch.ap_write(0, MEM_AP_TAR_addr, 0x1000)
+            batch.ap_read(0, MEM_AP_DRW_addr)
+            batch.ap_read(0, MEM_AP_DRW_addr)
+            batch.ap_write(0, MEM_AP_DRW_addr, 0)
+            batch.ap_read(0, MEM_AP_DRW_addr)
+            batch.dp_read(DP_RDBUFF_addr)
+            with self.assertRaisesRegex(SWDProbeException, r"^transaction fault$") as cm:
+                await batch.execute()
+            self.assertEqual(cm.exception.kind, SWDProbeException.Kind.Fault)
+            self.assertEqual(cm.exception.results, [0x00000000, None, None, None])
+
+            # Only DP DPIDR and DP CTRL/STAT reads are performed until errors are cleared.
+            ctrl_stat = DP_CTRL_STAT.from_int(await self.iface.dp_read(DP_CTRL_STAT_addr))
+            self.assertTrue(ctrl_stat.STICKYERR)
+            with self.assertRaisesRegex(SWDProbeException,
+                    r"^transaction skipped after an earlier failure; ") as cm:
+                await self.iface.ap_read(0, MEM_AP_TAR_addr)
+            self.assertEqual(cm.exception.kind, SWDProbeException.Kind.Skipped)
+            with self.assertRaises(SWDProbeException):
+                await self.iface.ap_read(1, AP_IDR_addr)
+            # The SELECT write was skipped too.
+            self.assertEqual(self.target.selects, [DP_SELECT(APSEL=0, APBANKSEL=0)])
+            self.assertEqual(self.iface._select, DP_SELECT(APSEL=0, APBANKSEL=0))
+
+            await self.iface.clear_errors()
+            await self.iface.ap_read(0, MEM_AP_TAR_addr)
+            self.assertEqual(await self.iface.dp_read(DP_RDBUFF_addr), 0x1004)
+        self.run_async(case())
+
+    def test_mem_ap_read_block(self):
+        async def case():
+            # Crosses two 1 KiB boundaries.
+            self.target.memory.update({0x3f0 + n * 4: n + 1 for n in range(300)})
+            flushes = self.target.flushes
+            self.assertEqual(await self.iface.mem_ap_read_block(0, 0x3f0, 300),
+                             [n + 1 for n in range(300)])
+            # Reading CSW, writing CSW, and the block itself.
+            self.assertEqual(self.target.flushes - flushes, 3)
+        self.run_async(case())
+
+    def test_mem_ap_write_block(self):
+        async def case():
+            await self.iface.mem_ap_write_block(0, 0x3f0, [n + 1 for n in range(300)])
+            self.assertEqual(self.target.memory, {0x3f0 + n * 4: n + 1 for n in range(300)})
+        self.run_async(case())
+
+    def test_mem_ap_write_block_fault(self):
+        async def case():
+            self.target.fault_addrs.add(0x400)
+            with self.assertRaises(SWDProbeException) as cm:
+                await self.iface.mem_ap_write_block(0, 0x3f0, [n + 1 for n in range(300)])
+            self.assertEqual(cm.exception.kind, SWDProbeException.Kind.Fault)
+            self.assertEqual(self.target.memory, {0x3f0 + n * 4: n + 1 for n in range(4)})
+        self.run_async(case())
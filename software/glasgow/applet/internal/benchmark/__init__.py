@@ -1,23 +1,30 @@
 import logging
+import argparse
 import asyncio
+import platform
 import struct
 import array
 import time
+import json
 import statistics
 import enum
 
+import usb1
+
 from amaranth import *
 from amaranth.lib import wiring, stream
 from amaranth.lib.wiring import In, Out
 
+from glasgow import __version__
 from glasgow.gateware.lfsr import LinearFeedbackShiftRegister
-from glasgow.applet import GlasgowAppletV2
+from glasgow.applet import GlasgowAppletV2, GlasgowAppletError
 
 
 class Mode(enum.Enum):
     SOURCE   = 1
     SINK     = 2
     LOOPBACK = 3
+    LATENCY  = 4
 
 
 class BenchmarkComponent(wiring.Component):
@@ -41,6 +48,14 @@ class BenchmarkComponent(wiring.Component):
         m.submodules.lfsr = lfsr = EnableInserter(lfsr_en)(self.lfsr)
         m.d.comb += lfsr_word.eq(self.lfsr.value.word_select(self.count & 1, width=8))
 
+        # Free-running cycle counter used to timestamp packets in the latency mode. This makes it
+        # possible to tell apart the time a packet spends inside the device from the time it spends
+        # in transit over USB in either direction.
+        timer   = Signal(32)
+        stamp_i = Signal(32)
+        stamp_o = Signal(32)
+        m.d.sync += timer.eq(timer + 1)
+
         with m.FSM():
             with m.State("MODE"):
                 m.d.sync += self.count.eq(0)
@@ -51,6 +66,8 @@ class BenchmarkComponent(wiring.Component):
                         m.next = "SINK"
                     with m.Case(Mode.LOOPBACK):
                         m.next = "LOOPBACK"
+                    with m.Case(Mode.LATENCY):
+                        m.next = "LATENCY"
 
             with m.State("SOURCE"):
                 m.d.comb += [
@@ -86,9 +103,43 @@ class BenchmarkComponent(wiring.Component):
                         self.o_flush.eq(1),
                     ]
 
+            with m.State("LATENCY"):
+                # Same as the loopback mode, except that the last 8 bytes of every 512-byte packet
+                # are replaced with a tag: the time at which the first byte of the packet was
+                # accepted from the host, and the time at which the tag itself started to be
+                # committed to the IN FIFO. Only one packet is in flight at a time, so neither FIFO
+                # holds any other data that could delay either event.
+                index = self.count[:9]
+                m.d.comb += [
+                    self.o_stream.payload.eq(self.i_stream.payload),
+                    self.o_stream.valid.eq(self.i_stream.valid),
+                    self.i_stream.ready.eq(self.o_stream.ready),
+                ]
+                with m.If(index >= 504):
+                    m.d.comb += self.o_stream.payload.eq(
+                        Cat(stamp_i, stamp_o).word_select(index[:3], 8))
+                with m.If(self.o_stream.ready & self.o_stream.valid):
+                    m.d.sync += self.count.eq(self.count + 1)
+                    with m.If(index == 0):
+                        m.d.sync += stamp_i.eq(timer)
+                    with m.If(index == 507):
+                        m.d.sync += stamp_o.eq(timer)
+                with m.Else():
+                    m.d.comb += [
+                        self.o_flush.eq(1),
+                    ]
+
         return m
 
 
+class _Channel:
+    def __init__(self, pipe, mode, error, count):
+        self.pipe    = pipe
+        self.mode    = mode
+        self.error   = error
+        self.count   = count
+
+
 class BenchmarkApplet(GlasgowAppletV2):
     logger = logging.getLogger(__name__)
     help = "evaluate communication performance"
@@ -107,22 +158,73 @@ class BenchmarkApplet(GlasgowAppletV2):
       on the host is measured (simulates cases where a transaction with the DUT relies on feedback
       from the host; also useful for comparing different usb stacks or usb data paths like hubs or
       network bridges)
+    * register: host writes a register and reads it back, the rate and the latency of these
+      round trips is measured (simulates applets that are controlled via registers); build with
+      ``--pipe-registers`` to measure register accesses over a pipe pair instead of I2C
+    * multi-pipe: the loopback benchmark runs concurrently on every pipe (simulates applets that
+      use several FIFOs at once); requires building the applet with ``--pipes 2``
+    * mixed: the loopback benchmark runs while the host continuously reads a register
+      (measures the impact of control transfers on bulk throughput)
+
+    With ``--breakdown``, the FPGA tags every packet it returns in the latency mode with the time
+    its first byte arrived and the time its tail was committed, and the latency mode additionally
+    reports:
+
+    * the time each packet spends inside the device;
+    * the time each packet spends in transit from the host to the device, and from the device back
+      to the host (including the time spent in the USB stack and the host controller);
+    * the number of USB microframes that elapse during each round trip (as reported by the FX2),
+      which shows how the host controller schedules the transfers.
+
+    The FPGA timestamps are mapped onto the host clock using a linear fit, which corrects for
+    the drift between the two clocks, but leaves a constant offset that cannot be measured without
+    a common time reference. The offset is chosen such that the fastest transfer in either
+    direction takes the same time; the variation of the transit time in each direction is
+    measured exactly. The extra requests needed to read the USB frame number make the benchmark
+    run slower, but do not affect the measured round trip time. Requires a firmware that supports
+    the USB frame number request.
+
+    With ``--json``, the results of every mode are additionally written to a file together with
+    the device revision, the firmware revision, and information about the host, which makes it
+    possible to track performance across releases.
     """
 
-    __all_modes = ["source", "sink", "loopback", "latency"]
+    __all_modes = ["source", "sink", "loopback", "latency", "register", "multi-pipe", "mixed"]
 
     @classmethod
     def add_build_arguments(cls, parser, access):
-        pass
+        parser.add_argument(
+            "--pipes", metavar="COUNT", type=int, choices=(1, 2), default=1,
+            help="instantiate COUNT loopback-capable pipes (default: %(default)s)")
+        parser.add_argument(
+            "--pipe-registers", default=False, action="store_true",
+            help="access registers over a dedicated pipe pair instead of I2C (only with one pipe)")
 
     def build(self, args):
+        if args.pipe_registers:
+            if args.pipes > 1:
+                raise GlasgowAppletError("--pipe-registers cannot be used with more than one pipe")
+            self.assembly.use_pipe_registers()
+
+        self._channels = []
         with self.assembly.add_applet(self):
-            component = self.assembly.add_submodule(BenchmarkComponent())
-            self._pipe = self.assembly.add_inout_pipe(
-                component.o_stream, component.i_stream, in_flush=component.o_flush)
-            self._mode = self.assembly.add_rw_register(component.mode)
-            self._error = self.assembly.add_ro_register(component.error)
-            self._count = self.assembly.add_ro_register(component.count)
+            for index in range(args.pipes):
+                component = self.assembly.add_submodule(BenchmarkComponent(),
+                    name=f"benchmark_{index}")
+                self._channels.append(_Channel(
+                    pipe=self.assembly.add_inout_pipe(
+                        component.o_stream, component.i_stream, in_flush=component.o_flush),
+                    mode=self.assembly.add_rw_register(component.mode),
+                    error=self.assembly.add_ro_register(component.error),
+                    count=self.assembly.add_ro_register(component.count),
+                ))
+            self._scratch = self.assembly.add_rw_register(Signal(32, name="scratch"))
+
+        channel = self._channels[0]
+        self._pipe  = channel.pipe
+        self._mode  = channel.mode
+        self._error = channel.error
+        self._count = channel.count
 
         sequence = array.array("H")
         sequence.extend(component.lfsr.generate())
@@ -136,26 +238,87 @@ class BenchmarkApplet(GlasgowAppletV2):
             "-c", "--count", metavar="COUNT", type=int, default=1 << 23,
             help="transfer COUNT bytes (default: %(default)s)")
 
+        parser.add_argument(
+            "--register-count", metavar="COUNT", type=int, default=1000,
+            help="perform COUNT register round trips in register mode (default: %(default)s)")
+
+        parser.add_argument(
+            "--breakdown", default=False, action="store_true",
+            help="split round trip time by direction and report USB microframes in latency mode")
+
+        parser.add_argument(
+            "--json", metavar="JSON-FILE", type=argparse.FileType("w"),
+            help="write benchmark results to JSON-FILE")
+
         parser.add_argument(
             dest="modes", metavar="MODE", type=str, nargs="*", choices=[[]] + cls.__all_modes,
             help="run benchmark mode MODE (default: {})".format(" ".join(cls.__all_modes)))
 
+    def _metadata(self):
+        libusb_version = usb1.getVersion()
+        return {
+            "device": {
+                "revision": self.device.revision,
+                "serial": self.device.serial,
+                "firmware": self.device.firmware_revision,
+            },
+            "host": {
+                "glasgow": __version__,
+                "python": f"{platform.python_implementation()} {platform.python_version()}",
+                "platform": platform.platform(),
+                "libusb": "{}.{}.{}.{}{}".format(*libusb_version[:5]),
+            },
+        }
+
+    @staticmethod
+    def _summarize(samples):
+        return {
+            "mean": statistics.mean(samples),
+            "stddev": statistics.pstdev(samples),
+            "worst": max(samples),
+        }
+
+    async def _loopback(self, channel, golden):
+        await channel.pipe.reset()
+        await channel.mode.set(Mode.LOOPBACK.value)
+
+        async def sender():
+            await channel.pipe.send(golden)
+            await channel.pipe.flush()
+        sender_fut = asyncio.ensure_future(sender())
+        actual = await channel.pipe.recv(len(golden))
+        await sender_fut
+        return actual == golden
+
     async def run(self, args):
         golden = bytearray()
         while len(golden) < args.count:
             golden += self._sequence[:args.count - len(golden)]
 
         # These requests are essentially free, as the data and control requests are independent,
-        # both on the FX2 and on the USB bus.
+        # both on the FX2 and on the USB bus. The `mixed` mode checks whether this is true.
         async def counter():
             while True:
                 await asyncio.sleep(0.1)
                 count = await self._count
                 self.logger.debug("transferred %#x/%#x", count, args.count)
 
+        results = {}
         for mode in args.modes or self.__all_modes:
-            self.logger.info("running benchmark mode %s for %.3f MiB",
-                             mode, len(golden) / (1 << 20))
+            if mode == "multi-pipe" and len(self._channels) < 2:
+                if args.modes:
+                    self.logger.error("mode %s requires building the applet with `--pipes 2`",
+                                      mode)
+                continue
+
+            if mode == "register":
+                self.logger.info("running benchmark mode %s for %d round trips",
+                                 mode, args.register_count)
+            else:
+                self.logger.info("running benchmark mode %s for %.3f MiB",
+                                 mode, len(golden) / (1 << 20))
+
+            result = {}
 
             if mode == "source":
                 await self._pipe.reset()
@@ -202,17 +365,54 @@ class BenchmarkApplet(GlasgowAppletV2):
                 error = (actual != golden)
                 count = None
 
+            if mode == "multi-pipe":
+                begin  = time.time()
+                passed = await asyncio.gather(*(self._loopback(channel, golden)
+                                                for channel in self._channels))
+                end    = time.time()
+                length = len(golden) * 2 * len(self._channels)
+
+                error = not all(passed)
+                count = None
+                result["pipes"] = len(self._channels)
+
+            if mode == "mixed":
+                requests = 0
+                async def requester():
+                    nonlocal requests
+                    while True:
+                        await self._count
+                        requests += 1
+
+                requester_fut = asyncio.ensure_future(requester())
+                begin  = time.time()
+                passed = await self._loopback(self._channels[0], golden)
+                end    = time.time()
+                length = len(golden) * 2
+                requester_fut.cancel()
+
+                error = not passed
+                count = None
+                result["control_rate"] = requests / (end - begin)
+
             if mode == "latency":
                 packetmax = golden[:512]
                 count = 0
                 error = False
                 roundtriptime = []
+                begins, ends, stamps, microframes = [], [], [], []
 
                 await self._pipe.reset()
-                await self._mode.set(Mode.LOOPBACK.value)
+                if args.breakdown:
+                    await self._mode.set(Mode.LATENCY.value)
+                else:
+                    await self._mode.set(Mode.LOOPBACK.value)
                 counter_fut = asyncio.ensure_future(counter())
 
                 while count < args.count:
+                    if args.breakdown:
+                        frame_begin = await self.device.usb_frame()
+
                     begin = time.perf_counter()
                     await self._pipe.send(packetmax)
                     await self._pipe.flush()
@@ -221,13 +421,50 @@ class BenchmarkApplet(GlasgowAppletV2):
 
                     # calculate roundtrip time in µs
                     roundtriptime.append((end - begin) * 1000000)
-                    if actual != packetmax:
+                    if args.breakdown:
+                        actual, tag = actual[:-8], actual[-8:]
+                        if actual != packetmax[:-8]:
+                            error = True
+                            break
+                    elif actual != packetmax:
                         error = True
                         break
                     count += len(packetmax) * 2
 
+                    if args.breakdown:
+                        frame_end = await self.device.usb_frame()
+                        microframes.append(self._microframe_delta(frame_begin, frame_end))
+                        begins.append(begin)
+                        ends.append(end)
+                        stamps.append(struct.unpack("<LL", tag))
+
                 counter_fut.cancel()
 
+            if mode == "register":
+                count = 0
+                error = False
+                writetime = []
+                readtime = []
+
+                begin = time.time()
+                while count < args.register_count:
+                    value = (count * 0x9e3779b1) & 0xffffffff
+
+                    write_begin = time.perf_counter()
+                    await self._scratch.set(value)
+                    write_end = time.perf_counter()
+                    actual = await self._scratch
+                    read_end = time.perf_counter()
+
+                    writetime.append((write_end - write_begin) * 1000000)
+                    readtime.append((read_end - write_end) * 1000000)
+                    if actual != value:
+                        error = True
+                        break
+                    count += 1
+                end = time.time()
+
+            result["error"] = bool(error)
             if error:
                 if count is None:
                     self.logger.error("mode %s failed!", mode)
@@ -235,16 +472,109 @@ class BenchmarkApplet(GlasgowAppletV2):
                     self.logger.error("mode %s failed at %#x!", mode, count)
             else:
                 if mode == "latency":
+                    result["roundtrip"] = self._summarize(roundtriptime)
                     self.logger.info("mode %s: mean: %.2f µs stddev: %.2f µs worst: %.2f µs",
                                  mode,
                                  statistics.mean(roundtriptime),
                                  statistics.pstdev(roundtriptime),
                                  max(roundtriptime))
+                    if args.breakdown:
+                        devicetime, outtime, intime = self._breakdown(
+                            begins, ends, stamps, self.assembly.sys_clk_period)
+                        for key, name, samples in (
+                            ("device",         "device",         devicetime),
+                            ("host_to_device", "host to device", outtime),
+                            ("device_to_host", "device to host", intime),
+                        ):
+                            result[key] = self._summarize(samples)
+                            self.logger.info("mode %s: %s: mean: %.2f µs stddev: %.2f µs "
+                                             "worst: %.2f µs",
+                                         mode, name,
+                                         statistics.mean(samples),
+                                         statistics.pstdev(samples),
+                                         max(samples))
+                        result["microframes"] = self._summarize(microframes)
+                        self.logger.info("mode %s: microframes: mean: %.2f worst: %d",
+                                     mode,
+                                     statistics.mean(microframes),
+                                     max(microframes))
+                elif mode == "register":
+                    result["rate"] = count / (end - begin)
+                    result["write"] = self._summarize(writetime)
+                    result["read"] = self._summarize(readtime)
+                    self.logger.info("mode %s: %.0f round trips/s",
+                                 mode,
+                                 result["rate"])
+                    self.logger.info("mode %s: write: mean: %.2f µs stddev: %.2f µs "
+                                     "worst: %.2f µs",
+                                 mode,
+                                 statistics.mean(writetime),
+                                 statistics.pstdev(writetime),
+                                 max(writetime))
+                    self.logger.info("mode %s: read: mean: %.2f µs stddev: %.2f µs "
+                                     "worst: %.2f µs",
+                                 mode,
+                                 statistics.mean(readtime),
+                                 statistics.pstdev(readtime),
+                                 max(readtime))
                 else:
+                    result["throughput"] = length / (end - begin)
                     self.logger.info("mode %s: %.2f MiB/s (%.2f Mb/s)",
                                  mode,
                                  (length / (end - begin)) / (1 << 20),
                                  (length / (end - begin)) / (1 << 17))
+                    if mode == "mixed":
+                        self.logger.info("mode %s: %.0f control requests/s",
+                                     mode,
+                                     result["control_rate"])
+
+            results[mode] = result
+
+        if args.json:
+            json.dump({
+                **self._metadata(),
+                "count": args.count,
+                "results": results,
+            }, args.json, indent=2)
+            args.json.write("\n")
+
+    @staticmethod
+    def _microframe_delta(begin, end):
+        # Frame numbers are 11 bits wide, and there are 8 microframes per frame.
+        (begin_frame, begin_uframe), (end_frame, end_uframe) = begin, end
+        return ((end_frame * 8 + end_uframe) - (begin_frame * 8 + begin_uframe)) % (2048 * 8)
+
+    @staticmethod
+    def _breakdown(begins, ends, stamps, period):
+        # Unwrap the 32-bit FPGA timestamps, relying on consecutive round trips being much closer
+        # together than the period of the timer, and convert them to seconds.
+        fpga_i, fpga_o = [], []
+        elapsed, last_i = 0, stamps[0][0]
+        for stamp_i, stamp_o in stamps:
+            elapsed += (stamp_i - last_i) & 0xffffffff
+            last_i = stamp_i
+            fpga_i.append(elapsed * period)
+            fpga_o.append((elapsed + ((stamp_o - stamp_i) & 0xffffffff)) * period)
+
+        # The FPGA clock and the host clock drift apart; measure the rate of the FPGA clock in
+        # terms of the host clock by fitting the midpoints of the round trips as seen on the host
+        # against those seen on the FPGA.
+        if len(stamps) > 1:
+            rate, _ = statistics.linear_regression(
+                [(i + o) / 2 for i, o in zip(fpga_i, fpga_o)],
+                [(b + e) / 2 for b, e in zip(begins, ends)])
+        else:
+            rate = 1
+        device  = [(o - i) * rate for i, o in zip(fpga_i, fpga_o)]
+        outward = [i * rate - b for i, b in zip(fpga_i, begins)]
+        inward  = [e - o * rate for o, e in zip(fpga_o, ends)]
+
+        # The offset between the two clocks cannot be measured; choose it such that the fastest
+        # transfers in both directions take the same time.
+        offset  = (min(inward) - min(outward)) / 2
+        outward = [t + offset for t in outward]
+        inward  = [t - offset for t in inward]
+        return tuple([t * 1000000 for t in ts] for ts in (device, outward, inward))
 
     @classmethod
     def tests(cls):
@@ -1,8 +1,46 @@
+import unittest
+
 from glasgow.applet import GlasgowAppletV2TestCase, synthesis_test
 from . import BenchmarkApplet
 
 
+class BenchmarkBreakdownTestCase(unittest.TestCase):
+    def test_microframe_delta(self):
+        self.assertEqual(BenchmarkApplet._microframe_delta((10, 7), (11, 1)), 2)
+        self.assertEqual(BenchmarkApplet._microframe_delta((2047, 6), (0, 2)), 4)
+
+    def test_breakdown(self):
+        # The FPGA clock runs 50 ppm fast, is offset from the host clock, and its timer wraps
+        # around during the run.
+        period  = 1 / 48e6
+        rate    = 1 + 50e-6
+        outward = [(100 + 30 * (index % 3)) * 1e-6 for index in range(240)]
+        device  = [(11 + (index % 2)) * 1e-6 for index in range(240)]
+        inward  = [(100 + 80 * (index % 4 == 1)) * 1e-6 for index in range(240)]
+        begins, ends, stamps = [], [], []
+        for index, (t_out, t_dev, t_in) in enumerate(zip(outward, device, inward)):
+            begin = 1000.0 + index * 1e-3
+            fpga_i = (begin + t_out) * rate / period - 0xffff0000
+            fpga_o = fpga_i + t_dev * rate / period
+            begins.append(begin)
+            ends.append(begin + t_out + t_dev + t_in)
+            stamps.append((round(fpga_i) & 0xffffffff, round(fpga_o) & 0xffffffff))
+
+        for actual, expected in zip(BenchmarkApplet._breakdown(begins, ends, stamps, period),
+                                    (device, outward, inward)):
+            for actual_us, expected_s in zip(actual, expected):
+                self.assertAlmostEqual(actual_us, expected_s * 1e6, delta=0.5)
+
+
 class BenchmarkAppletTestCase(GlasgowAppletV2TestCase, applet=BenchmarkApplet):
     @synthesis_test
     def test_build(self):
         self.assertBuilds()
+
+    @synthesis_test
+    def test_build_pipes(self):
+        self.assertBuilds("--pipes 2")
+
+    @synthesis_test
+    def test_build_pipe_registers(self):
+        self.assertBuilds("--pipe-registers")
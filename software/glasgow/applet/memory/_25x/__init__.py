@@ -3,6 +3,7 @@
 
 import re
 import sys
+import zlib
 import struct
 import logging
 import argparse
@@ -15,6 +16,7 @@ from glasgow.database.jedec import *
 from glasgow.protocol.sfdp import *
 from glasgow.applet import GlasgowAppletError, GlasgowAppletV2
 from glasgow.applet.interface.qspi_controller import QSPIControllerInterface, QSPIControllerApplet
+from glasgow.applet.interface.qspi_controller import QSPIControllerError
 
 
 __all__ = ["Memory25xError", "Memory25xInterface"]
@@ -37,6 +39,15 @@ BIT_ERR  = 0b10000000
 
 
 class Memory25xInterface:
+    # Interval between status register reads while waiting for a write or erase to complete.
+    poll_interval_us = 10
+    # Time after which a write or erase that is still in progress is considered to have failed;
+    # a chip erase of a large flash can take several minutes. (The time it takes to read the status
+    # register is not included, so the actual timeout is somewhat longer.)
+    poll_timeout_us = 1_000_000_000
+    # Number of pages programmed before checking whether the earliest of them have succeeded.
+    program_window = 16
+
     def __init__(self, logger, assembly, *, cs, sck, io):
         self._logger = logger
         self._level  = logging.DEBUG if self._logger.name == __name__ else logging.TRACE
@@ -116,6 +127,19 @@ class Memory25xInterface:
         return await self._read_command(address, length, chunk_size, cmd=0x0B, dummy=1,
                                         callback=callback)
 
+    async def checksum(self, address, length, chunk_size):
+        """Compute CRC-32 (as :func:`zlib.crc32`) of every ``chunk_size`` bytes of a memory region.
+
+        The memory is read using FAST READ command, but only the checksums are sent to the host.
+        """
+        self._log("checksum addr=%#08x len=%d chunk=%d", address, length, chunk_size)
+        async with self.qspi.select():
+            await self.qspi.write(bytes([0x0B, *self._format_addr(address)]))
+            await self.qspi.dummy(8)
+            checksums = await self.qspi.digest(length, chunk_size=chunk_size)
+        self._log("checksums=<%s>", " ".join(f"{checksum:08x}" for checksum in checksums))
+        return checksums
+
     async def read_sfdp(self, address, length):
         self._log("read sfdp addr=%#08x len=%d", address, length)
         return await self._read_command(address, length, chunk_size=0x100, cmd=0x5A, dummy=1)
@@ -144,53 +168,101 @@ class Memory25xInterface:
                 raise Memory25xError(f"{command} command failed (status {status:08b})")
         return bool(status & BIT_WIP)
 
+    async def _submit_completion_poll(self):
+        # The controller waits for WIP to clear on its own, then reads the status once more;
+        # see `_check_completion()` for why.
+        await self.qspi.submit_poll(0x05, BIT_WIP, interval_us=self.poll_interval_us,
+            max_polls=self.poll_timeout_us // self.poll_interval_us)
+        await self.qspi.submit_poll(0x05, 0)
+
+    async def _check_completion(self, commands):
+        try:
+            statuses = await self.qspi.collect_polls(2 * len(commands))
+        except QSPIControllerError as error:
+            # Only the first poll of each pair (waiting for WIP to clear) can time out.
+            command = commands[error.index // 2]
+            commands.clear()
+            raise Memory25xError(f"{command} command timed out "
+                                 f"(status {error.octets[error.index]:08b})") from error
+        for command, status in zip(commands, zip(statuses[0::2], statuses[1::2])):
+            self._log("%s completed status=%s", command, f"{status[0]:#010b}")
+            # See comment in `write_in_progress()`; WEL is only meaningful if it is still set
+            # when the status is read for the second time.
+            if status[0] & BIT_WEL and status[1] & BIT_WEL and not status[1] & BIT_WIP:
+                raise Memory25xError(f"{command} command failed (status {status[1]:08b})")
+        commands.clear()
+
+    async def _wait_for_completion(self, command):
+        await self._submit_completion_poll()
+        await self._check_completion([command])
+
     async def write_status(self, status):
         self._log("write status=%s", f"{status:#010b}")
         await self._command(0x01, arg=[status])
-        while await self.write_in_progress(command="WRITE STATUS"): pass
+        await self._wait_for_completion("WRITE STATUS")
 
     async def sector_erase(self, address):
         self._log("sector erase addr=%#08x", address)
         await self._command(0x20, arg=self._format_addr(address))
-        while await self.write_in_progress(command="SECTOR ERASE"): pass
+        await self._wait_for_completion("SECTOR ERASE")
 
     async def block_erase(self, address):
         self._log("block erase addr=%#08x", address)
         await self._command(0x52, arg=self._format_addr(address))
-        while await self.write_in_progress(command="BLOCK ERASE"): pass
+        await self._wait_for_completion("BLOCK ERASE")
 
     async def chip_erase(self):
         self._log("chip erase")
         await self._command(0x60)
-        while await self.write_in_progress(command="CHIP ERASE"): pass
+        await self._wait_for_completion("CHIP ERASE")
 
     async def page_program(self, address, data):
         data = bytes(data)
         self._log("page program addr=%#08x data=<%s>", address, data.hex())
         await self._command(0x02, arg=self._format_addr(address) + data)
-        while await self.write_in_progress(command="PAGE PROGRAM"): pass
+        await self._wait_for_completion("PAGE PROGRAM")
 
     async def program(self, address, data, page_size,
                       callback=lambda done, total, status: None):
         data = bytes(data)
         done, total = 0, len(data)
+        # Pages are submitted without waiting for the previous ones to be programmed, since
+        # the controller waits for completion by itself; this way, the data for the next page
+        # is already in the device while the current one is being programmed.
+        pending = []
         while len(data) > 0:
             chunk    = data[:page_size - address % page_size]
             data     = data[len(chunk):]
 
             callback(done, total, f"programming page {address:#08x}")
             await self.write_enable()
-            await self.page_program(address, chunk)
+            self._log("page program addr=%#08x data=<%s>", address, chunk.hex())
+            await self._command(0x02, arg=self._format_addr(address) + chunk)
+            await self._submit_completion_poll()
+            pending.append("PAGE PROGRAM")
+            if len(pending) == self.program_window:
+                await self._check_completion(pending)
 
             address += len(chunk)
             done    += len(chunk)
 
+        if pending:
+            await self._check_completion(pending)
         callback(done, total, None)
 
-    async def erase_program(self, address, data, sector_size, page_size,
+    async def erase_program(self, address, data, sector_size, page_size, *, differential=False,
                             callback=lambda done, total, status: None):
         data = bytes(data)
         done, total = 0, len(data)
+        if differential and len(data) > 0:
+            # Only the checksums of the sectors are read back, and the sectors whose contents
+            # already match are left alone.
+            first_sector = address & ~(sector_size - 1)
+            last_sector  = (address + len(data) - 1) & ~(sector_size - 1)
+            callback(done, total, f"checksumming sectors {first_sector:#08x}-{last_sector:#08x}")
+            checksums = await self.checksum(first_sector,
+                last_sector + sector_size - first_sector, sector_size)
+            checksums = dict(zip(range(first_sector, last_sector + 1, sector_size), checksums))
         while len(data) > 0:
             chunk    = data[:sector_size - address % sector_size]
             data     = data[len(chunk):]
@@ -202,14 +274,17 @@ class Memory25xInterface:
                 sector_data = await self.read(sector_start, sector_size)
                 sector_data[address % sector_size:(address % sector_size) + len(chunk)] = chunk
 
-            callback(done, total, f"erasing sector {sector_start:#08x}")
-            await self.write_enable()
-            await self.sector_erase(sector_start)
+            if differential and zlib.crc32(sector_data) == checksums[sector_start]:
+                self._log("sector %#08x unchanged", sector_start)
+            else:
+                callback(done, total, f"erasing sector {sector_start:#08x}")
+                await self.write_enable()
+                await self.sector_erase(sector_start)
 
-            if not re.match(rb"^\xff*$", sector_data):
-                await self.program(sector_start, sector_data, page_size,
-                    callback=lambda page_done, page_total, status:
-                                callback(done + page_done, total, status))
+                if not re.match(rb"^\xff*$", sector_data):
+                    await self.program(sector_start, sector_data, page_size,
+                        callback=lambda page_done, page_total, status:
+                                    callback(done + page_done, total, status))
 
             address += len(chunk)
             done    += len(chunk)
@@ -368,6 +443,9 @@ class Memory25xApplet(GlasgowAppletV2):
         p_erase_program.add_argument(
             "-S", "--sector-size", metavar="SIZE", type=length, required=True,
             help="erase memory in SIZE byte sectors")
+        p_erase_program.add_argument(
+            "-D", "--differential", default=False, action="store_true",
+            help="only erase and program sectors whose contents differ from the data")
         add_page_argument(p_erase_program)
         add_program_arguments(p_erase_program)
 
@@ -379,7 +457,7 @@ class Memory25xApplet(GlasgowAppletV2):
             help="set SR.BP[3:0] to BITS")
 
         p_verify = p_operation.add_parser(
-            "verify", help="read memory using READ command and verify contents")
+            "verify", help="verify memory contents using checksums of FAST READ command data")
         add_program_arguments(p_verify)
 
     @staticmethod
@@ -463,7 +541,8 @@ class Memory25xApplet(GlasgowAppletV2):
                                          callback=self._show_progress)
             if args.operation == "erase-program":
                 await self.m25x_iface.erase_program(args.address, data, args.sector_size,
-                                               args.page_size, callback=self._show_progress)
+                                               args.page_size, differential=args.differential,
+                                               callback=self._show_progress)
 
         if args.operation == "verify":
             if args.data is not None:
@@ -471,17 +550,25 @@ class Memory25xApplet(GlasgowAppletV2):
             if args.file is not None:
                 gold_data = args.file.read()
 
-            flash_data = await self.m25x_iface.read(args.address, len(gold_data))
-            if gold_data == flash_data:
-                self.logger.info("verify PASS")
-            else:
-                for offset, (gold_byte, flash_byte) in enumerate(zip(gold_data, flash_data)):
+            # Only the chunk that does not match is read back, to locate the differing byte.
+            chunk_size = 0x1000
+            checksums = await self.m25x_iface.checksum(args.address, len(gold_data), chunk_size)
+            for offset, checksum in zip(range(0, len(gold_data), chunk_size), checksums):
+                gold_chunk = gold_data[offset:offset + chunk_size]
+                if zlib.crc32(gold_chunk) == checksum:
+                    continue
+                flash_chunk = await self.m25x_iface.read(args.address + offset, len(gold_chunk))
+                for index, (gold_byte, flash_byte) in enumerate(zip(gold_chunk, flash_chunk)):
                     if gold_byte != flash_byte:
-                        different_at = args.address + offset
+                        self.logger.error("first differing byte at %#08x (expected %#04x, "
+                                          "actual %#04x)", args.address + offset + index,
+                                          gold_byte, flash_byte)
                         break
-                self.logger.error("first differing byte at %#08x (expected %#04x, actual %#04x)",
-                                  different_at, gold_byte, flash_byte)
+                else:
+                    self.logger.error("checksum mismatch at %#08x", args.address + offset)
                 raise GlasgowAppletError("verify FAIL")
+            else:
+                self.logger.info("verify PASS")
 
         if args.operation in ("erase-sector", "erase-block"):
             for address in args.addresses:
@@ -1,3 +1,4 @@
+import zlib
 import unittest
 
 from glasgow.applet import GlasgowAppletV2TestCase, synthesis_test, applet_v2_hardware_test
@@ -119,3 +120,26 @@ class Memory25xAppletTestCase(GlasgowAppletV2TestCase, applet=Memory25xApplet):
             page_size=0x100, sector_size=self.dut_sector_size)
         self.assertEqual(await applet.m25x_iface.read(0, 13),
                          b"Bye  , world!")
+
+    @applet_v2_hardware_test(prepare=prepare_flash_data, args=hardware_args, mock="m25x_iface.qspi")
+    async def test_api_checksum(self, applet):
+        sector_0 = b"Hello, world!"  + b"\xff" * (self.dut_sector_size - 13)
+        sector_1 = b"Some more data" + b"\xff" * (self.dut_sector_size - 14)
+        self.assertEqual(await applet.m25x_iface.checksum(0, self.dut_sector_size * 2,
+                                                          self.dut_sector_size),
+                         [zlib.crc32(sector_0), zlib.crc32(sector_1)])
+        # the last chunk is shorter
+        self.assertEqual(await applet.m25x_iface.checksum(4, 20, 8),
+                         [zlib.crc32(sector_0[4:12]), zlib.crc32(sector_0[12:20]),
+                          zlib.crc32(sector_0[20:24])])
+
+    @applet_v2_hardware_test(prepare=prepare_flash_data, args=hardware_args, mock="m25x_iface.qspi")
+    async def test_api_erase_program_differential(self, applet):
+        # the first sector is unchanged and is neither erased nor programmed
+        await applet.m25x_iface.erase_program(7,
+            b"world!" + b"\xff" * (self.dut_sector_size - 13) + b"Same",
+            page_size=0x100, sector_size=self.dut_sector_size, differential=True)
+        self.assertEqual(await applet.m25x_iface.read(0, 13),
+                         b"Hello, world!")
+        self.assertEqual(await applet.m25x_iface.read(self.dut_sector_size, 14),
+                         b"Same more data")
@@ -296,12 +296,15 @@
 # however many are necessary for the PLL in the controller to lock, and some more to pad the space
 # on the track where its end meets its beginning. Such a floppy would have a much larger density.
 
+import os
 import logging
 import asyncio
 import argparse
 import struct
 import random
 import itertools
+import collections
+import concurrent.futures
 import math
 from amaranth import *
 from amaranth.lib import cdc, io
@@ -924,19 +927,22 @@ class MemoryFloppyAppletTool(GlasgowAppletTool, applet=MemoryFloppyApplet):
         p_index.add_argument(
             "--ignore-data-crc", action="store_true", default=False,
             help="do not reject sector data with incorrect CRC")
+        self._add_jobs_argument(p_index)
         p_index.add_argument(
             "file", metavar="RAW-FILE", type=argparse.FileType("rb"),
             help="read raw disk image from RAW-FILE")
 
     def _run_index(self, args):
-        for cylinder, head, bytestream in self.iter_tracks(args.file):
+        if args.no_decode:
+            for cylinder, head, bytestream in self.iter_tracks(args.file):
+                self.logger.info("indexing C/H %d/%d: %d edges captured",
+                                 cylinder, head, len(bytestream))
+            return
+
+        for cylinder, head, bytestream, symbstream in \
+                self.iter_decoded_tracks(args.file, jobs=args.jobs):
             self.logger.info("indexing C/H %d/%d: %d edges captured",
                              cylinder, head, len(bytestream))
-            if args.no_decode:
-                continue
-
-            mfm        = SoftwareMFMDecoder(self.logger)
-            symbstream = mfm.demodulate(mfm.lock(mfm.bits(bytestream)))
             for _ in self.iter_mfm_sectors(symbstream, verbose=True,
                     ignore_data_crc=args.ignore_data_crc):
                 pass
@@ -954,6 +960,7 @@ class MemoryFloppyAppletTool(GlasgowAppletTool, applet=MemoryFloppyApplet):
         p_raw2img.add_argument(
             "-t", "--sectors-per-track", metavar="COUNT", type=int, required=True,
             help="amount of sectors per track (9 for DD, 18 for HD, ...)")
+        self._add_jobs_argument(p_raw2img)
         p_raw2img.add_argument(
             "raw_file", metavar="RAW-FILE", type=argparse.FileType("rb"),
             help="read raw disk image from RAW-FILE")
@@ -968,12 +975,10 @@ class MemoryFloppyAppletTool(GlasgowAppletTool, applet=MemoryFloppyApplet):
 
         try:
             curr_lba = 0
-            for cylinder, head, bytestream in self.iter_tracks(args.raw_file):
+            for cylinder, head, bytestream, symbstream in \
+                    self.iter_decoded_tracks(args.raw_file, jobs=args.jobs):
                 self.logger.info("processing C/H %d/%d", cylinder, head)
 
-                mfm        = SoftwareMFMDecoder(self.logger)
-                symbstream = mfm.demodulate(mfm.lock(mfm.bits(bytestream)))
-
                 sectors    = {}
                 seen       = set()
                 for (cyl, hd, sec), data in self.iter_mfm_sectors(symbstream,
@@ -1026,6 +1031,12 @@ class MemoryFloppyAppletTool(GlasgowAppletTool, applet=MemoryFloppyApplet):
         finally:
             self.logger.info("%d/%d sectors missing", missing, last_lba)
 
+    @staticmethod
+    def _add_jobs_argument(parser):
+        parser.add_argument(
+            "-j", "--jobs", metavar="COUNT", type=int, default=os.cpu_count() or 1,
+            help="decode up to COUNT tracks in parallel (default: %(default)s)")
+
     def iter_tracks(self, file):
         while True:
             header = file.read(struct.calcsize(">LBB"))
@@ -1033,6 +1044,31 @@ class MemoryFloppyAppletTool(GlasgowAppletTool, applet=MemoryFloppyApplet):
             size, cylinder, head = struct.unpack(">LBB", header)
             yield cylinder, head, file.read(size)
 
+    def iter_decoded_tracks(self, file, *, jobs=1):
+        # Tracks are decoded in worker processes while the following ones are being read;
+        # the messages logged by the decoder are emitted once the symbols are consumed.
+        def symbstream(symbols, records):
+            for level, message, args in records:
+                self.logger.log(level, message, *args)
+            yield from symbols
+
+        if jobs == 1:
+            for cylinder, head, bytestream in self.iter_tracks(file):
+                yield cylinder, head, bytestream, symbstream(*decode_track(bytestream))
+            return
+
+        with concurrent.futures.ProcessPoolExecutor(jobs) as executor:
+            pending = collections.deque()
+            for cylinder, head, bytestream in self.iter_tracks(file):
+                pending.append((cylinder, head, bytestream,
+                                executor.submit(decode_track, bytestream)))
+                if len(pending) > jobs:
+                    cylinder, head, bytestream, future = pending.popleft()
+                    yield cylinder, head, bytestream, symbstream(*future.result())
+            while pending:
+                cylinder, head, bytestream, future = pending.popleft()
+                yield cylinder, head, bytestream, symbstream(*future.result())
+
     crc_mfm = staticmethod(CRC16_CCITT_FALSE(data_width=8).compute)
 
     def iter_mfm_sectors(self, symbstream, *, verbose=False, ignore_data_crc=False):
@@ -1,10 +1,42 @@
 import logging
 
 
-__all__ = ["SoftwareMFMDecoder"]
+__all__ = ["SoftwareMFMDecoder", "decode_track"]
+
+
+_SYNC_CHIPS = bytes([0,1,0,0,0,1,0,0,1,0,0,0,1,0,0,1])
+
+
+def _build_cell_table():
+    # Maps the chips of every valid MFM encoded byte, given the preceding bit, to the byte and
+    # its last bit.
+    table = {}
+    for prev_init in (0, 1):
+        for value in range(256):
+            prev, chips = prev_init, bytearray()
+            for n in range(7, -1, -1):
+                curr = (value >> n) & 1
+                if curr:
+                    chips += b"\x00\x01"
+                elif prev:
+                    chips += b"\x00\x00"
+                else:
+                    chips += b"\x01\x00"
+                prev = curr
+            table[prev_init, bytes(chips)] = (value, prev)
+    return table
 
 
 class SoftwareMFMDecoder:
+    """MFM decoder.
+
+    The :meth:`edges`, :meth:`bits`, :meth:`domains`, :meth:`lock`, and :meth:`demodulate`
+    generators process one sample at a time, and are useful for debugging; :meth:`decode`
+    produces the same result for an entire track at once, and is much faster.
+    """
+
+    _cell_table = _build_cell_table()
+
     def __init__(self, logger):
         self._logger    = logger
         self._lock_time = 0
@@ -134,3 +166,179 @@ class SoftwareMFMDecoder:
                     if len(bits) == 8:
                         yield (0, sum(bit << (7 - n) for n, bit in enumerate(bits)))
                         bits = []
+
+    def decode(self, bytestream, *,
+               nco_init_period=0, nco_min_period=16, nco_max_period=256,
+               nco_frac_bits=8, pll_kp_exp=2, pll_gph_exp=1):
+        """Decode an entire track.
+
+        Returns the same symbols as ``demodulate(lock(bits(bytestream)))``, and logs the same
+        messages.
+        """
+        return self._demodulate_chips(self._lock_chips(bytestream,
+            nco_init_period=nco_init_period, nco_min_period=nco_min_period,
+            nco_max_period=nco_max_period, nco_frac_bits=nco_frac_bits,
+            pll_kp_exp=pll_kp_exp, pll_gph_exp=pll_gph_exp))
+
+    def _lock_chips(self, bytestream, *,
+                    nco_init_period, nco_min_period, nco_max_period,
+                    nco_frac_bits, pll_kp_exp, pll_gph_exp):
+        # This is the same PLL as in `lock()`, but instead of stepping through every sample, it
+        # steps through every byte of the raw data: between the edges, the NCO phase increases
+        # linearly, so the samples until the end of the current bit cell are skipped at once.
+        nco_min    = nco_min_period << nco_frac_bits
+        nco_max    = nco_max_period << nco_frac_bits
+        nco_period = nco_init_period << nco_frac_bits
+        nco_phase  = 0
+        nco_step   = 1 << nco_frac_bits
+        pll_gain_min = 1 << pll_gph_exp
+        pll_feedbk = 0
+        bit_curr   = 0
+
+        chips      = bytearray()
+        prev_byte  = 0
+        for byte in bytestream:
+            if prev_byte != 0xfd:
+                if nco_period < nco_min:
+                    nco_period = nco_min
+                if nco_period >= nco_max:
+                    nco_period = nco_max
+
+                bit_curr    = 1
+                pll_error   = nco_phase - (nco_period >> 1)
+                pll_gain    = max(pll_gain_min, abs(pll_error) >> pll_kp_exp)
+                if pll_error < 0:
+                    pll_feedbk = +pll_gain
+                else:
+                    pll_feedbk = -pll_gain
+
+                if nco_phase >= nco_period:
+                    nco_phase   = 0
+                    chips.append(bit_curr)
+                    bit_curr    = 0
+                else:
+                    nco_phase  += nco_step + pll_feedbk
+                    nco_period -= pll_feedbk >> pll_gph_exp
+                    pll_feedbk  = 0
+            prev_byte = byte
+
+            samples = byte
+            while samples > 0:
+                if nco_period < nco_min:
+                    nco_period = nco_min
+                if nco_period >= nco_max:
+                    nco_period = nco_max
+
+                if nco_phase >= nco_period:
+                    nco_phase   = 0
+                    chips.append(bit_curr)
+                    bit_curr    = 0
+                    samples    -= 1
+                elif pll_feedbk:
+                    nco_phase  += nco_step + pll_feedbk
+                    nco_period -= pll_feedbk >> pll_gph_exp
+                    pll_feedbk  = 0
+                    samples    -= 1
+                else:
+                    steps       = min(samples, -((nco_phase - nco_period) // nco_step))
+                    nco_phase  += steps * nco_step
+                    samples    -= steps
+
+        return bytes(chips)
+
+    def _demodulate_chips(self, chips):
+        # This is the same state machine as in `demodulate()`, but all of the sync marks are
+        # located upfront, and the bytes that do not contain a sync mark or an invalid bit cell
+        # are decoded using a lookup table.
+        syncs  = []
+        offset = chips.find(_SYNC_CHIPS)
+        while offset != -1:
+            syncs.append(offset)
+            offset = chips.find(_SYNC_CHIPS, offset + 1)
+        syncs.append(len(chips))
+
+        symbols = []
+        last    = len(chips) - 64 # `demodulate()` stops once it has less than 64 chips buffered
+        offset  = 0
+        synced  = False
+        prev    = 0
+        bits    = 0
+        value   = 0
+        sync_index = 0
+        while offset <= last:
+            while syncs[sync_index] < offset:
+                sync_index += 1
+            next_sync = syncs[sync_index]
+
+            if not synced:
+                # `demodulate()` would find the sync mark while examining the chip before it.
+                offset = max(offset, next_sync - 1)
+                if offset > last:
+                    break
+                sync_offset = next_sync - offset
+            elif next_sync - offset in (0, 1):
+                sync_offset = next_sync - offset
+            else:
+                sync_offset = None
+
+            if sync_offset is not None:
+                if not synced or sync_offset != 0:
+                    self._log("sync=K.A1 chip-off=%d", next_sync)
+                offset  = next_sync + 16
+                synced  = True
+                prev    = 1
+                bits    = 0
+                value   = 0
+                symbols.append((1, 0xA1))
+                continue
+
+            if bits == 0 and offset + 14 <= last and next_sync > offset + 15:
+                decoded = self._cell_table.get((prev, chips[offset:offset + 16]))
+                if decoded is not None:
+                    value, prev = decoded
+                    offset += 16
+                    symbols.append((0, value))
+                    continue
+
+            cell = chips[offset:offset + 2]
+            if cell == b"\x00\x01":
+                curr = 1
+            elif prev == 1 and cell == b"\x00\x00":
+                curr = 0
+            elif prev == 0 and cell == b"\x01\x00":
+                curr = 0
+            else:
+                synced = False
+                self._log("desync chip-off=%d bitno=%d prev=%d cell=%d%d",
+                          offset, bits, prev, *cell)
+                continue
+
+            offset += 2
+            prev    = curr
+            value   = (value << 1) | curr
+            bits   += 1
+            if bits == 8:
+                symbols.append((0, value))
+                bits    = 0
+                value   = 0
+
+        return symbols
+
+
+class _LogRecorder:
+    def __init__(self):
+        self.records = []
+
+    def log(self, level, message, *args):
+        self.records.append((level, message, args))
+
+
+def decode_track(bytestream):
+    """Decode a track using :meth:`SoftwareMFMDecoder.decode`.
+
+    Returns the symbols, and the log records to be emitted with ``logger.log(level, message,
+    *args)``. This function can be used in a worker process.
+    """
+    recorder = _LogRecorder()
+    symbols  = SoftwareMFMDecoder(recorder).decode(bytestream)
+    return symbols, recorder.records
@@ -1,8 +1,77 @@
+import random
+import logging
+import unittest
+
 from ... import *
 from . import MemoryFloppyApplet
+from .mfm import SoftwareMFMDecoder
 
 
 class MemoryFloppyAppletTestCase(GlasgowAppletTestCase, applet=MemoryFloppyApplet):
     @synthesis_test
     def test_build(self):
         self.assertBuilds()
+
+
+class SoftwareMFMDecoderTestCase(unittest.TestCase):
+    @staticmethod
+    def make_track(seed, *, jitter, noise):
+        # Encode a few ID and data marks with random contents as MFM, and then as raw data (one
+        # octet per edge) sampled at 48 samples per bit cell, with some jitter and corruption.
+        rng   = random.Random(seed)
+        chips = []
+        prev  = 0
+        def encode(data):
+            nonlocal prev
+            for byte in data:
+                for n in range(7, -1, -1):
+                    bit = (byte >> n) & 1
+                    chips.extend([0, 1] if bit else [0, 0] if prev else [1, 0])
+                    prev = bit
+        for sector in range(4):
+            encode(b"\x4e" * 20 + b"\x00" * 12)
+            chips.extend([0,1,0,0,0,1,0,0,1,0,0,0,1,0,0,1] * 3)
+            prev = 1
+            encode(bytes([0xfe, 0, 0, 1 + sector, 2]) + rng.randbytes(514))
+
+        bytestream = bytearray()
+        length = 0
+        for chip in chips:
+            length += 48
+            if chip:
+                bytestream.append(length + rng.randint(-jitter, jitter) - 1)
+                length = 0
+        for _ in range(noise):
+            bytestream[rng.randrange(len(bytestream))] = rng.randrange(256)
+        return bytes(bytestream)
+
+    def assertDecodesSame(self, bytestream, **kwargs):
+        with self.assertLogs(level=logging.DEBUG) as generator_logs:
+            logging.getLogger().debug("start")
+            mfm = SoftwareMFMDecoder(logging.getLogger())
+            generator_symbols = list(mfm.demodulate(mfm.lock(mfm.bits(bytestream), **kwargs)))
+        with self.assertLogs(level=logging.DEBUG) as batch_logs:
+            logging.getLogger().debug("start")
+            batch_symbols = SoftwareMFMDecoder(logging.getLogger()).decode(bytestream, **kwargs)
+        self.assertEqual(batch_symbols, generator_symbols)
+        self.assertEqual(batch_logs.output, generator_logs.output)
+        return batch_symbols
+
+    def test_clean(self):
+        symbols = self.assertDecodesSame(self.make_track(0, jitter=0, noise=0),
+                                         nco_init_period=48)
+        self.assertEqual(symbols.count((1, 0xa1)), 12)
+
+    def test_jitter(self):
+        for seed in range(2):
+            with self.subTest(seed=seed):
+                self.assertDecodesSame(self.make_track(seed, jitter=4, noise=0))
+
+    def test_noise(self):
+        for seed in range(2):
+            with self.subTest(seed=seed):
+                self.assertDecodesSame(self.make_track(seed, jitter=2, noise=30),
+                                       nco_init_period=40, pll_kp_exp=3)
+
+    def test_garbage(self):
+        self.assertDecodesSame(random.Random(0).randbytes(20000))
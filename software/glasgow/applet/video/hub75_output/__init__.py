@@ -1,11 +1,17 @@
 import argparse
+import asyncio
 import logging
 from amaranth import *
-from amaranth.lib import io
+from amaranth.lib import io, memory
 
+from ....support.endpoint import *
 from ... import *
 
 
+CMD_WRITE_ROW = 0x01
+CMD_SWAP      = 0x02
+
+
 class VideoHub75Output(Elaboratable):
     def __init__(self, ports):
         self.ports = ports
@@ -40,7 +46,7 @@ class VideoHub75Output(Elaboratable):
 
 
 class VideoHub75OutputSubtarget(Elaboratable):
-    def __init__(self, ports, px_width, px_height, expose_delay, pattern_rate):
+    def __init__(self, ports, px_width, px_height, expose_delay, pattern_rate, out_fifo):
         self.ports = ports
 
         self.px_width = px_width
@@ -48,8 +54,26 @@ class VideoHub75OutputSubtarget(Elaboratable):
         self.expose_delay = expose_delay
         self.pattern_rate = pattern_rate
 
+        self.out_fifo = out_fifo
+
+        self.col_bits = (self.px_width - 1).bit_length()
+        self.row_bits = (self.px_height // 2 - 1).bit_length()
+
     def pix_gen(self, x, y):
-        return Cat(x[self.pattern_rate:] + y[self.pattern_rate:])
+        return ((x >> self.pattern_rate) + (y >> self.pattern_rate)) & 0b111
+
+    def frame_init(self):
+        # Each word holds a pixel from the top half of the panel in the low bits, and a pixel
+        # from the bottom half in the high bits, since they are shifted out simultaneously. Both
+        # banks initially contain the test pattern.
+        px_height_half = self.px_height // 2
+        init = []
+        for bank in range(2):
+            for row in range(1 << self.row_bits):
+                for col in range(1 << self.col_bits):
+                    init.append(self.pix_gen(col, row) |
+                                self.pix_gen(col, row + px_height_half) << 3)
+        return init
 
     def elaborate(self, platform):
         px_height_half = self.px_height // 2
@@ -58,21 +82,37 @@ class VideoHub75OutputSubtarget(Elaboratable):
 
         m.submodules.output = output = VideoHub75Output(self.ports)
 
+        # The frame buffer is double-buffered: frames are written by the host into the back bank,
+        # and the banks are swapped only after the entire front bank has been scanned out.
+        m.submodules.frame = frame = memory.Memory(shape=6, depth=2 << (self.row_bits +
+            self.col_bits), init=self.frame_init())
+        w_port = frame.write_port(granularity=3)
+        r_port = frame.read_port()
+
+        front = Signal()
+        swap  = Signal()
+
         row      = Signal(output.addr.shape())
         row_disp = Signal(output.addr.shape())
         m.d.comb += output.addr.eq(row_disp)
 
         cnt = Signal(32)
-        col = Signal(cnt.shape())
-        m.d.comb += col.eq(cnt[1:])
 
         with m.FSM() as fsm:
+            with m.State("ROW-FETCH"):
+                m.d.comb += r_port.addr.eq(Cat(C(0, self.col_bits), row[:self.row_bits], front))
+                m.next = "ROW-SHIFT"
+
             with m.State("ROW-SHIFT"):
                 with m.If(cnt < self.px_width * 2):
+                    # Fetch the pixel one cycle in advance, so that the data is stable during both
+                    # halves of the clock period.
                     m.d.comb += [
+                        r_port.addr.eq(Cat((cnt + 1)[1:1 + self.col_bits],
+                                           row[:self.row_bits], front)),
                         output.clk.eq(cnt[0]),
-                        output.rgb1.eq(self.pix_gen(col, row)),
-                        output.rgb2.eq(self.pix_gen(col, row + px_height_half)),
+                        output.rgb1.eq(r_port.data[0:3]),
+                        output.rgb2.eq(r_port.data[3:6]),
                     ]
                     m.d.sync += cnt.eq(cnt + 1)
                 with m.Else():
@@ -94,16 +134,109 @@ class VideoHub75OutputSubtarget(Elaboratable):
                     row.eq(Mux(row < (px_height_half - 1), row + 1, 0)),
                     cnt.eq(0),
                 ]
-                m.next = "ROW-SHIFT"
+                with m.If((row == px_height_half - 1) & swap):
+                    m.d.sync += front.eq(~front)
+                    m.d.sync += swap.eq(0)
+                m.next = "ROW-FETCH"
+
+        w_row  = Signal(range(px_height_half))
+        w_lane = Signal()
+        w_col  = Signal(range(self.px_width))
+        with m.FSM():
+            with m.State("COMMAND"):
+                m.d.comb += self.out_fifo.r_en.eq(1)
+                with m.If(self.out_fifo.r_rdy):
+                    with m.Switch(self.out_fifo.r_data):
+                        with m.Case(CMD_WRITE_ROW):
+                            m.next = "ROW"
+                        with m.Case(CMD_SWAP):
+                            m.d.sync += swap.eq(1)
+                            m.next = "SWAP"
+
+            with m.State("ROW"):
+                m.d.comb += self.out_fifo.r_en.eq(1)
+                with m.If(self.out_fifo.r_rdy):
+                    with m.If(self.out_fifo.r_data < px_height_half):
+                        m.d.sync += w_row.eq(self.out_fifo.r_data)
+                        m.d.sync += w_lane.eq(0)
+                    with m.Else():
+                        m.d.sync += w_row.eq(self.out_fifo.r_data - px_height_half)
+                        m.d.sync += w_lane.eq(1)
+                    m.d.sync += w_col.eq(0)
+                    m.next = "PIXELS"
+
+            with m.State("PIXELS"):
+                m.d.comb += self.out_fifo.r_en.eq(1)
+                with m.If(self.out_fifo.r_rdy):
+                    m.d.comb += [
+                        w_port.addr.eq(Cat(w_col[:self.col_bits], w_row[:self.row_bits], ~front)),
+                        w_port.data.eq(Cat(self.out_fifo.r_data[:3], self.out_fifo.r_data[:3])),
+                        w_port.en.eq(Mux(w_lane, 0b10, 0b01)),
+                    ]
+                    m.d.sync += w_col.eq(w_col + 1)
+                    with m.If(w_col == self.px_width - 1):
+                        m.next = "COMMAND"
+
+            with m.State("SWAP"):
+                # Rows of the next frame may only be written once the banks have been swapped.
+                with m.If(~swap):
+                    m.next = "COMMAND"
 
         return m
 
 
+class VideoHub75OutputInterface:
+    """Frame streaming interface.
+
+    Frames are sequences of ``px_width * px_height`` octets, one per pixel, in row-major order;
+    the low three bits of each octet drive the RGB pins. Only the rows that differ from the
+    contents of the back bank are sent. The frame is shown at the end of the current refresh,
+    and the interface waits for that before accepting the rows of the next one; up to the size
+    of the write buffer of frames can be queued on the host.
+    """
+
+    def __init__(self, interface, logger, px_width, px_height):
+        self.lower      = interface
+        self._logger    = logger
+        self._level     = logging.DEBUG if self._logger.name == __name__ else logging.TRACE
+
+        self.px_width   = px_width
+        self.px_height  = px_height
+
+        # The host keeps a copy of each of the banks; the one at index 0 is the back bank.
+        # The initial contents (the test pattern) is not tracked.
+        self._banks     = [None, None]
+
+    def _log(self, message, *args):
+        self._logger.log(self._level, "HUB75: " + message, *args)
+
+    async def send_frame(self, frame):
+        frame = bytes(frame)
+        if len(frame) != self.px_width * self.px_height:
+            raise ValueError(f"frame must be {self.px_width * self.px_height} bytes long")
+
+        back, rows = self._banks[0], 0
+        for row in range(self.px_height):
+            start, end = row * self.px_width, (row + 1) * self.px_width
+            if back is None or back[start:end] != frame[start:end]:
+                await self.lower.write(bytes([CMD_WRITE_ROW, row]) + frame[start:end])
+                rows += 1
+        await self.lower.write(bytes([CMD_SWAP]))
+        await self.lower.flush(wait=False)
+        self._log("frame rows=%d", rows)
+
+        self._banks = [self._banks[1], frame]
+
+
 class VideoHub75OutputApplet(GlasgowApplet):
     logger = logging.getLogger(__name__)
-    help = "display a test pattern on HUB75 panel"
+    help = "display video on HUB75 panel"
     description = """
-    Output a test pattern on a HUB75 compatible LED matrix.
+    Output video on a HUB75 compatible LED matrix. Until the first frame is received,
+    a test pattern is displayed.
+
+    Frames are received over a socket, and consist of one octet per pixel in row-major order,
+    where bits 0, 1, and 2 drive the R, G, and B pins respectively.
 
     This applet expects two RGB interfaces (each driving half of a display), that share common
     Clock, Latch and #OE signals.
@@ -157,12 +290,38 @@ class VideoHub75OutputApplet(GlasgowApplet):
             px_height=args.px_height,
             expose_delay=args.expose_delay,
             pattern_rate=args.pattern_rate,
+            out_fifo=iface.get_out_fifo(),
         ))
 
         return subtarget
 
+    @classmethod
+    def add_run_arguments(cls, parser, access):
+        super().add_run_arguments(parser, access)
+
+        parser.add_argument(
+            "-b", "--buffer", metavar="N", type=int, default=4,
+            help="set the number of frames to buffer on the host (default: %(default)s)")
+
     async def run(self, device, args):
-        return await device.demultiplexer.claim_interface(self, self.mux_interface, args)
+        buffer_size = (2 + args.px_width) * args.px_height * args.buffer
+        iface = await device.demultiplexer.claim_interface(self, self.mux_interface, args,
+            write_buffer_size=buffer_size)
+        return VideoHub75OutputInterface(iface, self.logger, args.px_width, args.px_height)
+
+    @classmethod
+    def add_interact_arguments(cls, parser):
+        ServerEndpoint.add_argument(parser, "endpoint")
+
+    async def interact(self, device, args, hub75):
+        frame_size = args.px_width * args.px_height
+        endpoint = await ServerEndpoint("socket", self.logger, args.endpoint,
+            queue_size=frame_size * args.buffer)
+        while True:
+            try:
+                await hub75.send_frame(await endpoint.recv(frame_size))
+            except EOFError:
+                pass
 
     @classmethod
     def tests(cls):
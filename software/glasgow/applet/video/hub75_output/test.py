@@ -1,8 +1,131 @@
+import asyncio
+import logging
+import unittest
+from amaranth import *
+from amaranth.lib import io
+from amaranth.lib.fifo import SyncFIFOBuffered
+from amaranth.sim import Simulator
+
+from ....gateware.ports import PortGroup
 from ... import *
-from . import VideoHub75OutputApplet
+from . import VideoHub75OutputSubtarget, VideoHub75OutputInterface, VideoHub75OutputApplet
+from . import CMD_WRITE_ROW, CMD_SWAP
 
 
 class VideoHub75OutputAppletTestCase(GlasgowAppletTestCase, applet=VideoHub75OutputApplet):
     @synthesis_test
     def test_build(self):
         self.assertBuilds()
+
+
+class VideoHub75OutputSubtargetTestCase(unittest.TestCase):
+    def scan_out(self, commands, rows):
+        ports = PortGroup()
+        ports.rgb1 = io.SimulationPort("o", 3, name="rgb1")
+        ports.rgb2 = io.SimulationPort("o", 3, name="rgb2")
+        ports.addr = io.SimulationPort("o", 1, name="addr")
+        ports.clk  = io.SimulationPort("o", 1, name="clk")
+        ports.lat  = io.SimulationPort("o", 1, name="lat")
+        ports.oe   = io.SimulationPort("o", 1, name="oe")
+
+        fifo = SyncFIFOBuffered(width=8, depth=len(commands))
+        dut  = VideoHub75OutputSubtarget(ports, px_width=2, px_height=4, expose_delay=16,
+                                         pattern_rate=0, out_fifo=fifo)
+        m = Module()
+        m.submodules.fifo = fifo
+        m.submodules.dut  = dut
+
+        async def testbench_i(ctx):
+            for octet in commands:
+                ctx.set(fifo.w_data, octet)
+                ctx.set(fifo.w_en, 1)
+                await ctx.tick().until(fifo.w_rdy)
+            ctx.set(fifo.w_en, 0)
+
+        # Each latched row pair is recorded as a list of (top, bottom) pixels.
+        output = []
+        async def testbench_o(ctx):
+            pixels = []
+            while len(output) < rows:
+                _, _, clk, lat, rgb1, rgb2 = \
+                    await ctx.tick().sample(ports.clk.o, ports.lat.o, ports.rgb1.o, ports.rgb2.o)
+                if clk:
+                    pixels.append((rgb1, rgb2))
+                if lat:
+                    output.append(pixels)
+                    pixels = []
+
+        sim = Simulator(m)
+        sim.add_clock(1e-6)
+        sim.add_testbench(testbench_i)
+        sim.add_testbench(testbench_o)
+        sim.run()
+        return output
+
+    def test_swap(self):
+        # The first frame is written during the first row pair of the test pattern and changes
+        # the top half of row pair 0 and the bottom half of row pair 1; the second frame changes
+        # the top half of row pair 1, and is queued right behind the first one.
+        output = self.scan_out([
+            CMD_WRITE_ROW, 0, 5, 6,
+            CMD_WRITE_ROW, 3, 7, 5,
+            CMD_SWAP,
+            CMD_WRITE_ROW, 1, 6, 7,
+            CMD_SWAP,
+        ], rows=8)
+        self.assertEqual(output, [
+            # The test pattern is scanned out until the last row pair is latched, even though
+            # the swap is requested before that.
+            [(0, 2), (1, 3)],
+            [(1, 3), (2, 4)],
+            # Only the half of the panel selected by the row number is written, and the rows of
+            # the second frame are not accepted until the first frame is in the front bank.
+            [(5, 2), (6, 3)],
+            [(1, 7), (2, 5)],
+            # Each swap toggles the banks exactly once.
+            [(0, 2), (1, 3)],
+            [(6, 3), (7, 4)],
+            [(0, 2), (1, 3)],
+            [(6, 3), (7, 4)],
+        ])
+
+
+class _MockInterface:
+    def __init__(self):
+        self.data = bytearray()
+
+    async def write(self, data):
+        self.data += data
+
+    async def flush(self, wait=True):
+        pass
+
+
+class VideoHub75OutputInterfaceTestCase(unittest.TestCase):
+    def setUp(self):
+        self.lower = _MockInterface()
+        self.iface = VideoHub75OutputInterface(self.lower, logging.getLogger(__name__),
+                                               px_width=2, px_height=3)
+
+    def send_frame(self, frame):
+        self.lower.data.clear()
+        asyncio.run(self.iface.send_frame(frame))
+        return bytes(self.lower.data)
+
+    def test_dirty_rows(self):
+        # Both banks have unknown contents at first.
+        self.assertEqual(self.send_frame(b"\x01\x02\x03\x04\x05\x06"), bytes([
+            CMD_WRITE_ROW, 0, 1, 2, CMD_WRITE_ROW, 1, 3, 4, CMD_WRITE_ROW, 2, 5, 6, CMD_SWAP]))
+        self.assertEqual(self.send_frame(b"\x01\x02\x03\x04\x05\x06"), bytes([
+            CMD_WRITE_ROW, 0, 1, 2, CMD_WRITE_ROW, 1, 3, 4, CMD_WRITE_ROW, 2, 5, 6, CMD_SWAP]))
+        # Rows are compared with the frame before last, which is in the back bank.
+        self.assertEqual(self.send_frame(b"\x01\x02\x00\x00\x05\x06"), bytes([
+            CMD_WRITE_ROW, 1, 0, 0, CMD_SWAP]))
+        self.assertEqual(self.send_frame(b"\x01\x02\x00\x00\x05\x06"), bytes([
+            CMD_WRITE_ROW, 1, 0, 0, CMD_SWAP]))
+        self.assertEqual(self.send_frame(b"\x01\x02\x00\x00\x05\x06"), bytes([
+            CMD_SWAP]))
+
+    def test_wrong_size(self):
+        with self.assertRaisesRegex(ValueError, r"^frame must be 6 bytes long$"):
+            self.send_frame(b"\x00")
@@ -1,5 +1,9 @@
-import logging
+import re
 import math
+import time
+import asyncio
+import logging
+import argparse
 from amaranth import *
 from amaranth.lib import io
 from amaranth.lib.cdc import FFSynchronizer
@@ -137,12 +141,98 @@ class VideoRGBInputSubtarget(Elaboratable):
         return m
 
 
+class VideoRGBInputDecoder:
+    """Reassembles the stream produced by :class:`VideoRGBInputSubtarget` into RGB888 frames.
+
+    The stream consists of row records: a header octet (the only kind of octet with the high bit
+    set) containing the overflow flag, the frame number, and the high bit of the row number; an
+    octet with the low bits of the row number; and three 5-bit components per pixel. Records
+    that are cut short by a FIFO overflow are discarded. Rows missing from a frame keep their
+    contents from the previous frame, and are counted in :attr:`dropped_rows`. The first frame
+    is discarded, since the capture most likely started in the middle of it.
+    """
+
+    _header = re.compile(rb"[\x80-\xff]")
+    _rgb555_to_rgb888 = bytes((v << 3) | (v >> 2) for v in range(32)) + bytes(224)
+
+    def __init__(self, rows, columns):
+        self.rows     = rows
+        self.columns  = columns
+
+        self._record_size = 2 + 3 * columns
+        self._buffer      = bytearray()
+        self._frame_data  = bytearray(rows * columns * 3)
+        self._frame       = None
+        self._partial     = True
+        self._rows_seen   = bytearray(rows)
+
+        self.frames       = 0
+        self.dropped_rows = 0
+        self.overflows    = 0
+        self.desyncs      = 0
+
+    def _finish_frame(self, frames):
+        if self._partial:
+            self._partial = False
+        else:
+            self.frames       += 1
+            self.dropped_rows += self._rows_seen.count(0)
+            frames.append(bytes(self._frame_data))
+        self._rows_seen = bytearray(self.rows)
+
+    def feed(self, data):
+        """Process ``data``, and return a list of frames completed by it."""
+        frames = []
+        buffer = self._buffer
+        buffer += data
+        offset = 0
+        while True:
+            match = self._header.search(buffer, offset)
+            if match is None:
+                offset = len(buffer)
+                break
+            if match.start() != offset:
+                self.desyncs += 1
+                offset = match.start()
+            if offset + self._record_size > len(buffer):
+                break
+            # A header within the record means that the record was cut short.
+            match = self._header.search(buffer, offset + 1, offset + self._record_size)
+            if match is not None:
+                self.desyncs += 1
+                offset = match.start()
+                continue
+
+            header, row_low = buffer[offset], buffer[offset + 1]
+            frame = (header >> 1) & 0x1f
+            row   = ((header & 0x01) << 7) | row_low
+            if frame != self._frame:
+                if self._frame is not None:
+                    self._finish_frame(frames)
+                if header & 0x40:
+                    self.overflows += 1
+                self._frame = frame
+            if row < self.rows:
+                row_size = self.columns * 3
+                self._frame_data[row * row_size:(row + 1) * row_size] = \
+                    buffer[offset + 2:offset + self._record_size].translate(self._rgb555_to_rgb888)
+                self._rows_seen[row] = 1
+            offset += self._record_size
+        del buffer[:offset]
+        return frames
+
+
 class VideoRGBInputApplet(GlasgowApplet):
     preview = True
     logger = logging.getLogger(__name__)
     help = "capture video stream from RGB555 LCD bus"
     description = """
     Streams screen contents from a color parallel RGB555 LCD, such as Sharp LQ035Q7DH06.
+
+    Frames are converted to RGB888 and can be written as raw video (e.g. with `--output -`),
+    as a sequence of PPM images, or to the standard input of an encoder, such as:
+
+        --pipe "ffmpeg -f rawvideo -pix_fmt rgb24 -s {width}x{height} -i - capture.mp4"
     """
 
     @classmethod
@@ -175,17 +265,70 @@ class VideoRGBInputApplet(GlasgowApplet):
             sys_clk_freq=target.sys_clk_freq,
         ))
 
+    @classmethod
+    def add_run_arguments(cls, parser, access):
+        super().add_run_arguments(parser, access)
+
+        parser.add_argument(
+            "-n", "--frames", metavar="COUNT", type=int,
+            help="stop after capturing COUNT frames (default: capture until interrupted)")
+        parser.add_argument(
+            "-o", "--output", metavar="FILENAME", type=argparse.FileType("wb"),
+            help="write frames to FILENAME as raw RGB888 video")
+        parser.add_argument(
+            "--images", metavar="PATTERN", type=str,
+            help="write each frame to a PPM image named PATTERN %% frame index "
+                 "(e.g. 'frame%%05d.ppm')")
+        parser.add_argument(
+            "--pipe", metavar="COMMAND", type=str,
+            help="write frames as raw RGB888 video to the standard input of shell COMMAND, "
+                 "with {width} and {height} substituted")
+
     async def run(self, device, args):
         iface = await device.demultiplexer.claim_interface(self, self.mux_interface, args)
+        decoder = VideoRGBInputDecoder(args.rows, args.columns)
+
+        encoder = None
+        if args.pipe is not None:
+            encoder = await asyncio.create_subprocess_shell(
+                args.pipe.format(width=args.columns, height=args.rows),
+                stdin=asyncio.subprocess.PIPE)
+
+        async def output(frames, first_index):
+            for index, frame_data in enumerate(frames, first_index):
+                if args.output is not None:
+                    args.output.write(frame_data)
+                if args.images is not None:
+                    with open(args.images % index, "wb") as f:
+                        f.write(b"P6 %d %d 255\n" % (args.columns, args.rows))
+                        f.write(frame_data)
+                if encoder is not None:
+                    encoder.stdin.write(frame_data)
+                    await encoder.stdin.drain()
 
-        for _ in range(10):
-            sync = 0
-            while not (sync & 0x80):
-                sync = (await iface.read(1))[0]
-            frame = (sync & 0x3e) >> 1
-            row   = ((sync & 0x01) << 7) | (await iface.read(1))[0]
+        def report():
+            self.logger.info("frames: %d; dropped rows: %d; overflows: %d; desyncs: %d",
+                             decoder.frames, decoder.dropped_rows, decoder.overflows,
+                             decoder.desyncs)
 
-            print(f"frame {frame} row {row}")
+        try:
+            reported_at = time.monotonic()
+            while args.frames is None or decoder.frames < args.frames:
+                frames = decoder.feed(await iface.read())
+                first_index = decoder.frames - len(frames)
+                if args.frames is not None:
+                    del frames[args.frames - first_index:]
+                await output(frames, first_index)
+                if time.monotonic() - reported_at >= 1.0:
+                    reported_at = time.monotonic()
+                    report()
+        finally:
+            report()
+            if args.output is not None:
+                args.output.flush()
+            if encoder is not None:
+                encoder.stdin.close()
+                await encoder.wait()
 
     @classmethod
     def tests(cls):
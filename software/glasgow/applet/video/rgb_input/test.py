@@ -1,5 +1,7 @@
+import unittest
+
 from ... import *
-from . import VideoRGBInputApplet
+from . import VideoRGBInputApplet, VideoRGBInputDecoder
 
 
 class VideoRGBInputAppletTestCase(GlasgowAppletTestCase, applet=VideoRGBInputApplet):
@@ -8,3 +10,46 @@ class VideoRGBInputAppletTestCase(GlasgowAppletTestCase, applet=VideoRGBInputApp
         self.assertBuilds(args=["--r", "A0:4", "--g", "A5:7,B0:1", "--b", "B2:6",
                                 "--dck", "B7", "--columns", "160", "--rows", "144",
                                 "--vblank", "960e-6"])
+
+
+class VideoRGBInputDecoderTestCase(unittest.TestCase):
+    @staticmethod
+    def record(frame, row, pixels, *, overflow=False):
+        data = bytearray([0x80 | (overflow << 6) | (frame << 1) | (row >> 7), row & 0x7f])
+        for r, g, b in pixels:
+            data += bytes([r, g, b])
+        return data
+
+    def setUp(self):
+        self.decoder = VideoRGBInputDecoder(rows=2, columns=2)
+
+    def test_frames(self):
+        stream  = self.record(0, 1, [(1, 1, 1), (1, 1, 1)]) # partial frame, discarded
+        stream += self.record(1, 0, [(0, 31, 1), (2, 3, 4)])
+        stream += self.record(1, 1, [(31, 0, 16), (0, 0, 0)])
+        stream += self.record(2, 0, [(0, 0, 0), (0, 0, 0)])
+        frames = []
+        for index in range(0, len(stream), 5):
+            frames += self.decoder.feed(stream[index:index + 5])
+        self.assertEqual(frames, [
+            bytes([0, 255, 8, 16, 24, 33, 255, 0, 132, 0, 0, 0])
+        ])
+        self.assertEqual(self.decoder.frames, 1)
+        self.assertEqual(self.decoder.dropped_rows, 0)
+        self.assertEqual(self.decoder.desyncs, 0)
+
+    def test_dropped_rows(self):
+        stream  = self.record(0, 0, [(0, 0, 0), (0, 0, 0)])
+        stream += self.record(1, 0, [(1, 1, 1), (1, 1, 1)])
+        stream += self.record(1, 1, [(2, 2, 2), (2, 2, 2)])[:-3] # cut short by an overflow
+        stream += self.record(2, 0, [(3, 3, 3), (3, 3, 3)], overflow=True)
+        stream += self.record(3, 0, [(0, 0, 0), (0, 0, 0)])
+        frames = self.decoder.feed(stream)
+        self.assertEqual(frames, [
+            bytes([8] * 6 + [0] * 6),
+            bytes([24] * 6 + [0] * 6),
+        ])
+        self.assertEqual(self.decoder.frames, 2)
+        self.assertEqual(self.decoder.dropped_rows, 2)
+        self.assertEqual(self.decoder.overflows, 1)
+        self.assertEqual(self.decoder.desyncs, 1)
@@ -2,13 +2,17 @@
 # Document Number: IHI0031C
 # Accession: G00027
 
-from enum import Enum
+from enum import Enum, IntEnum
 
 from ....support.bitstruct import *
 
 
 __all__ = [
     "AP_IDR_addr", "AP_IDR", "AP_IDR_CLASS",
+    "MEM_AP_CSW_addr", "MEM_AP_CSW", "MEM_AP_CSW_SIZE", "MEM_AP_CSW_ADDRINC",
+    "MEM_AP_TAR_addr",
+    "MEM_AP_DRW_addr",
+    "MEM_AP_TAR_INC_BOUNDARY",
 ]
 
 
@@ -41,3 +45,46 @@ class AP_IDR_CLASS(Enum):
                 return "MEM-AP"
             case _:
                 return f"{self.value:#06b}"
+
+
+# CSW MEM-AP register layout
+
+MEM_AP_CSW_addr = 0x00 # R/W
+
+MEM_AP_CSW = bitstruct("MEM_AP_CSW", 32, [
+    ("Size",            3),
+    (None,              1),
+    ("AddrInc",         2),
+    ("DeviceEn",        1),
+    ("TrInProg",        1),
+    ("Mode",            4),
+    ("Type",            4),
+    (None,              7),
+    ("SPIDEN",          1),
+    ("Prot",            7),
+    ("DbgSwEnable",     1),
+])
+
+class MEM_AP_CSW_SIZE(IntEnum):
+    BYTE            = 0b000
+    HALFWORD        = 0b001
+    WORD            = 0b010
+
+class MEM_AP_CSW_ADDRINC(IntEnum):
+    OFF             = 0b00
+    SINGLE          = 0b01
+    PACKED          = 0b10
+
+
+# TAR MEM-AP register layout
+
+MEM_AP_TAR_addr = 0x04 # R/W
+
+# Auto-increment of TAR is only guaranteed to work within a 1 KiB aligned region; the address
+# must be rewritten when crossing this boundary.
+MEM_AP_TAR_INC_BOUNDARY = 0x400
+
+
+# DRW MEM-AP register layout
+
+MEM_AP_DRW_addr = 0x0C # R/W
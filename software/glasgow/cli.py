@@ -6,13 +6,19 @@ import logging
 import contextlib
 import asyncio
 import signal
+import time
+import shlex
+import threading
 import argparse
+import pathlib
 import textwrap
 import platform
 import unittest
 import importlib.metadata
+import concurrent.futures
 from datetime import datetime
 
+import usb1
 from vcd import VCDWriter
 from amaranth import UnusedElaboratable
 from fx2 import FX2Config, FX2Device, FX2DeviceError, VID_CYPRESS, PID_FX2
@@ -117,6 +123,9 @@ def create_argparser():
     parser.add_argument(
         "--statistics", dest="show_statistics", default=False, action="store_true",
         help="display performance counters before exiting")
+    parser.add_argument(
+        "--profile-startup", default=False, action="store_true",
+        help="display time spent importing modules and building the argument parser")
 
     return parser
 
@@ -124,14 +133,24 @@ def create_argparser():
 def get_argparser():
     class LazyParser(argparse.ArgumentParser):
         """This is a lazy ArgumentParser that runs any added build_func(s) just before arguments
-        are parsed"""
+        are parsed, and any added help_func(s) just before help is formatted"""
         def __init__(self, *args, **kwargs):
             self.build_funcs = []
+            self.help_funcs = []
             super().__init__(*args, **kwargs)
 
         def add_build_func(self, build_func):
             self.build_funcs.append(build_func)
 
+        def add_help_func(self, help_func):
+            self.help_funcs.append(help_func)
+
+        def format_help(self):
+            for help_func in self.help_funcs:
+                help_func()
+            self.help_funcs.clear()
+            return super().format_help()
+
         def build(self):
             for build_func in self.build_funcs:
                 build_func()
@@ -177,40 +196,69 @@ def get_argparser():
         p_stub.add_argument("args", nargs="...", help=argparse.SUPPRESS)
         p_stub.add_argument("help", nargs="?", default=p_stub.format_help())
 
+    def applet_help(applet_cls):
+        help        = applet_cls.help
+        description = applet_cls.description
+        if applet_cls.preview:
+            help += " (PREVIEW QUALITY APPLET)"
+            description = "    This applet is PREVIEW QUALITY and may CORRUPT DATA or " \
+                          "have missing features. Use at your own risk.\n" + description
+        if applet_cls.required_revision > "A0":
+            help += f" (rev{applet_cls.required_revision}+)"
+            description += "\n    This applet requires Glasgow rev{} or later." \
+                           .format(applet_cls.required_revision)
+        return help, description
+
+    def load_applet(metadata):
+        try:
+            return metadata.load()
+        except (PluginRequirementsUnmet, PluginLoadError) as e:
+            logger.error(e)
+            print(metadata.description)
+            raise SystemExit(3)
+
     def add_applet_arg(parser, mode, *, required=False):
         subparsers = add_subparsers(
             parser, dest="applet", metavar="APPLET", required=required, parser_class=LazyParser)
 
         for handle, metadata in GlasgowAppletMetadata.all().items():
-            if not metadata.loadable:
+            if not metadata.available:
                 add_stub_parser(subparsers, handle, metadata)
                 continue
-            applet_cls = metadata.load()
-
-            # Don't do `.tests() is None`, as this has the overhead of importing the tests module
-            # (about 5ms per applet, which adds up). Instead, check if the function was overridden,
-            # as it's pointless to override it just to return `None`.
-            if mode == "test" and applet_cls.tests is GlasgowApplet.tests:
-                continue
-
-            help        = applet_cls.help
-            description = applet_cls.description
-            if applet_cls.preview:
-                help += " (PREVIEW QUALITY APPLET)"
-                description = "    This applet is PREVIEW QUALITY and may CORRUPT DATA or " \
-                              "have missing features. Use at your own risk.\n" + description
-            if applet_cls.required_revision > "A0":
-                help += f" (rev{applet_cls.required_revision}+)"
-                description += "\n    This applet requires Glasgow rev{} or later." \
-                               .format(applet_cls.required_revision)
 
+            if mode == "test":
+                if not metadata.loadable:
+                    add_stub_parser(subparsers, handle, metadata)
+                    continue
+                # Don't do `.tests() is None`, as this has the overhead of importing the tests
+                # module (about 5ms per applet, which adds up). Instead, check if the function was
+                # overridden, as it's pointless to override it just to return `None`.
+                if metadata.load().tests is GlasgowApplet.tests:
+                    continue
+
+            # Only the applet that is selected on the command line is imported. The help text of
+            # the rest is only needed when the list of applets is displayed.
             p_applet = subparsers.add_parser(
-                handle, help=help, description=description,
-                formatter_class=TextHelpFormatter)
+                handle, help="", formatter_class=TextHelpFormatter)
 
-            def p_applet_build_factory(p_applet, handle, applet_cls, mode):
+            def p_applet_help_factory(choice_action, metadata):
+                # factory function for proper closure
+                def p_applet_help():
+                    if metadata.loadable:
+                        choice_action.help, _description = applet_help(metadata.load())
+                    else:
+                        choice_action.help = metadata.synopsis
+                return p_applet_help
+            container = getattr(parser, "_container", parser)
+            container.add_help_func(
+                p_applet_help_factory(subparsers._choices_actions[-1], metadata))
+
+            def p_applet_build_factory(p_applet, handle, metadata, mode):
                 # factory function for proper closure
                 def p_applet_build():
+                    applet_cls = load_applet(metadata)
+                    _help, p_applet.description = applet_help(applet_cls)
+
                     if mode == "test":
                         p_applet.add_argument(
                             "tests", metavar="TEST", nargs="*",
@@ -246,27 +294,33 @@ def get_argparser():
                         # is passed to the repo / script environment
                         p_applet.add_argument('script_args', nargs=argparse.REMAINDER)
                 return p_applet_build
-            p_applet.add_build_func(p_applet_build_factory(p_applet, handle, applet_cls, mode))
+            p_applet.add_build_func(p_applet_build_factory(p_applet, handle, metadata, mode))
 
     def add_applet_tool_arg(parser, *, required=False):
         subparsers = add_subparsers(
             parser, dest="tool", metavar="TOOL", required=required, parser_class=LazyParser)
 
-        def p_tool_build_factory(p_tool, tool_cls):
+        def p_tool_build_factory(p_tool, metadata):
             def p_tool_build():
+                tool_cls = load_applet(metadata)
+                p_tool.description = tool_cls.description
                 tool_cls.add_arguments(p_tool)
             return p_tool_build
 
+        def p_tool_help_factory(choice_action, metadata):
+            def p_tool_help():
+                choice_action.help = metadata.synopsis
+            return p_tool_help
+
         for handle, metadata in GlasgowAppletToolMetadata.all().items():
-            if not metadata.loadable:
+            if not metadata.available:
                 add_stub_parser(subparsers, handle, metadata)
                 continue
 
-            tool_cls = metadata.load()
             p_tool = subparsers.add_parser(
-                handle, help=tool_cls.help, description=tool_cls.description,
-                formatter_class=TextHelpFormatter)
-            p_tool.add_build_func(p_tool_build_factory(p_tool, tool_cls))
+                handle, help="", formatter_class=TextHelpFormatter)
+            parser.add_help_func(p_tool_help_factory(subparsers._choices_actions[-1], metadata))
+            p_tool.add_build_func(p_tool_build_factory(p_tool, metadata))
 
     parser = create_argparser()
 
@@ -287,6 +341,13 @@ def get_argparser():
     parser.add_argument(
         "--serial", metavar="SERIAL", type=serial,
         help="use device with serial number SERIAL")
+    parser.add_argument(
+        "--daemon", dest="use_daemon", default=False, action="store_true",
+        help="access the device through `glasgow daemon`, keeping firmware and bitstream loaded")
+    parser.add_argument(
+        "--daemon-socket", metavar="PATH", type=pathlib.Path, default=None,
+        help="use device daemon socket PATH (default: `daemon.sock` in the user runtime "
+             "directory)")
 
     subparsers = parser.add_subparsers(dest="action", metavar="COMMAND", parser_class=LazyParser)
     subparsers.required = True
@@ -378,6 +439,9 @@ def get_argparser():
     p_flash = subparsers.add_parser(
         "flash", formatter_class=TextHelpFormatter,
         help="program FX2 firmware or applet bitstream into EEPROM")
+    p_flash.add_argument(
+        "--all", dest="flash_all", default=False, action="store_true",
+        help="program all connected devices concurrently")
 
     g_flash_firmware = p_flash.add_mutually_exclusive_group()
     g_flash_firmware.add_argument(
@@ -409,8 +473,30 @@ def get_argparser():
     p_build.add_argument(
         "-f", "--filename", metavar="FILENAME", type=str,
         help="file to save artifact to (default: <applet-name>.{zip,il,bin})")
+    p_build.add_argument(
+        "--seeds", metavar="COUNT", type=int, default=1,
+        help="place and route with COUNT seeds in parallel, and keep the bitstream with "
+             "the highest Fmax (default: %(default)s)")
     p_build.add_build_func(lambda: add_applet_arg(p_build, mode="build", required=True))
 
+    p_prebuild = subparsers.add_parser(
+        "prebuild", formatter_class=TextHelpFormatter,
+        help="(advanced) build bitstreams for many applets in parallel to populate the cache")
+    p_prebuild.add_argument(
+        "--rev", metavar="REVISION", dest="revs", type=revision, action="append", required=True,
+        help="board revision (may be specified several times)")
+    p_prebuild.add_argument(
+        "-j", "--jobs", metavar="JOBS", type=int, default=os.cpu_count() or 1,
+        help="run up to JOBS toolchain processes at once (default: %(default)s)")
+    p_prebuild.add_argument(
+        "--seeds", metavar="COUNT", type=int, default=1,
+        help="place and route each bitstream with COUNT seeds, and keep the one with "
+             "the highest Fmax (default: %(default)s)")
+    p_prebuild.add_argument(
+        "applet_list", metavar="APPLET-LIST", type=argparse.FileType("r"), nargs="?",
+        help="read applets to build from APPLET-LIST, one per line, each followed by its build "
+             "arguments as for `glasgow build` (default: every applet with default arguments)")
+
     p_test = subparsers.add_parser(
         "test", formatter_class=TextHelpFormatter,
         help="(advanced) test applet logic without target hardware")
@@ -455,6 +541,31 @@ def get_argparser():
         "list", formatter_class=TextHelpFormatter,
         help="list devices connected to the system")
 
+    p_host_benchmark = subparsers.add_parser(
+        "host-benchmark", formatter_class=TextHelpFormatter,
+        help="(advanced) measure host software performance using a virtual device")
+    p_host_benchmark.add_argument(
+        "-c", "--count", metavar="COUNT", type=int, default=1 << 26,
+        help="transfer COUNT bytes in each configuration (default: %(default)s)")
+    p_host_benchmark.add_argument(
+        "--latency", metavar="US", type=float, default=0.0,
+        help="complete each virtual transfer after US microseconds (default: %(default)s)")
+    p_host_benchmark.add_argument(
+        "--bandwidth", metavar="MIBPS", type=float, default=None,
+        help="limit virtual bus bandwidth to MIBPS MiB/s (default: unlimited)")
+    p_host_benchmark.add_argument(
+        "--tuning", metavar="PROFILE", dest="tunings", type=str, action="append",
+        choices=("throughput", "latency", "adaptive"),
+        help="benchmark pipes with tuning PROFILE (default: all)")
+    p_host_benchmark.add_argument(
+        dest="modes", metavar="MODE", type=str, nargs="*",
+        choices=[[], "source", "sink", "loopback"],
+        help="run benchmark mode MODE (default: source sink loopback)")
+
+    p_daemon = subparsers.add_parser(
+        "daemon", formatter_class=TextHelpFormatter,
+        help="(advanced) keep devices open and share them with `glasgow --daemon`")
+
     return parser
 
 
@@ -582,7 +693,87 @@ async def wait_for_sigint():
     raise SIGINTCaught
 
 
-async def main():
+async def _flash_device(device, logger, args, firmware_data, new_bitstream_id, new_bitstream):
+    logger.info("reading device configuration")
+    header = await device.read_eeprom("fx2", 0, 8 + 4 + GlasgowDeviceConfig.size)
+    header[0] = 0xC2 # see below
+
+    fx2_config = FX2Config.decode(header, partial=True)
+    if (len(fx2_config.firmware) != 1 or
+            fx2_config.firmware[0][0] != 0x4000 - GlasgowDeviceConfig.size or
+            len(fx2_config.firmware[0][1]) != GlasgowDeviceConfig.size):
+        logger.error("unrecognized or corrupted configuration block")
+        return 1
+    glasgow_config = GlasgowDeviceConfig.decode(fx2_config.firmware[0][1])
+
+    logger.info("device has serial %s-%s",
+                glasgow_config.revision, glasgow_config.serial)
+    if fx2_config.disconnect:
+        logger.info("device has flashed firmware")
+    else:
+        logger.info("device does not have flashed firmware")
+    if glasgow_config.bitstream_size:
+        logger.info("device has flashed bitstream ID %s",
+                    glasgow_config.bitstream_id.hex())
+    else:
+        logger.info("device does not have flashed bitstream")
+
+    if args.remove_bitstream:
+        logger.info("removing bitstream")
+        glasgow_config.bitstream_size = 0
+        glasgow_config.bitstream_id   = b"\x00"*16
+    elif new_bitstream is not None:
+        glasgow_config.bitstream_size = len(new_bitstream)
+        glasgow_config.bitstream_id   = new_bitstream_id
+
+    fx2_config.firmware[0] = (0x4000 - GlasgowDeviceConfig.size, glasgow_config.encode())
+
+    if args.remove_firmware:
+        logger.info("removing firmware")
+        fx2_config.disconnect = False
+        new_image = fx2_config.encode()
+        # Let FX2 hardware enumerate. This won't load the configuration block
+        # into memory automatically, but the firmware has code that does that
+        # if it detects a C0 load.
+        new_image[0] = 0xC0
+    else:
+        for (addr, chunk) in firmware_data:
+            fx2_config.append(addr, chunk)
+        fx2_config.disconnect = True
+        new_image = fx2_config.encode()
+
+    if new_bitstream:
+        logger.info("programming bitstream")
+        old_bitstream = await device.read_eeprom("ice", 0, len(new_bitstream))
+        if old_bitstream != new_bitstream:
+            for (addr, chunk) in diff_data(old_bitstream, new_bitstream):
+                await device.write_eeprom("ice", addr, chunk)
+
+            logger.info("verifying bitstream")
+            if await device.read_eeprom("ice", 0, len(new_bitstream)) != new_bitstream:
+                logger.critical("bitstream programming failed")
+                return 1
+        else:
+            logger.info("bitstream identical")
+
+    logger.info("programming configuration and firmware")
+    old_image = await device.read_eeprom("fx2", 0, len(new_image))
+    if old_image != new_image:
+        for (addr, chunk) in diff_data(old_image, new_image):
+            await device.write_eeprom("fx2", addr, chunk)
+
+        logger.info("verifying configuration and firmware")
+        if await device.read_eeprom("fx2", 0, len(new_image)) != new_image:
+            logger.critical("configuration/firmware programming failed")
+            return 1
+
+        logger.warning("power cycle the device to apply changes")
+    else:
+        logger.info("configuration and firmware identical")
+    return 0
+
+
+async def main(import_profiler=None):
     # Handle log messages emitted during construction of the argument parser (e.g. by the plugin
     # subsystem).
     term_handler = create_logger()
@@ -590,10 +781,28 @@ async def main():
     args = get_argparser().parse_args()
     configure_logger(args, term_handler)
 
+    if args.profile_startup and import_profiler is not None:
+        import_profiler.uninstall()
+        logger.info("startup took %.1f ms, of which %.1f ms were spent importing modules",
+                    (time.perf_counter() - import_profiler.started) * 1000,
+                    import_profiler.total_time * 1000)
+        for title, cumulative in (("self", False), ("cumulative", True)):
+            logger.info("slowest imports by %s time:", title)
+            for name, elapsed in import_profiler.top(15, cumulative=cumulative):
+                logger.info("  %8.1f ms  %s", elapsed * 1000, name)
+    elif args.profile_startup:
+        logger.warning("startup can only be profiled when running `glasgow` or `python -m glasgow`")
+
     device = None
     try:
-        if args.action not in ("build", "test", "tool", "factory", "list"):
-            device = GlasgowDevice(args.serial)
+        if args.action not in ("build", "prebuild", "test", "tool", "factory", "list",
+                               "host-benchmark", "daemon") and \
+                not (args.action == "flash" and args.flash_all):
+            if args.use_daemon:
+                from .hardware.daemon import DaemonDevice
+                device = await DaemonDevice.connect(args.serial, socket_path=args.daemon_socket)
+            else:
+                device = GlasgowDevice(args.serial)
             assembly = HardwareAssembly(device=device)
 
         if args.action == "voltage":
@@ -812,41 +1021,12 @@ async def main():
                 return 1
 
         if args.action == "flash":
-            logger.info("reading device configuration")
-            header = await device.read_eeprom("fx2", 0, 8 + 4 + GlasgowDeviceConfig.size)
-            header[0] = 0xC2 # see below
-
-            fx2_config = FX2Config.decode(header, partial=True)
-            if (len(fx2_config.firmware) != 1 or
-                    fx2_config.firmware[0][0] != 0x4000 - GlasgowDeviceConfig.size or
-                    len(fx2_config.firmware[0][1]) != GlasgowDeviceConfig.size):
-                raise SystemExit("Unrecognized or corrupted configuration block")
-            glasgow_config = GlasgowDeviceConfig.decode(fx2_config.firmware[0][1])
-
-            logger.info("device has serial %s-%s",
-                        glasgow_config.revision, glasgow_config.serial)
-            if fx2_config.disconnect:
-                logger.info("device has flashed firmware")
-            else:
-                logger.info("device does not have flashed firmware")
-            if glasgow_config.bitstream_size:
-                logger.info("device has flashed bitstream ID %s",
-                            glasgow_config.bitstream_id.hex())
-            else:
-                logger.info("device does not have flashed bitstream")
-
-            new_bitstream = b""
-            if args.remove_bitstream:
-                logger.info("removing bitstream")
-                glasgow_config.bitstream_size = 0
-                glasgow_config.bitstream_id   = b"\x00"*16
-            elif args.bitstream:
+            new_bitstream_id = new_bitstream = None
+            if args.bitstream:
                 logger.info("using bitstream from %s", args.bitstream.name)
                 with args.bitstream as f:
                     new_bitstream_id = f.read(16)
                     new_bitstream    = f.read()
-                    glasgow_config.bitstream_size = len(new_bitstream)
-                    glasgow_config.bitstream_id   = new_bitstream_id
             elif args.applet:
                 logger.info("generating bitstream for applet %s", args.applet)
                 assembly = HardwareAssembly(revision=args.rev)
@@ -861,60 +1041,59 @@ async def main():
                 # storing the bitstream hash (as opposed to Verilog hash) in the ID,
                 # as building the bitstream takes much longer than flashing it.
                 logger.info("generated bitstream ID %s", new_bitstream_id.hex())
-                glasgow_config.bitstream_size = len(new_bitstream)
-                glasgow_config.bitstream_id   = new_bitstream_id
-
-            fx2_config.firmware[0] = (0x4000 - GlasgowDeviceConfig.size, glasgow_config.encode())
-
-            if args.remove_firmware:
-                logger.info("removing firmware")
-                fx2_config.disconnect = False
-                new_image = fx2_config.encode()
-                # Let FX2 hardware enumerate. This won't load the configuration block
-                # into memory automatically, but the firmware has code that does that
-                # if it detects a C0 load.
-                new_image[0] = 0xC0
-            else:
-                if args.firmware:
-                    logger.warning("using custom firmware from %s", args.firmware.name)
-                    with args.firmware as f:
-                        for (addr, chunk) in input_data(f, fmt="ihex"):
-                            fx2_config.append(addr, chunk)
-                else:
-                    logger.info("using built-in firmware")
-                    for (addr, chunk) in GlasgowDevice.firmware_data():
-                        fx2_config.append(addr, chunk)
-                fx2_config.disconnect = True
-                new_image = fx2_config.encode()
-
-            if new_bitstream:
-                logger.info("programming bitstream")
-                old_bitstream = await device.read_eeprom("ice", 0, len(new_bitstream))
-                if old_bitstream != new_bitstream:
-                    for (addr, chunk) in diff_data(old_bitstream, new_bitstream):
-                        await device.write_eeprom("ice", addr, chunk)
-
-                    logger.info("verifying bitstream")
-                    if await device.read_eeprom("ice", 0, len(new_bitstream)) != new_bitstream:
-                        logger.critical("bitstream programming failed")
-                        return 1
-                else:
-                    logger.info("bitstream identical")
-
-            logger.info("programming configuration and firmware")
-            old_image = await device.read_eeprom("fx2", 0, len(new_image))
-            if old_image != new_image:
-                for (addr, chunk) in diff_data(old_image, new_image):
-                    await device.write_eeprom("fx2", addr, chunk)
-
-                logger.info("verifying configuration and firmware")
-                if await device.read_eeprom("fx2", 0, len(new_image)) != new_image:
-                    logger.critical("configuration/firmware programming failed")
-                    return 1
 
-                logger.warning("power cycle the device to apply changes")
-            else:
-                logger.info("configuration and firmware identical")
+            firmware_data = None
+            if args.firmware:
+                logger.warning("using custom firmware from %s", args.firmware.name)
+                with args.firmware as f:
+                    firmware_data = list(input_data(f, fmt="ihex"))
+            elif not args.remove_firmware:
+                logger.info("using built-in firmware")
+                firmware_data = GlasgowDevice.firmware_data()
+
+            if not args.flash_all:
+                return await _flash_device(device, logger, args,
+                                           firmware_data, new_bitstream_id, new_bitstream)
+
+            if args.serial:
+                logger.error("--serial and --all cannot be used together")
+                return 1
+
+            # Opening devices uploads firmware to all of them at once, and is blocking, so it is
+            # done upfront; programming the EEPROMs is where the time goes, and it is concurrent.
+            devices = {}
+            results = {}
+            for serial in sorted(GlasgowDevice.enumerate_serials()):
+                try:
+                    devices[serial] = GlasgowDevice(serial)
+                except GlasgowDeviceError as e:
+                    logger.getChild(serial).error(e)
+                    results[serial] = 1
+            if not devices and not results:
+                logger.error("device not found")
+                return 1
+            logger.info("programming %d devices", len(devices))
+
+            async def flash_one(serial, device):
+                device_logger = logger.getChild(serial)
+                try:
+                    results[serial] = await _flash_device(device, device_logger, args,
+                        firmware_data, new_bitstream_id, new_bitstream)
+                except (GlasgowDeviceError, usb1.USBError) as e:
+                    device_logger.error(e)
+                    results[serial] = 1
+                finally:
+                    device.close()
+
+            await asyncio.gather(*(flash_one(serial, device)
+                                   for serial, device in devices.items()))
+
+            failed = sorted(serial for serial, result in results.items() if result != 0)
+            logger.info("programmed %d of %d devices",
+                        len(results) - len(failed), len(results))
+            if failed:
+                logger.error("programming failed for devices: %s", ", ".join(failed))
+                return 1
 
         if args.action == "build":
             assembly = HardwareAssembly(revision=args.rev)
@@ -931,7 +1110,70 @@ async def main():
                 logger.info("generating bitstream for applet %r", args.applet)
                 with open(args.filename or args.applet + ".bin", "wb") as f:
                     f.write(plan.bitstream_id)
-                    f.write(plan.get_bitstream())
+                    f.write(plan.get_bitstream(seeds=args.seeds))
+
+        if args.action == "prebuild":
+            if args.applet_list:
+                with args.applet_list as f:
+                    entries = [entry for line in f if (entry := shlex.split(line, comments=True))]
+            else:
+                entries = [[handle] for handle, metadata in GlasgowAppletMetadata.all().items()
+                           if metadata.loadable]
+
+            # Elaboration is done in this process, and is relatively fast; the toolchain runs as
+            # a subprocess, so builds running in a thread pool use all available cores.
+            parser  = get_argparser()
+            results = {} # {description: "hit"|"miss"|"failed"}
+            pending = {} # {bitstream_id: (plan, [description])}
+            for revision in args.revs:
+                for entry in entries:
+                    description = f"rev{revision} {shlex.join(entry)}"
+                    try:
+                        build_args = parser.parse_args(["build", "--rev", revision, *entry])
+                        applet_cls = GlasgowAppletMetadata.get(build_args.applet).load()
+                        if revision < applet_cls.required_revision:
+                            logger.debug("%s: skipped (requires rev%s)",
+                                         description, applet_cls.required_revision)
+                            continue
+                        assembly = HardwareAssembly(revision=revision)
+                        _applet(assembly, build_args)
+                        plan = assembly.artifact()
+                    except (Exception, SystemExit) as e:
+                        UnusedElaboratable._MustUse__silence = True
+                        logger.error("%s: elaboration failed: %s",
+                                     description, e or type(e).__name__)
+                        results[description] = "failed"
+                        continue
+                    if plan.bitstream_id in pending:
+                        pending[plan.bitstream_id][1].append(description)
+                    elif plan.is_cached:
+                        logger.info("%s: cache hit", description)
+                        results[description] = "hit"
+                    else:
+                        pending[plan.bitstream_id] = (plan, [description])
+
+            # Each build may place and route several seeds at once; share the job slots between all
+            # of them so that no more than `--jobs` toolchain processes run at any time.
+            logger.info("building %d bitstreams using %d jobs", len(pending), args.jobs)
+            slots = threading.BoundedSemaphore(args.jobs)
+            with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as executor:
+                futures = {executor.submit(plan.get_bitstream, seeds=args.seeds, slots=slots):
+                               descriptions
+                           for plan, descriptions in pending.values()}
+                for future in concurrent.futures.as_completed(futures):
+                    for description in futures[future]:
+                        if (e := future.exception()) is None:
+                            logger.info("%s: cache miss, built", description)
+                            results[description] = "miss"
+                        else:
+                            logger.error("%s: build failed: %s", description, e)
+                            results[description] = "failed"
+
+            counts = {result: list(results.values()).count(result)
+                      for result in ("hit", "miss", "failed")}
+            logger.info("%d hits, %d misses, %d failures",
+                        counts["hit"], counts["miss"], counts["failed"])
+            return 1 if counts["failed"] else 0
 
         if args.action == "test":
             logger.info("testing applet %r", args.applet)
@@ -1002,6 +1244,32 @@ async def main():
                 print(serial)
             return 0
 
+        if args.action == "daemon":
+            from .hardware.daemon import DeviceDaemon
+            daemon = DeviceDaemon(args.daemon_socket)
+            await daemon.listen()
+            try:
+                async with asyncio.TaskGroup() as group:
+                    group.create_task(daemon.serve())
+                    group.create_task(wait_for_sigint())
+            except* SIGINTCaught:
+                pass
+            return 0
+
+        if args.action == "host-benchmark":
+            from .hardware.virtual import benchmark_pipes
+            print("Mode\tTuning\t\tMiB/s\tCPU ms/MiB")
+            for mode in args.modes or ("source", "sink", "loopback"):
+                for tuning in args.tunings or ("throughput", "latency", "adaptive"):
+                    result = await benchmark_pipes(mode=mode, length=args.count, tuning=tuning,
+                        latency=args.latency / 1e6,
+                        bandwidth=None if args.bandwidth is None else args.bandwidth * (1 << 20))
+                    mebibytes = result["length"] / (1 << 20)
+                    print(f"{mode}\t{tuning:<10s}\t"
+                          f"{mebibytes / result['elapsed']:.2f}\t"
+                          f"{result['cpu'] * 1000 / mebibytes:.2f}")
+            return 0
+
     # Device-related errors
     except GlasgowDeviceError as e:
         logger.error(e)
@@ -1035,10 +1303,10 @@ async def main():
 
 
 # This entry point is invoked via `project.scripts.glasgow` when installing the package with `pipx`.
-def run_main():
-    exit(asyncio.new_event_loop().run_until_complete(main()))
+def run_main(import_profiler=None):
+    exit(asyncio.new_event_loop().run_until_complete(main(import_profiler)))
 
 
-# This entry point is invoked when running `python -m glasgow.cli`.
+# This entry point is invoked when running `python -m glasgow.cli`; it cannot profile startup.
 if __name__ == "__main__":
     run_main()
@@ -1,10 +1,15 @@
 from functools import reduce
 from collections import OrderedDict
+from dataclasses import dataclass, field
+import array
 from amaranth import *
 from amaranth.lib.fifo import FIFOInterface, SyncFIFOBuffered
 
 
-__all__ = ["EventSource", "EventAnalyzer", "TraceDecodingError", "TraceDecoder"]
+__all__ = [
+    "EventSource", "EventAnalyzer", "TraceCompressor",
+    "TraceDecodingError", "TraceColumns", "TraceDecoder"
+]
 
 
 REPORT_DELAY        = 0b10000000
@@ -17,6 +22,8 @@ SPECIAL_DONE        =   0b000000
 SPECIAL_OVERRUN     =   0b000001
 SPECIAL_THROTTLE    =   0b000010
 SPECIAL_DETHROTTLE  =   0b000011
+SPECIAL_REPEAT_1    =   0b000100
+SPECIAL_REPEAT_2    =   0b000101
 
 
 class _PriorityEncoder(Elaboratable):
@@ -109,6 +116,9 @@ class EventAnalyzer(Elaboratable):
     only cycles that have at least one event add new FIFO entries, and only one wide timestamp
     counter needs to be maintained, greatly reducing the amount of necessary resources compared
     to a more naive approach.
+
+    If ``compress`` is true, the trace is passed through a :class:`TraceCompressor` before it
+    reaches the output FIFO.
     """
 
     @staticmethod
@@ -124,13 +134,18 @@ class EventAnalyzer(Elaboratable):
         else:
             return 256
 
-    def __init__(self, output_fifo, event_depth=None, delay_width=16):
+    def __init__(self, output_fifo, event_depth=None, delay_width=16, compress=False):
         # assert output_fifo.width == 8
 
-        self.output_fifo   = output_fifo
         self.delay_width   = delay_width
         self.event_depth   = event_depth
         self.event_sources = Array()
+        if compress:
+            self.compressor  = TraceCompressor(output_fifo, self.event_sources)
+            self.output_fifo = self.compressor
+        else:
+            self.compressor  = None
+            self.output_fifo = output_fifo
         self.done          = Signal()
         self.throttle      = Signal()
         self.overrun       = Signal()
@@ -151,6 +166,9 @@ class EventAnalyzer(Elaboratable):
         assert len(self.event_sources) < 2 ** 6
         assert max(s.width for s in self.event_sources) <= 32
 
+        if self.compressor is not None:
+            m.submodules.compressor = self.compressor
+
         # Fill the event, event data, and delay FIFOs.
         throttle_on    = Signal()
         throttle_off   = Signal()
@@ -371,31 +389,363 @@ class EventAnalyzer(Elaboratable):
         return m
 
 
+class TraceCompressor(Elaboratable):
+    """
+    Event analyzer trace compressor.
+
+    This compressor is inserted between the event analyzer and its output FIFO, and presents
+    the same write interface as the output FIFO. It splits the trace into groups, each of which
+    is a delay report followed by all of the event and throttle reports for the same cycle, and
+    replaces runs of groups that are identical to the group one or two groups earlier with
+    a ``SPECIAL_REPEAT_1`` or ``SPECIAL_REPEAT_2`` report followed by a repeat count octet.
+    The first case covers repeated strobes; the second case covers periodic signals, such as
+    a toggling clock, where every change event alternates between two values.
+
+    The compressor needs to know the width of every event source to distinguish event data from
+    reports, so it must be given the ``event_sources`` of the analyzer it is attached to; these are
+    only examined during elaboration, so event sources may be added after the compressor is
+    created.
+
+    Groups longer than ``group_depth`` octets are never compressed. Since a group is only known
+    to be complete once the next one starts, a group is held back by the compressor until then,
+    or until ``idle_cycles`` cycles pass without the analyzer writing anything. A group that is
+    flushed this way is never compressed, and neither is the group after it, so waveforms that
+    repeat less often than every ``idle_cycles`` cycles are not compressed at all. (The output
+    FIFO is a stream that does not report its level, so the flush cannot wait for the host to
+    drain it instead.)
+
+    Once a group is known to differ from both of the preceding groups, and no run is pending,
+    the part of it collected so far is emitted, and the rest of it is passed through as it is
+    written. A group of ``N`` octets that does not repeat takes ``N + 1`` cycles if it differs
+    from the preceding groups in its first octet (which is the common case, since that is
+    the delay report), and a group that continues a run takes ``N + 2`` cycles, compared to
+    ``N`` cycles without the compressor.
+    """
+    def __init__(self, output_fifo, event_sources, group_depth=8, idle_cycles=1 << 16):
+        self.output_fifo   = output_fifo
+        self.event_sources = event_sources
+        self.group_depth   = group_depth
+        self.idle_cycles   = idle_cycles
+
+        self.width  = 8
+        self.w_data = Signal(8)
+        self.w_en   = Signal()
+        self.w_rdy  = Signal()
+        self.flush  = Signal()
+
+    def elaborate(self, platform):
+        m = Module()
+
+        def is_delay(octet):
+            return octet[7] == 1
+
+        def is_terminal(octet):
+            return ((octet[6:] == REPORT_SPECIAL >> 6) &
+                    ((octet[:6] == SPECIAL_DONE) | (octet[:6] == SPECIAL_OVERRUN)))
+
+        def emit(octet):
+            m.d.comb += [
+                self.output_fifo.w_data.eq(octet),
+                self.output_fifo.w_en.eq(1),
+            ]
+
+        depth = self.group_depth
+
+        # The group being collected, and the two preceding groups.
+        cur_data  = Array(Signal(8, name=f"cur_data_{n}") for n in range(depth))
+        cur_len   = Signal(range(depth + 1))
+        cur_match = Signal(2, init=0b11) # bit n: matches the group n + 1 groups earlier so far
+        prev_data = [Array(Signal(8, name=f"prev{n + 1}_data_{i}") for i in range(depth))
+                     for n in range(2)]
+        prev_len  = [Signal(range(depth + 1), name=f"prev{n + 1}_len") for n in range(2)]
+        prev_ok   = [Signal(name=f"prev{n + 1}_ok") for n in range(2)]
+        nondelay  = Signal() # the current group has something other than a delay report
+        cur_ok    = Signal() # the group being passed through may be used as a reference
+        data_left = Signal(3) # octets of event data that follow
+
+        data_octets = Array(C((event_source.width + 7) // 8, 3)
+                            for event_source in self.event_sources)
+
+        def track(octet):
+            with m.If(data_left != 0):
+                m.d.sync += data_left.eq(data_left - 1)
+            with m.Elif(octet[6:] == REPORT_EVENT >> 6):
+                m.d.sync += data_left.eq(data_octets[octet[:6]])
+            m.d.sync += nondelay.eq(nondelay | ~is_delay(octet) | (data_left != 0))
+
+        # The first octet of the next group, or a terminal special report.
+        hold_data = Signal(8)
+        hold_ok   = Signal()
+
+        run_dist  = Signal(2) # 0 if there is no run
+        run_count = Signal(8)
+        emit_idx  = Signal(range(depth + 1))
+        idle      = Signal(range(self.idle_cycles + 1))
+
+        full_match = Signal(2)
+        for n in range(2):
+            m.d.comb += full_match[n].eq(cur_match[n] & prev_ok[n] & (cur_len == prev_len[n]))
+
+        def append(octet):
+            m.d.sync += [
+                cur_data[cur_len].eq(octet),
+                cur_len.eq(cur_len + 1),
+            ]
+            track(octet)
+            for n in range(2):
+                with m.If((cur_len >= prev_len[n]) | (prev_data[n][cur_len] != octet)):
+                    m.d.sync += cur_match[n].eq(0)
+
+        def hopeless(octet):
+            # Whether the current group, once `octet` is appended to it, cannot be a part of a run.
+            mismatch = [~cur_match[n] | ~prev_ok[n] | (cur_len >= prev_len[n]) |
+                        (prev_data[n][cur_len] != octet) for n in range(2)]
+            return (run_dist == 0) & mismatch[0] & mismatch[1]
+
+        def rotate(ok):
+            for i in range(depth):
+                m.d.sync += [
+                    prev_data[1][i].eq(prev_data[0][i]),
+                    prev_data[0][i].eq(cur_data[i]),
+                ]
+            m.d.sync += [
+                prev_len[1].eq(prev_len[0]),
+                prev_len[0].eq(cur_len),
+                prev_ok[1].eq(prev_ok[0]),
+                prev_ok[0].eq(ok),
+                cur_len.eq(0),
+                cur_match.eq(0b11),
+                nondelay.eq(0),
+            ]
+
+        boundary = (data_left == 0) & ((is_delay(self.w_data) & nondelay) |
+                                       is_terminal(self.w_data))
+
+        with m.FSM():
+            with m.State("COLLECT"):
+                m.d.comb += self.w_rdy.eq(1)
+                with m.If(self.w_en):
+                    m.d.sync += idle.eq(0)
+                    with m.If(boundary):
+                        m.d.sync += hold_data.eq(self.w_data)
+                        m.d.sync += hold_ok.eq(1)
+                        m.next = "DECIDE"
+                    with m.Elif(cur_len == depth):
+                        m.d.sync += hold_data.eq(self.w_data)
+                        m.d.sync += hold_ok.eq(1)
+                        track(self.w_data)
+                        m.next = "LONG"
+                    with m.Else():
+                        append(self.w_data)
+                        with m.If(hopeless(self.w_data)):
+                            m.d.sync += emit_idx.eq(0)
+                            m.d.sync += hold_ok.eq(0)
+                            m.d.sync += cur_ok.eq(1)
+                            m.next = "LONG-GROUP"
+                with m.Elif((cur_len != 0) | (run_dist != 0)):
+                    with m.If(idle == self.idle_cycles):
+                        m.d.sync += idle.eq(0)
+                        m.d.sync += hold_ok.eq(0)
+                        m.next = "LONG"
+                    with m.Else():
+                        m.d.sync += idle.eq(idle + 1)
+                with m.Elif(self.flush):
+                    if hasattr(self.output_fifo, "flush"):
+                        m.d.comb += self.output_fifo.flush.eq(1)
+
+            with m.State("DECIDE"):
+                with m.If(cur_len == 0):
+                    m.next = "NEXT"
+                with m.Elif(((run_dist == 1) & full_match[0]) | ((run_dist == 2) & full_match[1])):
+                    m.d.sync += run_count.eq(run_count + 1)
+                    rotate(ok=1)
+                    m.next = "NEXT"
+                with m.Elif(run_dist != 0):
+                    m.next = "EMIT-REPEAT"
+                with m.Elif(full_match[0]):
+                    m.d.sync += run_dist.eq(1)
+                    m.d.sync += run_count.eq(1)
+                    rotate(ok=1)
+                    m.next = "NEXT"
+                with m.Elif(full_match[1]):
+                    m.d.sync += run_dist.eq(2)
+                    m.d.sync += run_count.eq(1)
+                    rotate(ok=1)
+                    m.next = "NEXT"
+                with m.Else():
+                    m.d.sync += emit_idx.eq(0)
+                    m.next = "EMIT-GROUP"
+
+            with m.State("EMIT-GROUP"):
+                with m.If(self.output_fifo.w_rdy):
+                    emit(cur_data[emit_idx])
+                    m.d.sync += emit_idx.eq(emit_idx + 1)
+                    with m.If(emit_idx + 1 == cur_len):
+                        rotate(ok=1)
+                        m.next = "NEXT"
+
+            with m.State("NEXT"):
+                with m.If(run_count == 0xff):
+                    m.next = "EMIT-REPEAT"
+                with m.Elif(hold_ok & is_terminal(hold_data) & (run_dist != 0)):
+                    m.next = "EMIT-REPEAT"
+                with m.Elif(~hold_ok):
+                    m.next = "COLLECT"
+                with m.Elif(is_terminal(hold_data)):
+                    m.next = "EMIT-TERMINAL"
+                with m.Elif(hopeless(hold_data)):
+                    with m.If(self.output_fifo.w_rdy):
+                        emit(hold_data)
+                        append(hold_data)
+                        m.d.sync += hold_ok.eq(0)
+                        m.d.sync += cur_ok.eq(1)
+                        m.next = "LONG-PASS"
+                with m.Else():
+                    append(hold_data)
+                    m.next = "COLLECT"
+
+            with m.State("EMIT-REPEAT"):
+                with m.If(self.output_fifo.w_rdy):
+                    with m.If(run_dist == 1):
+                        emit(REPORT_SPECIAL | SPECIAL_REPEAT_1)
+                    with m.Else():
+                        emit(REPORT_SPECIAL | SPECIAL_REPEAT_2)
+                    m.next = "EMIT-REPEAT-COUNT"
+
+            with m.State("EMIT-REPEAT-COUNT"):
+                with m.If(self.output_fifo.w_rdy):
+                    emit(run_count)
+                    m.d.sync += run_dist.eq(0)
+                    m.d.sync += run_count.eq(0)
+                    m.next = "DECIDE"
+
+            with m.State("EMIT-TERMINAL"):
+                with m.If(self.output_fifo.w_rdy):
+                    emit(hold_data)
+                    m.d.sync += hold_ok.eq(0)
+                    m.d.sync += prev_ok[0].eq(0)
+                    m.d.sync += prev_ok[1].eq(0)
+                    m.next = "COLLECT"
+
+            # A group that is too long to compress (or that has been held back for too long) is
+            # flushed, and the rest of it is passed through. A group that cannot be compressed
+            # takes the same path, except that it remains a reference for the following groups.
+            with m.State("LONG"):
+                m.d.sync += cur_ok.eq(0)
+                with m.If(run_dist != 0):
+                    m.next = "LONG-REPEAT"
+                with m.Else():
+                    m.d.sync += emit_idx.eq(0)
+                    m.next = "LONG-GROUP"
+
+            with m.State("LONG-REPEAT"):
+                with m.If(self.output_fifo.w_rdy):
+                    with m.If(run_dist == 1):
+                        emit(REPORT_SPECIAL | SPECIAL_REPEAT_1)
+                    with m.Else():
+                        emit(REPORT_SPECIAL | SPECIAL_REPEAT_2)
+                    m.next = "LONG-REPEAT-COUNT"
+
+            with m.State("LONG-REPEAT-COUNT"):
+                with m.If(self.output_fifo.w_rdy):
+                    emit(run_count)
+                    m.d.sync += run_dist.eq(0)
+                    m.d.sync += run_count.eq(0)
+                    m.d.sync += emit_idx.eq(0)
+                    m.next = "LONG-GROUP"
+
+            with m.State("LONG-GROUP"):
+                with m.If(emit_idx == cur_len):
+                    m.next = "LONG-HOLD"
+                with m.Elif(self.output_fifo.w_rdy):
+                    emit(cur_data[emit_idx])
+                    m.d.sync += emit_idx.eq(emit_idx + 1)
+                    with m.If((emit_idx + 1 == cur_len) & ~hold_ok):
+                        m.next = "LONG-PASS"
+
+            with m.State("LONG-HOLD"):
+                with m.If(~hold_ok):
+                    m.next = "LONG-PASS"
+                with m.Elif(self.output_fifo.w_rdy):
+                    emit(hold_data)
+                    m.d.sync += hold_ok.eq(0)
+                    m.next = "LONG-PASS"
+
+            with m.State("LONG-PASS"):
+                m.d.comb += self.w_rdy.eq(self.output_fifo.w_rdy)
+                with m.If(self.w_en & self.output_fifo.w_rdy):
+                    with m.If(boundary):
+                        m.d.sync += hold_data.eq(self.w_data)
+                        m.d.sync += hold_ok.eq(1)
+                        rotate(ok=cur_ok)
+                        m.next = "NEXT"
+                    with m.Else():
+                        emit(self.w_data)
+                        with m.If(cur_ok & (cur_len != depth)):
+                            append(self.w_data)
+                        with m.Else():
+                            track(self.w_data)
+                            m.d.sync += cur_ok.eq(0)
+
+        return m
+
+
 class TraceDecodingError(Exception):
     pass
 
 
+@dataclass
+class TraceColumns:
+    """
+    Columnar event analyzer trace.
+
+    Each row is one event: ``timestamps[n]`` is the cycle at which it happened, ``sources[n]`` is
+    the index of its event source (or ``THROTTLE`` for a throttle change), and ``values[n]`` is
+    its data (the throttle state, or all fields of the event source packed together).
+    """
+    THROTTLE = -1
+
+    timestamps: array.array = field(default_factory=lambda: array.array("Q"))
+    sources:    array.array = field(default_factory=lambda: array.array("b"))
+    values:     array.array = field(default_factory=lambda: array.array("Q"))
+
+    def __len__(self):
+        return len(self.timestamps)
+
+
 class TraceDecoder:
     """
     Event analyzer trace decoder.
 
     Decodes raw analyzer traces into a timestamped sequence of maps from event fields to
-    their values.
+    their values, or into :class:`TraceColumns`. Traces compressed by :class:`TraceCompressor`
+    can only be decoded if ``compressed`` is true, which makes decoding somewhat slower.
     """
-    def __init__(self, event_sources, absolute_timestamps=True):
+    def __init__(self, event_sources, absolute_timestamps=True, compressed=False):
         self.event_sources       = event_sources
         self.absolute_timestamps = absolute_timestamps
+        self.compressed          = compressed
 
         self._state      = "IDLE"
         self._byte_off   = 0
         self._timestamp  = 0
         self._delay      = 0
         self._event_src  = 0
+        self._event_idx  = 0
         self._event_off  = 0
         self._event_data = 0
         self._pending    = OrderedDict()
         self._timeline   = []
 
+        # Compressed trace state; see `TraceCompressor` for the definition of a group.
+        self._group      = bytearray()
+        self._nondelay   = False
+        self._groups     = [] # at most two preceding groups
+        self._repeat     = None # distance, if a repeat count is expected
+
+        # Columnar output, while `process_columns` is running.
+        self._columns    = None
+
     def events(self):
         """
         Return names and widths for all events that may be emitted by this trace decoder.
@@ -423,78 +773,266 @@ class TraceDecoder:
             self._timestamp  = self._delay
         self._delay = 0
 
+    @property
+    def timestamp(self):
+        """Timestamp of the most recently decoded event."""
+        return self._timestamp
+
+    def _record(self, name, source, value):
+        if self._columns is None:
+            self._pending[name] = value
+        else:
+            self._columns.timestamps.append(self._timestamp)
+            self._columns.sources.append(source)
+            self._columns.values.append(value or 0)
+
+    def _end_group(self):
+        if self._group:
+            self._groups = [*self._groups[-1:], bytes(self._group)]
+            self._group.clear()
+            self._nondelay = False
+
     def process(self, data):
         """
         Incrementally parse a chunk of analyzer trace, and record events in it.
         """
+        if not self.compressed:
+            for octet in data:
+                self._process_octet(octet)
+                self._byte_off += 1
+            return
+
         for octet in data:
-            is_delay   = ((octet & REPORT_DELAY_MASK)   == REPORT_DELAY)
-            is_event   = ((octet & REPORT_EVENT_MASK)   == REPORT_EVENT)
-            is_special = ((octet & REPORT_SPECIAL_MASK) == REPORT_SPECIAL)
-            special    = octet & ~REPORT_SPECIAL
-
-            if self._state == "IDLE" and is_delay:
-                self._state = "DELAY"
-                self._delay = octet & ~REPORT_DELAY_MASK
-
-            elif self._state == "DELAY" and is_delay:
-                self._delay = (self._delay << 7) | (octet & ~REPORT_DELAY_MASK)
-
-            elif self._state == "DELAY" and is_special and \
-                        special in (SPECIAL_THROTTLE, SPECIAL_DETHROTTLE):
-                self._flush_timestamp()
-
-                if special == SPECIAL_THROTTLE:
-                    self._pending["throttle"] = 1
-                elif special == SPECIAL_DETHROTTLE:
-                    self._pending["throttle"] = 0
-
-            elif self._state in ("IDLE", "DELAY") and is_event:
-                self._flush_timestamp()
-
-                if (octet & ~REPORT_EVENT_MASK) > len(self.event_sources):
-                    raise TraceDecodingError("at byte offset %d: event source out of bounds" %
-                                             self._byte_off)
-                self._event_src = self.event_sources[octet & ~REPORT_EVENT_MASK]
-                if self._event_src.width == 0:
-                    self._pending[self._event_src.name] = None
-                    self._state = "IDLE"
-                else:
-                    self._event_off  = self._event_src.width
-                    self._event_data = 0
-                    self._state = "EVENT"
-
-            elif self._state == "EVENT":
-                self._event_data <<= 8
-                self._event_data  |= octet
-                if self._event_off > 8:
-                    self._event_off -= 8
-                else:
-                    if self._event_src.fields:
-                        offset = 0
-                        for field_name, field_width in self._event_src.fields:
-                            self._pending["{}-{}".format(field_name, self._event_src.name)] = \
-                                (self._event_data >> offset) & ((1 << field_width) - 1)
-                            offset += field_width
-                    else:
-                        self._pending[self._event_src.name] = self._event_data
-
-                    self._state = "IDLE"
-
-            elif self._state in "DELAY" and is_special and \
-                        special in (SPECIAL_DONE, SPECIAL_OVERRUN):
-                self._flush_timestamp()
-                if special == SPECIAL_DONE:
-                    self._state = "DONE"
-                elif special == SPECIAL_OVERRUN:
-                    self._state = "OVERRUN"
+            if self._state == "EVENT":
+                self._group.append(octet)
+                self._process_octet(octet)
+
+            elif self._repeat is not None:
+                distance, self._repeat = self._repeat, None
+                if distance > len(self._groups):
+                    raise TraceDecodingError("at byte offset %d: repeat of a group that was "
+                                             "not decoded" % self._byte_off)
+                for _ in range(octet):
+                    group = self._groups[-distance]
+                    for group_octet in group:
+                        self._process_octet(group_octet)
+                    self._groups = [*self._groups[-1:], group]
+
+            elif octet in (REPORT_SPECIAL | SPECIAL_REPEAT_1, REPORT_SPECIAL | SPECIAL_REPEAT_2):
+                self._end_group()
+                self._repeat = 1 if octet == REPORT_SPECIAL | SPECIAL_REPEAT_1 else 2
+
+            elif octet in (REPORT_SPECIAL | SPECIAL_DONE, REPORT_SPECIAL | SPECIAL_OVERRUN):
+                self._group.clear()
+                self._nondelay = False
+                self._groups.clear()
+                self._process_octet(octet)
 
             else:
-                raise TraceDecodingError("at byte offset %d: invalid byte %#04x for state %s" %
-                                         (self._byte_off, octet, self._state))
+                if (octet & REPORT_DELAY_MASK) == REPORT_DELAY:
+                    if self._nondelay:
+                        self._end_group()
+                else:
+                    self._nondelay = True
+                self._group.append(octet)
+                self._process_octet(octet)
 
             self._byte_off += 1
 
+    def _process_octet(self, octet):
+        is_delay   = ((octet & REPORT_DELAY_MASK)   == REPORT_DELAY)
+        is_event   = ((octet & REPORT_EVENT_MASK)   == REPORT_EVENT)
+        is_special = ((octet & REPORT_SPECIAL_MASK) == REPORT_SPECIAL)
+        special    = octet & ~REPORT_SPECIAL
+
+        if self._state == "IDLE" and is_delay:
+            self._state = "DELAY"
+            self._delay = octet & ~REPORT_DELAY_MASK
+
+        elif self._state == "DELAY" and is_delay:
+            self._delay = (self._delay << 7) | (octet & ~REPORT_DELAY_MASK)
+
+        elif self._state == "DELAY" and is_special and \
+                    special in (SPECIAL_THROTTLE, SPECIAL_DETHROTTLE):
+            self._flush_timestamp()
+
+            if special == SPECIAL_THROTTLE:
+                self._record("throttle", TraceColumns.THROTTLE, 1)
+            elif special == SPECIAL_DETHROTTLE:
+                self._record("throttle", TraceColumns.THROTTLE, 0)
+
+        elif self._state in ("IDLE", "DELAY") and is_event:
+            self._flush_timestamp()
+
+            if (octet & ~REPORT_EVENT_MASK) > len(self.event_sources):
+                raise TraceDecodingError("at byte offset %d: event source out of bounds" %
+                                         self._byte_off)
+            self._event_idx = octet & ~REPORT_EVENT_MASK
+            self._event_src = self.event_sources[self._event_idx]
+            if self._event_src.width == 0:
+                self._record(self._event_src.name, self._event_idx, None)
+                self._state = "IDLE"
+            else:
+                self._event_off  = self._event_src.width
+                self._event_data = 0
+                self._state = "EVENT"
+
+        elif self._state == "EVENT":
+            self._event_data <<= 8
+            self._event_data  |= octet
+            if self._event_off > 8:
+                self._event_off -= 8
+            else:
+                if self._columns is not None:
+                    self._record(None, self._event_idx, self._event_data)
+                elif self._event_src.fields:
+                    offset = 0
+                    for field_name, field_width in self._event_src.fields:
+                        self._pending["{}-{}".format(field_name, self._event_src.name)] = \
+                            (self._event_data >> offset) & ((1 << field_width) - 1)
+                        offset += field_width
+                else:
+                    self._pending[self._event_src.name] = self._event_data
+
+                self._state = "IDLE"
+
+        elif self._state in "DELAY" and is_special and \
+                    special in (SPECIAL_DONE, SPECIAL_OVERRUN):
+            self._flush_timestamp()
+            if special == SPECIAL_DONE:
+                self._state = "DONE"
+            elif special == SPECIAL_OVERRUN:
+                self._state = "OVERRUN"
+
+        else:
+            raise TraceDecodingError("at byte offset %d: invalid byte %#04x for state %s" %
+                                     (self._byte_off, octet, self._state))
+
+    def process_columns(self, data):
+        """
+        Incrementally parse a chunk of analyzer trace, and return the events in it as
+        :class:`TraceColumns`.
+
+        Unlike :meth:`process`, this method does not group events by timestamp, and returns every
+        event as soon as it is decoded. If NumPy is available, the most common kind of trace (where
+        every cycle has exactly one event, and every event source has the same width) is decoded
+        using array operations; the rest of the trace is decoded the same way as by :meth:`process`.
+        This method should not be mixed with :meth:`process` on the same decoder.
+        """
+        self._columns = columns = TraceColumns()
+        try:
+            data = memoryview(data).cast("B")
+            data_octets = {(event_src.width + 7) // 8 for event_src in self.event_sources}
+            try:
+                import numpy
+            except ImportError:
+                data_octets = None
+            if data_octets is None or len(data_octets) != 1:
+                self.process(data)
+                return columns
+
+            data_octets, = data_octets
+            offset  = 0
+            backoff = 64
+            while offset < len(data):
+                # The array decoder can only start at a group boundary.
+                while offset < len(data) and not (self._state == "IDLE" and
+                                                  self._repeat is None):
+                    self.process(data[offset:offset + 1])
+                    offset += 1
+                consumed = self._process_array(data[offset:], data_octets)
+                if consumed == 0:
+                    # Decode the irregular part of the trace one octet at a time, and try again
+                    # later, backing off exponentially to avoid quadratic behavior.
+                    self.process(data[offset:offset + backoff])
+                    offset  += backoff
+                    backoff *= 2
+                else:
+                    offset  += consumed
+                    backoff  = 64
+        finally:
+            self._columns = None
+        return columns
+
+    def _process_array(self, data, data_octets):
+        import numpy as np
+
+        if len(data) == 0:
+            return 0
+
+        octets = np.frombuffer(data, dtype=np.uint8)
+        is_delay = (octets & REPORT_DELAY_MASK) == REPORT_DELAY
+
+        # Find the event reports, assuming that each one follows a delay report. This also finds
+        # event data that looks like an event report; such data can only appear within `data_octets`
+        # octets after an actual event report, and the next actual event report is the first one
+        # after its data and at least one delay report. Following this chain is the only part of
+        # decoding that is done per event rather than per trace.
+        is_event = ((octets & REPORT_EVENT_MASK) == REPORT_EVENT)
+        is_event[1:] &= is_delay[:-1]
+        is_event[0] = False
+        events = np.flatnonzero(is_event)
+        events = events[events + data_octets < len(octets)]
+        if len(events) == 0:
+            return 0
+        next_events = np.searchsorted(events, events + data_octets + 2).tolist()
+        chain, index = [], 0
+        while index < len(events):
+            chain.append(index)
+            index = next_events[index]
+        events = events[chain]
+
+        # Check that the trace consists of nothing but groups of 1 to 5 delay reports, an event
+        # report, and its data; only decode the groups before the first one that isn't.
+        starts = np.empty_like(events)
+        starts[0] = 0
+        starts[1:] = events[:-1] + data_octets + 1
+        delays = events - starts
+        delay_count = np.concatenate(([0], np.cumsum(is_delay)))
+        valid = ((delays >= 1) & (delays <= 5) &
+                 (delay_count[events] - delay_count[starts] == delays) &
+                 ((octets[events] & 0b111111) < len(self.event_sources)))
+        if not valid.all():
+            count = int(np.argmin(valid))
+            if count == 0:
+                return 0
+            events, starts, delays = events[:count], starts[:count], delays[:count]
+
+        # Decode delay reports: the septet at `index` contributes `7 * (event - index - 1)` bits.
+        group = np.repeat(np.arange(len(events)), delays)
+        index = np.arange(len(group)) - np.repeat(np.cumsum(delays) - delays, delays) + \
+            np.repeat(starts, delays)
+        septets = (octets[index] & 0b1111111).astype(np.uint64) << \
+            (7 * (events[group] - index - 1)).astype(np.uint64)
+        delays = np.add.reduceat(septets, np.cumsum(delays) - delays)
+
+        # Decode event data, most significant octet first.
+        values = np.zeros(len(events), dtype=np.uint64)
+        for octet_no in range(data_octets):
+            values = (values << np.uint64(8)) | octets[events + 1 + octet_no].astype(np.uint64)
+
+        if self.absolute_timestamps:
+            timestamps = np.cumsum(delays) + np.uint64(self._timestamp)
+        else:
+            timestamps = delays
+        self._timestamp = int(timestamps[-1])
+
+        columns = self._columns
+        columns.timestamps.frombytes(timestamps.astype(np.uint64).tobytes())
+        columns.sources.frombytes((octets[events] & 0b111111).astype(np.int8).tobytes())
+        columns.values.frombytes(values.tobytes())
+
+        # Keep the state used for decoding compressed traces consistent with the scalar decoder.
+        ends = events + data_octets + 1
+        if self.compressed:
+            for start, end in zip(starts[-3:], ends[-3:]):
+                self._end_group()
+                self._group[:] = data[int(start):int(end)]
+                self._nondelay = True
+        consumed = int(ends[-1])
+        self._byte_off += consumed
+        return consumed
+
     def flush(self, pending=False):
         """
         Return the complete event timeline since the start of decoding or the previous flush.
@@ -512,3 +1050,6 @@ class TraceDecoder:
 
     def is_done(self):
         return self._state in ("DONE", "OVERRUN")
+
+    def is_overrun(self):
+        return self._state == "OVERRUN"
@@ -1,7 +1,8 @@
 from amaranth import *
+from amaranth.lib import stream
 
 
-__all__ = ["Registers", "I2CRegisters"]
+__all__ = ["Registers", "I2CRegisters", "StreamRegisters"]
 
 
 class Registers(Elaboratable):
@@ -110,3 +111,100 @@ class I2CRegisters(Registers):
                     m.d.sync += reg.eq(reg.init)
 
         return m
+
+
+class StreamRegisters(Registers):
+    """
+    A register array, accessible over a pair of byte streams.
+
+    Each access is a frame received on ``i``: a command byte (``0x00`` for a read, ``0x01`` for
+    a write), an address byte, and, for a write, as many data bytes as the register is wide.
+    A read is answered on ``o`` with the register data, and a write with a single ``0x00`` byte
+    once the register is updated. All register data is little endian.
+
+    Commands other than read or write, and addresses beyond the last register, are not detected;
+    the host is expected to only access registers that it has allocated.
+
+    :attr reset:
+        Discards a partially received or transmitted frame. Asserted whenever either stream
+        is reset, so that the framing recovers if the host abandons an access.
+    """
+    CMD_READ  = 0x00
+    CMD_WRITE = 0x01
+
+    def __init__(self):
+        super().__init__()
+        self.i = stream.Signature(8).flip().create()
+        self.o = stream.Signature(8).create()
+        self.reset = Signal()
+
+    def elaborate(self, platform):
+        m = super().elaborate(platform)
+
+        if self.reg_count != 0:
+            widths     = [(len(Value.cast(reg)) + 7) // 8 for reg in self.regs_r]
+            reg_bytes  = Array(C(width - 1, range(max(widths))) for width in widths)
+            reg_write  = Signal()
+            reg_addr   = Signal(range(self.reg_count))
+            reg_data   = Signal(max(widths) * 8)
+            reg_index  = Signal(range(max(widths)))
+
+            def reset_framing():
+                with m.If(self.reset):
+                    m.next = "Command"
+
+            with m.FSM():
+                with m.State("Command"):
+                    m.d.comb += self.i.ready.eq(1)
+                    with m.If(self.i.valid):
+                        m.d.sync += reg_write.eq(self.i.payload == self.CMD_WRITE)
+                        m.next = "Address"
+                    reset_framing()
+
+                with m.State("Address"):
+                    m.d.comb += self.i.ready.eq(1)
+                    with m.If(self.i.valid):
+                        m.d.sync += reg_addr.eq(self.i.payload)
+                        m.d.sync += reg_index.eq(0)
+                        with m.If(reg_write):
+                            m.d.sync += reg_data.eq(0)
+                            m.next = "Write-Data"
+                        with m.Else():
+                            m.d.sync += reg_data.eq(self.regs_r[self.i.payload])
+                            m.next = "Read-Data"
+                    reset_framing()
+
+                with m.State("Read-Data"):
+                    m.d.comb += self.o.payload.eq(reg_data.word_select(reg_index, 8))
+                    m.d.comb += self.o.valid.eq(1)
+                    with m.If(self.o.ready):
+                        m.d.sync += reg_index.eq(reg_index + 1)
+                        with m.If(reg_index == reg_bytes[reg_addr]):
+                            m.next = "Command"
+                    reset_framing()
+
+                with m.State("Write-Data"):
+                    m.d.comb += self.i.ready.eq(1)
+                    with m.If(self.i.valid):
+                        m.d.sync += reg_data.word_select(reg_index, 8).eq(self.i.payload)
+                        m.d.sync += reg_index.eq(reg_index + 1)
+                        with m.If(reg_index == reg_bytes[reg_addr]):
+                            m.next = "Write-Update"
+                    reset_framing()
+
+                with m.State("Write-Update"):
+                    m.d.sync += self.regs_w[reg_addr].eq(reg_data)
+                    m.next = "Write-Acknowledge"
+
+                with m.State("Write-Acknowledge"):
+                    m.d.comb += self.o.payload.eq(0x00)
+                    m.d.comb += self.o.valid.eq(1)
+                    with m.If(self.o.ready):
+                        m.next = "Command"
+                    reset_framing()
+
+            for reg, reg_rst in self.regs_rst:
+                with m.If(reg_rst):
+                    m.d.sync += reg.eq(reg.init)
+
+        return m
@@ -238,9 +238,10 @@ class Command(enum.Enum, shape=1):
 
 
 class Response(enum.Enum, shape=2):
-    Data   = 0
-    NoData = 1
-    Error  = 2
+    Data    = 0
+    NoData  = 1
+    Error   = 2
+    Skipped = 3 # `sticky=True` only
 
 
 class Controller(wiring.Component):
@@ -258,9 +259,16 @@ class Controller(wiring.Component):
     divisor: In(16)
     timeout: In(16, init=~0) # how many times to retry in response to WAIT
 
-    def __init__(self, ports, *, offset=0):
+    # If `sticky` is true, then once a transfer fails (with a FAULT, a WAIT after the configured
+    # number of retries, or a communication error), every transfer after it is skipped without
+    # reaching the wire until a sequence is sent or a write to DP ABORT completes. This allows
+    # the host to queue many dependent transfers without waiting for each acknowledgement.
+    # Reads of DP DPIDR and DP CTRL/STAT are never skipped, so that the cause of the failure can
+    # be examined before it is cleared; they do not clear the failure themselves.
+    def __init__(self, ports, *, offset=0, sticky=False):
         self._ports  = ports
         self._offset = offset
+        self._sticky = sticky
 
         super().__init__()
 
@@ -277,16 +285,33 @@ class Controller(wiring.Component):
         m.d.comb += driver.i_words.p.hdr.eq(self.i_stream.p.hdr)
         m.d.comb += driver.i_words.p.data.eq(self.i_stream.p.data)
 
+        failed = Signal()
+        is_abort = ((self.i_stream.p.hdr.ap_ndp == 0) & (self.i_stream.p.hdr.r_nw == 0) &
+                    (self.i_stream.p.hdr.addr == 0))
+        is_status = ((self.i_stream.p.hdr.ap_ndp == 0) & (self.i_stream.p.hdr.r_nw == 1) &
+                     ((self.i_stream.p.hdr.addr == 0) | (self.i_stream.p.hdr.addr == 4)))
+
+        def fail():
+            if self._sticky:
+                m.d.sync += failed.eq(1)
+
         with m.FSM():
             wait_count = Signal.like(self.timeout, init=0)
 
             with m.State("Command"):
                 with m.If(self.i_stream.valid):
-                    m.d.comb += driver.i_words.valid.eq(1)
                     with m.If(self.i_stream.p.cmd == Command.Sequence):
+                        m.d.comb += driver.i_words.valid.eq(1)
                         m.d.comb += driver.i_words.p.type.eq(Request.Sequence)
                         m.d.comb += self.i_stream.ready.eq(driver.i_words.ready)
+                        with m.If(driver.i_words.ready):
+                            m.d.sync += failed.eq(0)
+                    with m.Elif(failed & ~is_abort & ~is_status):
+                        m.d.sync += self.o_stream.p.rsp.eq(Response.Skipped)
+                        m.d.sync += self.o_stream.p.ack.eq(0)
+                        m.next = "Response"
                     with m.Else():
+                        m.d.comb += driver.i_words.valid.eq(1)
                         m.d.comb += driver.i_words.p.type.eq(Request.Header)
                         with m.If(driver.i_words.ready):
                             m.next = "Ack Check"
@@ -300,23 +325,29 @@ class Controller(wiring.Component):
                 m.d.comb += o_buffer.o.ready.eq(1)
                 with m.If(o_buffer.o.valid):
                     with m.If(o_buffer.o.p.type == Result.Error):
+                        fail()
                         m.next = "Response"
                     with m.Elif((o_buffer.o.p.type == Result.Ack) &
                               (o_buffer.o.p.ack == Ack.WAIT)):
                         m.next = "Wait Retry"
                     with m.Elif((o_buffer.o.p.type == Result.Ack) &
                               (o_buffer.o.p.ack == Ack.FAULT)):
+                        fail()
                         m.next = "Fault Response"
-                    with m.Elif(self.i_stream.p.hdr.r_nw):
-                        m.next = "Read Data (Request)"
                     with m.Else():
-                        m.next = "Write Data"
+                        with m.If(is_abort):
+                            m.d.sync += failed.eq(0)
+                        with m.If(self.i_stream.p.hdr.r_nw):
+                            m.next = "Read Data (Request)"
+                        with m.Else():
+                            m.next = "Write Data"
 
             with m.State("Wait Retry"):
                 m.d.comb += driver.i_words.p.type.eq(Request.NoData)
                 m.d.comb += driver.i_words.valid.eq(1)
                 with m.If(driver.i_words.ready):
                     with m.If(wait_count == self.timeout):
+                        fail()
                         m.next = "Response" # timed out, reply with WAIT
                     with m.Else():
                         m.d.sync += wait_count.eq(wait_count + 1)
@@ -348,6 +379,8 @@ class Controller(wiring.Component):
                 m.d.sync += self.o_stream.p.data.eq(o_buffer.o.p.data)
                 m.d.comb += o_buffer.o.ready.eq(1)
                 with m.If(o_buffer.o.valid):
+                    with m.If(o_buffer.o.p.type == Result.Error):
+                        fail()
                     m.next = "Response"
 
             with m.State("Response"):
@@ -15,7 +15,7 @@ from ..support.logging import dump_hex
 from ..support.task_queue import TaskQueue
 from ..support.chunked_fifo import ChunkedFIFO
 from ..gateware.i2c import I2CTarget
-from ..gateware.registers import I2CRegisters
+from ..gateware.registers import I2CRegisters, StreamRegisters
 from ..gateware.fx2_crossbar import FX2Crossbar
 from ..gateware.stream import Queue
 from ..abstract import *
@@ -75,15 +75,24 @@ _max_packets_per_ep = 4096
 # a read of dozens of megabytes, this can take seconds.
 #
 # To try and balance these effects, we choose a medium buffer size that should work well with most
-# applications. It's possible that this will need to become customizable later, but for now
-# a single fixed value works.
+# applications by default. Applets that need low latency (or that know their data rate well) can
+# override it per pipe via `PipeTuning`.
 _packets_per_xfer = 128
 
-# Queue as many transfers as we can, but no more than 16, as the returns beyond that point
+# Queue as many transfers as we can, but no more than 32, as the returns beyond that point
 # are diminishing.
 _xfers_per_queue = min(32, _max_packets_per_ep // _packets_per_xfer)
 
 
+def _tuning_parameters(tuning):
+    tuning = PipeTuning.cast(tuning)
+    packets_per_xfer = min(_max_packets_per_ep,
+        _packets_per_xfer if tuning.packets_per_xfer is None else tuning.packets_per_xfer)
+    xfers_per_queue  = min(_max_packets_per_ep // packets_per_xfer,
+        _xfers_per_queue if tuning.xfers_per_queue is None else tuning.xfers_per_queue)
+    return packets_per_xfer, xfers_per_queue, tuning.adaptive
+
+
 class HardwareRORegister(AbstractRORegister):
     def __init__(self, logger, parent, address, *, shape=None, name=None):
         self._logger  = logger
@@ -94,7 +103,7 @@ class HardwareRORegister(AbstractRORegister):
         self._width   = (Shape.cast(self._shape).width + 7) // 8
 
     async def get(self):
-        value = await self._parent.device.read_register(self._address, self._width)
+        value = await self._parent._read_register(self._address, self._width)
         if isinstance(self._shape, ShapeCastable):
             value = self._shape.from_bits(value)
         return value
@@ -108,11 +117,11 @@ class HardwareRWRegister(HardwareRORegister, AbstractRWRegister):
     async def set(self, value):
         if isinstance(self._shape, ShapeCastable):
             value = Const.cast(self._shape.const(value)).value
-        await self._parent.device.write_register(self._address, value, self._width)
+        await self._parent._write_register(self._address, value, self._width)
 
 
 class HardwareInPipe(AbstractInPipe):
-    def __init__(self, logger, parent, *, buffer_size=None):
+    def __init__(self, logger, parent, *, buffer_size=None, tuning=None):
         self._logger            = logger
         self._parent            = parent
 
@@ -120,6 +129,9 @@ class HardwareInPipe(AbstractInPipe):
         self._in_ep_address     = None
         self._in_packet_size    = None
 
+        self._in_packets_per_xfer, self._in_xfers_per_queue, self._in_adaptive = \
+            _tuning_parameters(tuning)
+
         self._in_running        = False
         self._in_buffer_size    = buffer_size
         self._in_pushback       = asyncio.Condition()
@@ -132,8 +144,9 @@ class HardwareInPipe(AbstractInPipe):
         self._logger.trace(f"IN pipe {self._in_interface}: starting")
         self._parent.device.usb_handle.claimInterface(self._in_interface)
         self._parent.device.usb_handle.setInterfaceAltSetting(self._in_interface, 1)
-        for _ in range(_xfers_per_queue):
-            self._in_tasks.submit(self._in_task())
+        xfer_packets = 1 if self._in_adaptive else self._in_packets_per_xfer
+        for _ in range(self._in_xfers_per_queue):
+            self._in_tasks.submit(self._in_task(xfer_packets))
         self._in_running = True
 
     async def _stop(self):
@@ -146,27 +159,35 @@ class HardwareInPipe(AbstractInPipe):
         self._parent.device.usb_handle.releaseInterface(self._in_interface)
         self._in_running = False
 
-    async def _in_task(self):
+    async def _in_task(self, xfer_packets):
         if self._in_buffer_size is not None:
             async with self._in_pushback:
                 while len(self._in_buffer) > self._in_buffer_size:
                     self._logger.trace(f"IN pipe {self._in_interface}: read pushback")
                     await self._in_pushback.wait()
 
-        size = self._in_packet_size * _packets_per_xfer
+        size = self._in_packet_size * xfer_packets
         data = await self._parent.device.bulk_read(self._in_ep_address, size)
         self._in_buffer.write(data)
 
-        self._in_tasks.submit(self._in_task())
+        if self._in_adaptive:
+            # A transfer that came back full means the device has more data ready than we asked
+            # for, so larger transfers will reduce overhead; a transfer that came back mostly empty
+            # means the device is producing data slowly, so smaller transfers will reduce latency.
+            # Each of the queued transfers tracks its own size, so that transfers completing
+            # concurrently do not race to resize each other.
+            if len(data) == size:
+                xfer_packets = min(xfer_packets * 2, self._in_packets_per_xfer)
+            elif len(data) < size // 2:
+                xfer_packets = max(xfer_packets // 2, 1)
+
+        self._in_tasks.submit(self._in_task(xfer_packets))
 
     @property
     def readable(self) -> int:
         return len(self._in_buffer)
 
-    async def recv(self, length):
-        assert length > 0
-
-        # Return exactly the requested length.
+    async def _in_wait(self, length):
         while len(self._in_buffer) < length:
             self._logger.trace(f"IN pipe {self._in_interface}: need %d bytes",
                 length - len(self._in_buffer))
@@ -174,6 +195,12 @@ class HardwareInPipe(AbstractInPipe):
             assert self._in_tasks
             await self._in_tasks.wait_one()
 
+    async def recv(self, length):
+        assert length > 0
+
+        # Return exactly the requested length.
+        await self._in_wait(length)
+
         async with self._in_pushback:
             result = self._in_buffer.read(length)
             self._in_pushback.notify_all()
@@ -193,6 +220,22 @@ class HardwareInPipe(AbstractInPipe):
         self._logger.trace(f"IN pipe {self._in_interface}: read <%s>", dump_hex(result))
         return result
 
+    async def recv_into(self, buffer):
+        buffer = memoryview(buffer).cast("B")
+        assert len(buffer) > 0
+
+        # Fill exactly the entire buffer. Unlike `recv`, this never joins chunks together, so
+        # large reads spanning many transfers are copied only once, directly into `buffer`.
+        await self._in_wait(len(buffer))
+
+        async with self._in_pushback:
+            length = self._in_buffer.read_into(buffer)
+            self._in_pushback.notify_all()
+        assert length == len(buffer)
+
+        self._logger.trace(f"IN pipe {self._in_interface}: read <%s>", dump_hex(buffer))
+        return length
+
     async def reset(self):
         self._logger.trace(f"IN pipe {self._in_interface}: reset")
         await self._stop()
@@ -212,7 +255,7 @@ class HardwareInPipe(AbstractInPipe):
 
 
 class HardwareOutPipe(AbstractOutPipe):
-    def __init__(self, logger, parent, *, buffer_size=None):
+    def __init__(self, logger, parent, *, buffer_size=None, tuning=None):
         self._logger            = logger
         self._parent            = parent
 
@@ -220,6 +263,9 @@ class HardwareOutPipe(AbstractOutPipe):
         self._out_ep_address    = None
         self._out_packet_size   = None
 
+        # Adaptive tuning only applies to IN transfers; OUT transfers are sized by `send`.
+        self._out_packets_per_xfer, self._out_xfers_per_queue, _ = _tuning_parameters(tuning)
+
         self._out_running       = False
         self._out_buffer_size   = buffer_size
         self._out_inflight      = 0
@@ -246,7 +292,7 @@ class HardwareOutPipe(AbstractOutPipe):
 
     def _out_slice(self):
         # Fast path: read as much contiguous data as possible, up to our transfer size.
-        size = self._out_packet_size * _packets_per_xfer
+        size = self._out_packet_size * self._out_packets_per_xfer
         data = self._out_buffer.read(size)
 
         if len(data) < self._out_packet_size:
@@ -262,7 +308,7 @@ class HardwareOutPipe(AbstractOutPipe):
 
     @property
     def _out_threshold(self):
-        out_xfer_size = self._out_packet_size * _packets_per_xfer
+        out_xfer_size = self._out_packet_size * self._out_packets_per_xfer
         if self._out_buffer_size is None:
             return out_xfer_size
         else:
@@ -323,7 +369,7 @@ class HardwareOutPipe(AbstractOutPipe):
         # This provides predictable write behavior; only _packets_per_xfer packet writes are
         # automatically submitted, and only the minimum necessary number of tasks are scheduled on
         # calls to `write`.
-        while len(self._out_tasks) < _xfers_per_queue and \
+        while len(self._out_tasks) < self._out_xfers_per_queue and \
                     len(self._out_buffer) >= self._out_threshold:
             self._out_tasks.submit(self._out_task(self._out_slice()))
 
@@ -334,16 +380,16 @@ class HardwareOutPipe(AbstractOutPipe):
 
         # First, we ensure we can submit one more task. (There can be more tasks than
         # _xfers_per_queue because a task may spawn another one just before it terminates.)
-        if len(self._out_tasks) >= _xfers_per_queue:
+        if len(self._out_tasks) >= self._out_xfers_per_queue:
             self._out_stalls += 1
-        while len(self._out_tasks) >= _xfers_per_queue:
+        while len(self._out_tasks) >= self._out_xfers_per_queue:
             await self._out_tasks.wait_one()
 
         # At this point, the buffer can contain at most _packets_per_xfer packets worth
         # of data, as anything beyond that crosses the threshold of automatic submission.
         # So, we can simply submit the rest of data, which by definition fits into a single
         # transfer.
-        assert len(self._out_buffer) <= self._out_packet_size * _packets_per_xfer
+        assert len(self._out_buffer) <= self._out_packet_size * self._out_packets_per_xfer
         if self._out_buffer:
             data = bytearray()
             while self._out_buffer:
@@ -377,9 +423,12 @@ class HardwareOutPipe(AbstractOutPipe):
 
 
 class HardwareInOutPipe(HardwareInPipe, HardwareOutPipe, AbstractInOutPipe):
-    def __init__(self, logger, parent, *, in_buffer_size, out_buffer_size):
-        HardwareInPipe.__init__(self, logger, parent, buffer_size=in_buffer_size)
-        HardwareOutPipe.__init__(self, logger, parent, buffer_size=out_buffer_size)
+    def __init__(self, logger, parent, *, in_buffer_size, out_buffer_size,
+                 in_tuning=None, out_tuning=None):
+        HardwareInPipe.__init__(self, logger, parent, buffer_size=in_buffer_size,
+                                tuning=in_tuning)
+        HardwareOutPipe.__init__(self, logger, parent, buffer_size=out_buffer_size,
+                                 tuning=out_tuning)
 
     def statistics(self):
         HardwareInPipe.statistics(self)
@@ -444,6 +493,10 @@ class HardwareAssembly(AbstractAssembly):
         self._resets        = [] # (signal, when)
         self._voltages      = {} # {port: vio}
         self._pulls         = {} # {(port, number): state}
+        self._reg_stream    = None # StreamRegisters
+        self._reg_pipe      = None # HardwareInOutPipe
+        self._reg_pipe_idx  = None # (in_stream_idx, out_stream_idx)
+        self._reg_lock      = asyncio.Lock()
 
         self._logger        = logger
         self._applet        = None
@@ -511,32 +564,85 @@ class HardwareAssembly(AbstractAssembly):
         return register
 
     def add_in_pipe(self, in_stream, *, in_flush=C(1),
-                    fifo_depth=None, buffer_size=None) -> AbstractInPipe:
+                    fifo_depth=None, buffer_size=None, tuning=None) -> AbstractInPipe:
         assert self._artifact is None, "cannot add a pipe to a sealed assembly"
-        in_pipe = HardwareInPipe(self._logger, self, buffer_size=buffer_size)
+        in_pipe = HardwareInPipe(self._logger, self, buffer_size=buffer_size, tuning=tuning)
         self._in_streams.append((self._domain, in_stream, in_flush, fifo_depth))
         self._pipes.append(in_pipe)
         return in_pipe
 
     def add_out_pipe(self, out_stream, *,
-                     fifo_depth=None, buffer_size=None) -> AbstractOutPipe:
+                     fifo_depth=None, buffer_size=None, tuning=None) -> AbstractOutPipe:
         assert self._artifact is None, "cannot add a pipe to a sealed assembly"
-        out_pipe = HardwareOutPipe(self._logger, self, buffer_size=buffer_size)
+        out_pipe = HardwareOutPipe(self._logger, self, buffer_size=buffer_size, tuning=tuning)
         self._out_streams.append((self._domain, out_stream, fifo_depth))
         self._pipes.append(out_pipe)
         return out_pipe
 
     def add_inout_pipe(self, in_stream, out_stream, *, in_flush=C(1),
-                       in_fifo_depth=None, in_buffer_size=None,
-                       out_fifo_depth=None, out_buffer_size=None) -> AbstractInOutPipe:
+                       in_fifo_depth=None, in_buffer_size=None, in_tuning=None,
+                       out_fifo_depth=None, out_buffer_size=None, out_tuning=None
+                       ) -> AbstractInOutPipe:
         assert self._artifact is None, "cannot add a pipe to a sealed assembly"
         inout_pipe = HardwareInOutPipe(self._logger, self,
-            in_buffer_size=in_buffer_size, out_buffer_size=out_buffer_size)
+            in_buffer_size=in_buffer_size, out_buffer_size=out_buffer_size,
+            in_tuning=in_tuning, out_tuning=out_tuning)
         self._in_streams.append((self._domain, in_stream, in_flush, in_fifo_depth))
         self._out_streams.append((self._domain, out_stream, out_fifo_depth))
         self._pipes.append(inout_pipe)
         return inout_pipe
 
+    def use_pipe_registers(self):
+        """Access registers over a dedicated pair of FIFO pipes instead of the I2C bus.
+
+        Register accesses over I2C are relayed by the FX2 firmware and take on the order of
+        a millisecond each. Register accesses over pipes take about as long as a USB bulk transfer
+        round trip, which helps applets that perform register handshakes in a loop. The register
+        channel uses up one IN and one OUT endpoint, so it is only available to assemblies with
+        at most one other pipe in each direction.
+        """
+        assert self._artifact is None, "cannot add a pipe to a sealed assembly"
+        if self._reg_pipe is not None:
+            return
+        self._reg_stream = StreamRegisters()
+        self._reg_pipe = HardwareInOutPipe(self._logger, self,
+            in_buffer_size=None, out_buffer_size=None,
+            in_tuning="latency", out_tuning="latency")
+        self._reg_pipe_idx = (len(self._in_streams), len(self._out_streams))
+        self._in_streams.append((None, self._reg_stream.o, C(1), None))
+        self._out_streams.append((None, self._reg_stream.i, None))
+        self._pipes.append(self._reg_pipe)
+
+    async def _exchange_register(self, command, length):
+        # Once a command is sent, its response must be received before the next command is sent,
+        # or the framing of the register pipe is lost. If the task performing the access is
+        # cancelled, finish the exchange in the background, and only then release the lock.
+        async def exchange():
+            try:
+                await self._reg_pipe.send(command)
+                await self._reg_pipe.flush()
+                return await self._reg_pipe.recv(length)
+            finally:
+                self._reg_lock.release()
+        await self._reg_lock.acquire()
+        return await asyncio.shield(asyncio.ensure_future(exchange()))
+
+    async def _read_register(self, address, width):
+        if self._reg_pipe is None:
+            return await self.device.read_register(address, width)
+        value = int.from_bytes(
+            await self._exchange_register(bytes([StreamRegisters.CMD_READ, address]), width),
+            byteorder="little")
+        self._logger.trace("register %d read over pipe: %#04x", address, value)
+        return value
+
+    async def _write_register(self, address, value, width):
+        if self._reg_pipe is None:
+            return await self.device.write_register(address, value, width)
+        self._logger.trace("register %d write over pipe: %#04x", address, value)
+        await self._exchange_register(bytes([StreamRegisters.CMD_WRITE, address]) +
+                                      value.to_bytes(width, byteorder="little"), 1)
+
     def use_voltage(self, ports: Mapping[GlasgowPort, GlasgowVio | float]):
         for port, vio in ports.items():
             port = GlasgowPort(port)
@@ -602,11 +708,23 @@ class HardwareAssembly(AbstractAssembly):
             else:
                 m.submodules[name] = DomainRenamer(domain.name)(elaboratable)
 
+        if self._reg_stream is not None:
+            assert len(self._in_streams) <= 2 and len(self._out_streams) <= 2, \
+                "pipe register channel requires at most one other pipe in each direction"
+            # applet registers are moved to the pipe register channel, but keep their addresses
+            m.submodules.stream_registers = registers = self._reg_stream
+            reg_in_idx, reg_out_idx = self._reg_pipe_idx
+            m.d.comb += registers.reset.eq(pipe_rst[2 + reg_in_idx] | pipe_rst[reg_out_idx])
+            registers.add_existing_ro(C(0xa5, 8))
+            registers.add_existing_ro(C(0, 4))
+        else:
+            registers = i2c_registers
+
         for register, signal, domain in self._registers:
             if isinstance(register, HardwareRWRegister):
-                register_addr = i2c_registers.add_existing_rw(Value.cast(signal), domain=domain)
+                register_addr = registers.add_existing_rw(Value.cast(signal), domain=domain)
             elif isinstance(register, HardwareRORegister):
-                register_addr = i2c_registers.add_existing_ro(Value.cast(signal))
+                register_addr = registers.add_existing_ro(Value.cast(signal))
             assert register_addr == register._address
 
         m.submodules.fx2_crossbar = fx2_crossbar = FX2Crossbar(fx2_pins)
@@ -1,11 +1,15 @@
 from typing import Optional, BinaryIO
 import os
+import re
 import logging
 import hashlib
 import pathlib
 import tempfile
 import shutil
+import threading
+import contextlib
 import subprocess
+import concurrent.futures
 
 import platformdirs
 from amaranth.build.run import BuildPlan
@@ -23,6 +27,46 @@ class GatewareBuildError(Exception):
     pass
 
 
+def _timing_margin(stdout_data: bytes) -> Optional[float]:
+    # nextpnr reports achieved Fmax for each clock after placement and again after routing; only
+    # the last report for each clock (the post-route one) is used. The margin of the design is
+    # that of its worst clock, as a ratio of achieved to constrained frequency.
+    clocks = {}
+    for name, achieved, target in re.findall(
+            rb"Max frequency for clock\s+'([^']+)': ([\d.]+) MHz \((?:PASS|FAIL) at ([\d.]+) MHz\)",
+            stdout_data):
+        clocks[name] = float(achieved) / float(target)
+    if clocks:
+        return min(clocks.values())
+
+
+def _split_script(script: str) -> tuple[str, str]:
+    # the build script runs synthesis, then place and route, then packing, one command per line;
+    # split it into a script that only runs synthesis, and a script that runs everything except
+    # synthesis, so that the result of synthesis can be placed and routed with several seeds
+    lines = script.splitlines(keepends=True)
+    for index, line in enumerate(lines):
+        if re.search(r"--log \S+\.tim", line):
+            break
+    else:
+        raise GatewareBuildError("cannot find nextpnr invocation in the build script")
+    synth_script = "".join(lines[:index])
+    pnr_script = "".join(line for line in lines if not re.search(r"\s\S+\.ys\b", line))
+    if synth_script.count(".ys") != 1 or ".ys" in pnr_script:
+        raise GatewareBuildError("cannot find yosys invocation in the build script")
+    return synth_script, pnr_script
+
+
+def _set_seed(script: str, seed: int) -> str:
+    # the nextpnr options are a part of the build plan, and adding the seed there would change
+    # the bitstream ID, even though the seed only affects placement. instead, patch it into
+    # the build script after extracting it
+    script, count = re.subn(r"(--log \S+\.tim)", rf"--seed {seed} \1", script, count=1)
+    if count != 1:
+        raise GatewareBuildError("cannot find nextpnr invocation in the build script")
+    return script
+
+
 class GlasgowBuildPlan:
     def __init__(self, inner: BuildPlan, toolchain: Toolchain):
         self._inner     = inner
@@ -59,43 +103,8 @@ class GlasgowBuildPlan:
             # copied from `BuildPlan.execute_local`, which was inlined into this function because
             # Glasgow has unique (caching) needs. see the comment in that function for details.
             self._inner.extract(build_dir)
-            if os.name == 'nt':
-                args = ["cmd", "/c", f"call {self._inner.script}.bat"]
-            else:
-                args = ["sh", f"{self._inner.script}.sh"]
-
-            environ = self._toolchain.env_vars
-            if os.name == 'nt':
-                # Windows has some environment variables that are required by the OS runtime:
-                # - SYSTEMROOT: required for child Python processes to initialize properly
-                # - PROCESSOR_ARCHITECTURE: required for YoWASP (used by wasmtime)
-                for var in ("PROCESSOR_ARCHITECTURE", "SYSTEMROOT"):
-                    environ[var] = os.environ[var]
-
-            # collect stdout (so that it can be reproduced if a log for a cached bitstream is
-            # requested later) and also log it with the appropriate level
-            stdout_lines = []
-            with subprocess.Popen(
-                    args, cwd=build_dir, env=environ, text=True,
-                    stdout=subprocess.PIPE, stderr=subprocess.STDOUT) as proc:
-                for stdout_line in proc.stdout:
-                    stdout_lines.append(stdout_line)
-                    logger.trace(f"build: %s", stdout_line.rstrip())
-                if proc.wait():
-                    if not logger.isEnabledFor(logging.TRACE): # don't print the log twice
-                        for stdout_line in stdout_lines:
-                            logger.info(f"build: %s", stdout_line.rstrip())
-                    if logger.isEnabledFor(logging.INFO):
-                        raise GatewareBuildError(
-                            f"gateware build failed with exit code {proc.returncode}; "
-                            f"see build log above for details")
-                    else:
-                        raise GatewareBuildError(
-                            f"gateware build failed with exit code {proc.returncode}; "
-                            f"re-run `glasgow` without `-q` to view build log")
-
+            stdout_data = self._run(build_dir, self._inner.script)
             bitstream_data = (pathlib.Path(build_dir) / "top.bin").read_bytes()
-            stdout_data = "".join(stdout_lines).encode()
         except:
             if debug:
                 logger.info("keeping build tree as %s", build_dir)
@@ -105,29 +114,151 @@ class GlasgowBuildPlan:
                 shutil.rmtree(build_dir)
         return bitstream_data, stdout_data
 
-    def get_bitstream(self, *, debug=False) -> bytes:
+    def _run(self, build_dir: os.PathLike, script: str, *,
+             slots: Optional[threading.Semaphore] = None) -> bytes:
+        if os.name == 'nt':
+            args = ["cmd", "/c", f"call {script}.bat"]
+        else:
+            args = ["sh", f"{script}.sh"]
+
+        environ = self._toolchain.env_vars
+        if os.name == 'nt':
+            # Windows has some environment variables that are required by the OS runtime:
+            # - SYSTEMROOT: required for child Python processes to initialize properly
+            # - PROCESSOR_ARCHITECTURE: required for YoWASP (used by wasmtime)
+            for var in ("PROCESSOR_ARCHITECTURE", "SYSTEMROOT"):
+                environ[var] = os.environ[var]
+
+        # collect stdout (so that it can be reproduced if a log for a cached bitstream is
+        # requested later) and also log it with the appropriate level
+        stdout_lines = []
+        with slots or contextlib.nullcontext(), subprocess.Popen(
+                args, cwd=build_dir, env=environ, text=True,
+                stdout=subprocess.PIPE, stderr=subprocess.STDOUT) as proc:
+            for stdout_line in proc.stdout:
+                stdout_lines.append(stdout_line)
+                logger.trace(f"build: %s", stdout_line.rstrip())
+            if proc.wait():
+                if not logger.isEnabledFor(logging.TRACE): # don't print the log twice
+                    for stdout_line in stdout_lines:
+                        logger.info(f"build: %s", stdout_line.rstrip())
+                if logger.isEnabledFor(logging.INFO):
+                    raise GatewareBuildError(
+                        f"gateware build failed with exit code {proc.returncode}; "
+                        f"see build log above for details")
+                else:
+                    raise GatewareBuildError(
+                        f"gateware build failed with exit code {proc.returncode}; "
+                        f"re-run `glasgow` without `-q` to view build log")
+        return "".join(stdout_lines).encode()
+
+    def _rewrite_scripts(self, build_dir: os.PathLike, name: str, rewrite):
+        for suffix in (".sh", ".bat"):
+            script_filename = pathlib.Path(build_dir) / f"{self._inner.script}{suffix}"
+            if script_filename.exists():
+                script_filename.with_name(f"{name}{suffix}").write_text(
+                    rewrite(script_filename.read_text()))
+
+    def _execute_seeds(self, seeds: int, *, debug=False,
+                       slots: Optional[threading.Semaphore] = None) -> tuple[bytes, bytes]:
+        # nextpnr placement is randomized, and the achieved Fmax varies significantly between
+        # seeds. synthesis is not, so run it once, then place and route its result with several
+        # seeds at once and keep the one with the most timing margin
+        if slots is None:
+            slots = threading.BoundedSemaphore(os.cpu_count() or 1)
+
+        def place_and_route(seed):
+            seed_dir = tempfile.mkdtemp(prefix="glasgow_")
+            try:
+                shutil.copytree(synth_dir, seed_dir, dirs_exist_ok=True)
+                self._rewrite_scripts(seed_dir, "pnr",
+                    lambda script: _set_seed(_split_script(script)[1], seed))
+                stdout_data = self._run(seed_dir, "pnr", slots=slots)
+                bitstream_data = (pathlib.Path(seed_dir) / "top.bin").read_bytes()
+            except:
+                if debug:
+                    logger.info("keeping build tree for seed %d as %s", seed, seed_dir)
+                raise
+            finally:
+                if not debug:
+                    shutil.rmtree(seed_dir)
+            return bitstream_data, stdout_data
+
+        best_margin, best_result, build_error = None, None, None
+        synth_dir = tempfile.mkdtemp(prefix="glasgow_")
+        try:
+            self._inner.extract(synth_dir)
+            self._rewrite_scripts(synth_dir, "synth", lambda script: _split_script(script)[0])
+            synth_stdout = self._run(synth_dir, "synth", slots=slots)
+
+            with concurrent.futures.ThreadPoolExecutor(max_workers=seeds) as executor:
+                futures = {executor.submit(place_and_route, seed): seed
+                           for seed in range(1, seeds + 1)}
+                for future in concurrent.futures.as_completed(futures):
+                    seed = futures[future]
+                    try:
+                        bitstream_data, stdout_data = future.result()
+                    except GatewareBuildError as error:
+                        logger.info(f"bitstream ID {self.bitstream_id.hex()} seed {seed}: "
+                                    f"failed")
+                        build_error = error
+                        continue
+                    margin = _timing_margin(stdout_data) or 0.0
+                    logger.info(f"bitstream ID {self.bitstream_id.hex()} seed {seed}: "
+                                f"Fmax at {margin * 100:.1f}% of constraint")
+                    if best_margin is None or margin > best_margin:
+                        best_margin, best_result = margin, (bitstream_data, stdout_data)
+        except:
+            if debug:
+                logger.info("keeping synthesis tree as %s", synth_dir)
+            raise
+        finally:
+            if not debug:
+                shutil.rmtree(synth_dir)
+        if best_result is None:
+            raise build_error
+        logger.info(f"bitstream ID {self.bitstream_id.hex()}: using best seed, with Fmax at "
+                    f"{best_margin * 100:.1f}% of constraint")
+        bitstream_data, stdout_data = best_result
+        return bitstream_data, synth_stdout + stdout_data
+
+    def _cache_filenames(self) -> tuple[pathlib.Path, pathlib.Path]:
         # locate the caches in the platform-appropriate cache directory; bitstreams aren't large,
         # but it is good etiquette to indicate to the OS that they can be wiped without concern
         cache_path = platformdirs.user_cache_path("GlasgowEmbedded", appauthor=False)
         bitstream_filename = cache_path / "bitstreams" / self.bitstream_id.hex()
         stdout_filename = bitstream_filename.with_suffix(".output")
+        return bitstream_filename, stdout_filename
+
+    def _read_cache(self) -> Optional[tuple[bytes, bytes]]:
+        bitstream_filename, stdout_filename = self._cache_filenames()
         # ensure that the cache and the build log (a) exist, (b) aren't corrupted; if anything goes
         # wrong at this stage, proceed as-if the cache was never there
-        cache_exists = (bitstream_filename.exists() and stdout_filename.exists())
-        if cache_exists:
-            with bitstream_filename.open("rb") as bitstream_file:
-                bitstream_hash = bitstream_file.read(hashlib.blake2s().digest_size)
-                bitstream_data = bitstream_file.read()
-                if hashlib.blake2s(bitstream_data).digest() != bitstream_hash:
-                    cache_exists = False
-            with stdout_filename.open("rb") as stdout_file:
-                stdout_hash = stdout_file.read(hashlib.blake2s().digest_size * 2 + 1)
-                stdout_data = stdout_file.read()
-                if hashlib.blake2s(stdout_data).hexdigest().encode() != stdout_hash.rstrip():
-                    cache_exists = False
-        if cache_exists:
+        if not (bitstream_filename.exists() and stdout_filename.exists()):
+            return None
+        with bitstream_filename.open("rb") as bitstream_file:
+            bitstream_hash = bitstream_file.read(hashlib.blake2s().digest_size)
+            bitstream_data = bitstream_file.read()
+            if hashlib.blake2s(bitstream_data).digest() != bitstream_hash:
+                return None
+        with stdout_filename.open("rb") as stdout_file:
+            stdout_hash = stdout_file.read(hashlib.blake2s().digest_size * 2 + 1)
+            stdout_data = stdout_file.read()
+            if hashlib.blake2s(stdout_data).hexdigest().encode() != stdout_hash.rstrip():
+                return None
+        return bitstream_data, stdout_data
+
+    @property
+    def is_cached(self) -> bool:
+        return self._read_cache() is not None
+
+    def get_bitstream(self, *, debug=False, seeds=1,
+                      slots: Optional[threading.Semaphore] = None) -> bytes:
+        bitstream_filename, stdout_filename = self._cache_filenames()
+        if (cached := self._read_cache()) is not None:
             # the cache exists; skip building the bitstream, and reproduce the stdout to our log
             # if anyone would actually see it
+            bitstream_data, stdout_data = cached
             logger.debug(f"bitstream ID {self.bitstream_id.hex()} is cached")
             logger.trace(f"bitstream was read from {str(bitstream_filename)!r}")
             if logger.isEnabledFor(logging.TRACE):
@@ -138,7 +269,11 @@ class GlasgowBuildPlan:
             # don't have to forward it here) and write the artifacts to the platform-appropriate
             # cache directory
             logger.debug(f"bitstream ID {self.bitstream_id.hex()} is not cached, executing build")
-            bitstream_data, stdout_data = self.execute(debug=debug)
+            if seeds > 1:
+                bitstream_data, stdout_data = self._execute_seeds(seeds, debug=debug,
+                                                                  slots=slots)
+            else:
+                bitstream_data, stdout_data = self.execute(debug=debug)
             bitstream_hash = hashlib.blake2s(bitstream_data).digest()
             stdout_hash = hashlib.blake2s(stdout_data).hexdigest().encode()
             bitstream_filename.parent.mkdir(parents=True, exist_ok=True)
@@ -0,0 +1,453 @@
+import os
+import json
+import struct
+import asyncio
+import logging
+
+import platformdirs
+import usb1
+
+from ..support.logging import dump_hex
+from .device import GlasgowDevice, GlasgowDeviceError
+
+
+__all__ = ["default_socket_path", "DeviceDaemon", "DaemonDevice"]
+
+
+logger = logging.getLogger(__name__)
+
+
+# The daemon protocol is private to this module, and the client and the server are always the same
+# version of the software. Each message is a JSON header followed by an optional binary payload,
+# both prefixed with their lengths. Requests carry an `id`, which is echoed in the response.
+#
+# Transfers are performed concurrently, and may complete in any order. Configuration requests
+# (claiming or releasing an interface, selecting an alternate setting or a configuration) are
+# performed in order with respect to transfers requested after them, and to transfers cancelled
+# before them: the daemon waits for the latter to finish first. Other transfers requested before
+# a configuration request are not waited for, since e.g. a read from an idle pipe may never
+# complete; a client must complete or cancel the transfers on an interface before reconfiguring it.
+_FRAME = struct.Struct("<II")
+
+
+def default_socket_path():
+    """Path of the Unix socket the device daemon listens on by default."""
+    return platformdirs.user_runtime_path("GlasgowEmbedded", appauthor=False) / "daemon.sock"
+
+
+async def _read_message(reader):
+    header_length, payload_length = _FRAME.unpack(await reader.readexactly(_FRAME.size))
+    header  = json.loads(await reader.readexactly(header_length))
+    payload = await reader.readexactly(payload_length) if payload_length else b""
+    return header, payload
+
+
+def _write_message(writer, header, payload=b""):
+    header = json.dumps(header).encode()
+    writer.write(_FRAME.pack(len(header), len(payload)) + header)
+    if payload:
+        writer.write(payload)
+
+
+def _describe_configurations(usb_device):
+    return [
+        {
+            "value": config.getConfigurationValue(),
+            "interfaces": [
+                [
+                    {
+                        "number": setting.getNumber(),
+                        "endpoints": [
+                            [endpoint.getAddress(), endpoint.getMaxPacketSize()]
+                            for endpoint in setting.iterEndpoints()
+                        ]
+                    }
+                    for setting in interface.iterSettings()
+                ]
+                for interface in config.iterInterfaces()
+            ]
+        }
+        for config in usb_device.iterConfigurations()
+    ]
+
+
+class DeviceDaemon:
+    """
+    Resident process that keeps devices open on behalf of :class:`DaemonDevice` clients.
+
+    Opening a device involves enumerating the bus, possibly uploading the firmware and waiting for
+    the device to re-enumerate, and (when an applet is run) checking or loading the bitstream.
+    The daemon does all of this once, and then keeps the device open, so that each subsequent
+    session starts immediately, with the bitstream from the previous session still loaded if it
+    matches.
+
+    Only one session may use a device at a time; other sessions wait until it is released.
+    """
+    def __init__(self, socket_path=None):
+        self._socket_path = socket_path or default_socket_path()
+        self._devices     = {} # {serial: GlasgowDevice}
+        self._locks       = {} # {serial: asyncio.Lock}
+        self._sessions    = set() # {asyncio.Task}
+        self._server      = None
+
+    async def listen(self):
+        """Start listening for sessions; fails if another daemon is already running."""
+        path = self._socket_path
+        path.parent.mkdir(parents=True, exist_ok=True)
+        if path.exists():
+            try:
+                _reader, writer = await asyncio.open_unix_connection(path)
+            except (ConnectionRefusedError, FileNotFoundError):
+                path.unlink() # stale socket from a daemon that did not exit cleanly
+            else:
+                writer.close()
+                raise GlasgowDeviceError(f"device daemon is already running at {path}")
+
+        self._server = await asyncio.start_unix_server(self._serve_session, path)
+        os.chmod(path, 0o600)
+        logger.info("listening at %s", path)
+
+    async def serve(self):
+        """Serve sessions until cancelled, then close all devices."""
+        if self._server is None:
+            await self.listen()
+        try:
+            async with self._server:
+                await self._server.serve_forever()
+        finally:
+            # Sessions must finish cancelling their transfers before the devices are closed.
+            for session in self._sessions:
+                session.cancel()
+            await asyncio.gather(*self._sessions, return_exceptions=True)
+            for device in self._devices.values():
+                device.close()
+            self._devices.clear()
+            self._socket_path.unlink(missing_ok=True)
+
+    def _open(self, serial):
+        if serial is None and len(self._devices) == 1:
+            return next(iter(self._devices.values()))
+        if serial in self._devices:
+            return self._devices[serial]
+        device = GlasgowDevice(serial)
+        self._devices[device.serial] = device
+        logger.info("opened device with serial %s", device.serial)
+        return device
+
+    def _forget(self, device):
+        if self._devices.get(device.serial) is device:
+            logger.info("closing device with serial %s", device.serial)
+            del self._devices[device.serial]
+            device.close()
+
+    async def _serve_session(self, reader, writer):
+        self._sessions.add(session := asyncio.current_task())
+        try:
+            request, _payload = await _read_message(reader)
+            try:
+                device = self._open(request["serial"])
+            except GlasgowDeviceError as exn:
+                _write_message(writer, {"error": str(exn)})
+                return
+
+            lock = self._locks.setdefault(device.serial, asyncio.Lock())
+            if lock.locked():
+                logger.info("device with serial %s is busy; session waiting", device.serial)
+            async with lock:
+                await self._run_session(device, reader, writer)
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        except asyncio.CancelledError:
+            pass # daemon is shutting down
+        finally:
+            self._sessions.discard(session)
+            writer.close()
+
+    async def _run_session(self, device, reader, writer):
+        logger.debug("session started on device with serial %s", device.serial)
+        _write_message(writer, {
+            "serial":            device.serial,
+            "revision":          device.revision,
+            "modified_design":   device.modified_design,
+            "firmware_revision": device.firmware_revision,
+            "configuration":     device.usb_handle.getConfiguration(),
+            "configurations":    _describe_configurations(device.usb_handle.getDevice()),
+        })
+
+        transfers = {} # {id: asyncio.Task}
+        cancelled = set() # {asyncio.Task}
+        claimed   = set()
+        try:
+            while True:
+                try:
+                    request, payload = await _read_message(reader)
+                except (asyncio.IncompleteReadError, ConnectionError):
+                    break
+
+                match request["op"]:
+                    case "cancel":
+                        if (task := transfers.get(request["target"])) is not None:
+                            task.cancel()
+                            cancelled.add(task)
+                            task.add_done_callback(cancelled.discard)
+
+                    case "control_read" | "control_write" | "bulk_read" | "bulk_write":
+                        task = asyncio.create_task(
+                            self._transfer(device, writer, request, payload))
+                        transfers[request["id"]] = task
+                        task.add_done_callback(lambda task, id=request["id"]:
+                            transfers.pop(id, None))
+
+                    # These requests are executed in order with respect to later transfers, since
+                    # the pipes rely on e.g. the interface being claimed before it is used; and
+                    # with respect to cancelled transfers, since the pipes cancel their transfers
+                    # and then immediately release the interface.
+                    case op:
+                        await asyncio.gather(*cancelled, return_exceptions=True)
+                        try:
+                            self._configure(device, claimed, op, request["args"])
+                        except usb1.USBError as exn:
+                            _write_message(writer, {"id": request["id"], "error": str(exn)})
+        finally:
+            for task in transfers.values():
+                task.cancel()
+            await asyncio.gather(*transfers.values(), return_exceptions=True)
+            for interface in claimed:
+                try:
+                    device.usb_handle.setInterfaceAltSetting(interface, 0)
+                    device.usb_handle.releaseInterface(interface)
+                except usb1.USBErrorNoDevice:
+                    self._forget(device)
+                    break
+            logger.debug("session ended on device with serial %s", device.serial)
+
+    def _configure(self, device, claimed, op, args):
+        match op:
+            case "claim_interface":
+                device.usb_handle.claimInterface(*args)
+                claimed.add(args[0])
+            case "release_interface":
+                device.usb_handle.releaseInterface(*args)
+                claimed.discard(args[0])
+            case "set_alt_setting":
+                device.usb_handle.setInterfaceAltSetting(*args)
+            case "set_configuration":
+                device.usb_handle.setConfiguration(*args)
+            case _:
+                raise ValueError(f"unknown daemon request {op!r}")
+
+    async def _transfer(self, device, writer, request, payload):
+        response, data = {"id": request["id"]}, b""
+        try:
+            match request["op"]:
+                case "control_read":
+                    data = await device.control_read(*request["args"])
+                case "control_write":
+                    await device.control_write(*request["args"], payload)
+                case "bulk_read":
+                    data = await device.bulk_read(*request["args"])
+                case "bulk_write":
+                    await device.bulk_write(*request["args"], payload)
+        except usb1.USBErrorPipe:
+            response["error"] = "stall"
+        except GlasgowDeviceError as exn:
+            response["error"] = str(exn)
+            if str(exn) == "device disconnected":
+                self._forget(device)
+        except usb1.USBError as exn:
+            response["error"] = str(exn)
+        _write_message(writer, response, data)
+        await writer.drain()
+
+
+class _DaemonEndpoint:
+    def __init__(self, address, max_packet_size):
+        self._address         = address
+        self._max_packet_size = max_packet_size
+
+    def getAddress(self):
+        return self._address
+
+    def getMaxPacketSize(self):
+        return self._max_packet_size
+
+
+class _DaemonSetting:
+    def __init__(self, number, endpoints):
+        self._number    = number
+        self._endpoints = [_DaemonEndpoint(*endpoint) for endpoint in endpoints]
+
+    def getNumber(self):
+        return self._number
+
+    def iterEndpoints(self):
+        return iter(self._endpoints)
+
+
+class _DaemonInterface:
+    def __init__(self, settings):
+        self._settings = [_DaemonSetting(**setting) for setting in settings]
+
+    def iterSettings(self):
+        return iter(self._settings)
+
+
+class _DaemonConfiguration:
+    def __init__(self, value, interfaces):
+        self._value      = value
+        self._interfaces = [_DaemonInterface(interface) for interface in interfaces]
+
+    def getConfigurationValue(self):
+        return self._value
+
+    def iterInterfaces(self):
+        return iter(self._interfaces)
+
+
+class _DaemonUSBDevice:
+    def __init__(self, configurations):
+        self._configurations = [_DaemonConfiguration(**config) for config in configurations]
+
+    def iterConfigurations(self):
+        return iter(self._configurations)
+
+
+class _DaemonHandle:
+    # Implements the subset of the `usb1.USBDeviceHandle` interface used by `HardwareAssembly`
+    # and the pipes. The requests are not acknowledged; if one fails, the next transfer does.
+    def __init__(self, device, configuration, configurations):
+        self._device        = device
+        self._configuration = configuration
+        self._usb_device    = _DaemonUSBDevice(configurations)
+
+    def claimInterface(self, interface):
+        self._device._notify("claim_interface", interface)
+
+    def releaseInterface(self, interface):
+        self._device._notify("release_interface", interface)
+
+    def setInterfaceAltSetting(self, interface, alt_setting):
+        self._device._notify("set_alt_setting", interface, alt_setting)
+
+    def setConfiguration(self, configuration):
+        self._device._notify("set_configuration", configuration)
+        self._configuration = configuration
+
+    def getConfiguration(self):
+        return self._configuration
+
+    def getDevice(self):
+        return self._usb_device
+
+
+class DaemonDevice(GlasgowDevice):
+    """
+    A Glasgow device opened through a :class:`DeviceDaemon`.
+
+    Implements the same interface as :class:`GlasgowDevice`, with every transfer forwarded to
+    the daemon. Use :meth:`connect` to create an instance.
+    """
+    @classmethod
+    async def connect(cls, serial=None, *, socket_path=None):
+        socket_path = socket_path or default_socket_path()
+        try:
+            reader, writer = await asyncio.open_unix_connection(socket_path)
+        except (ConnectionRefusedError, FileNotFoundError):
+            raise GlasgowDeviceError(f"device daemon is not running at {socket_path}; "
+                                     f"start it with `glasgow daemon`") from None
+        _write_message(writer, {"serial": serial})
+        try:
+            response, _payload = await _read_message(reader)
+        except asyncio.IncompleteReadError:
+            raise GlasgowDeviceError("device daemon closed the connection") from None
+        if "error" in response:
+            writer.close()
+            raise GlasgowDeviceError(response["error"])
+
+        self = cls.__new__(cls)
+        self.revision           = response["revision"]
+        self.usb_handle         = _DaemonHandle(self, response["configuration"],
+                                                response["configurations"])
+        self._serial            = response["serial"]
+        self._modified_design   = response["modified_design"]
+        self._firmware_revision = response["firmware_revision"]
+        self._reader            = reader
+        self._writer            = writer
+        self._next_id           = 0
+        self._futures           = {} # {id: asyncio.Future}
+        self._error             = None
+        self._receiver          = asyncio.create_task(self._receive())
+        logger.debug("using device with serial %s via daemon", self._serial)
+        return self
+
+    def close(self):
+        self._receiver.cancel()
+        self._writer.close()
+
+    def _send(self, op, args, payload=b""):
+        if self._error is not None:
+            raise self._error
+        id, self._next_id = self._next_id, self._next_id + 1
+        _write_message(self._writer, {"id": id, "op": op, "args": args}, payload)
+        return id
+
+    def _notify(self, op, *args):
+        self._send(op, args)
+
+    async def _request(self, op, args, payload=b""):
+        id = self._send(op, args, payload)
+        future = self._futures[id] = asyncio.get_running_loop().create_future()
+        try:
+            await self._writer.drain()
+            return await future
+        finally:
+            if self._futures.pop(id, None) is not None: # cancelled
+                _write_message(self._writer, {"op": "cancel", "target": id})
+
+    async def _receive(self):
+        try:
+            while True:
+                response, payload = await _read_message(self._reader)
+                future = self._futures.pop(response["id"], None)
+                if "error" in response:
+                    if response["error"] == "stall":
+                        exn = usb1.USBErrorPipe()
+                    else:
+                        exn = GlasgowDeviceError(response["error"])
+                    if future is None:
+                        self._error = exn # failed configuration request
+                    elif not future.done():
+                        future.set_exception(exn)
+                elif future is not None and not future.done():
+                    future.set_result(bytearray(payload))
+        except (asyncio.IncompleteReadError, ConnectionError):
+            self._error = GlasgowDeviceError("device daemon closed the connection")
+            for future in self._futures.values():
+                if not future.done():
+                    future.set_exception(self._error)
+
+    async def control_read(self, request_type, request, value, index, length):
+        logger.trace("USB: CONTROL IN type=%#04x request=%#04x "
+                     "value=%#06x index=%#06x length=%d (submit)",
+                     request_type, request, value, index, length)
+        data = await self._request("control_read", [request_type, request, value, index, length])
+        logger.trace("USB: CONTROL IN data=<%s> (completed)", dump_hex(data))
+        return data
+
+    async def control_write(self, request_type, request, value, index, data):
+        logger.trace("USB: CONTROL OUT type=%#04x request=%#04x "
+                     "value=%#06x index=%#06x data=<%s> (submit)",
+                     request_type, request, value, index, dump_hex(data))
+        await self._request("control_write", [request_type, request, value, index], bytes(data))
+        logger.trace("USB: CONTROL OUT (completed)")
+
+    async def bulk_read(self, endpoint, length):
+        logger.trace("USB: BULK EP%d IN length=%d (submit)", endpoint & 0x7f, length)
+        data = await self._request("bulk_read", [endpoint, length])
+        logger.trace("USB: BULK EP%d IN data=<%s> (completed)", endpoint & 0x7f, dump_hex(data))
+        return data
+
+    async def bulk_write(self, endpoint, data):
+        logger.trace("USB: BULK EP%d OUT data=<%s> (submit)", endpoint & 0x7f, dump_hex(data))
+        await self._request("bulk_write", [endpoint], bytes(data))
+        logger.trace("USB: BULK EP%d OUT (completed)", endpoint & 0x7f)
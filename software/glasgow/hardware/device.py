@@ -5,6 +5,7 @@ import logging
 import asyncio
 import threading
 import importlib.resources
+from collections import defaultdict, deque
 
 import usb1
 from fx2 import REQ_RAM, REG_CPUCS
@@ -38,6 +39,7 @@ REQ_IOBUF_ENABLE = 0x19
 REQ_LIMIT_VOLT   = 0x1A
 REQ_PULL         = 0x1B
 REQ_TEST_LEDS    = 0x1C
+REQ_USB_FRAME    = 0x1D
 
 ST_ERROR         = 1<<0
 ST_FPGA_RDY      = 1<<1
@@ -53,6 +55,8 @@ class _PollerThread(threading.Thread):
         self.done    = False
         self.context = context
 
+        self._completions = deque() # (loop, callback, transfer)
+
     def run(self):
         # The poller thread spends most of its life in blocking `handleEvents()` calls and this can
         # cause issues during interpreter shutdown. If it were a daemon thread (it isn't) then it
@@ -65,6 +69,34 @@ class _PollerThread(threading.Thread):
         threading._register_atexit(self.stop)
         while not self.done:
             self.context.handleEvents()
+            self._dispatch()
+
+    def complete(self, loop, callback, transfer):
+        """
+        Queue ``callback(transfer)`` to be called on ``loop``. Must be called from a libusb transfer
+        callback, i.e. from within the poller thread.
+        """
+        self._completions.append((loop, callback, transfer))
+
+    def _dispatch(self):
+        # Waking up an event loop from another thread requires a write to its self-pipe, and with
+        # many small transfers in flight, doing this once per completed transfer limits throughput.
+        # Instead, all transfers completed during one libusb event handling pass are handed over
+        # to each event loop in a single batch, preserving the order of completion.
+        batches = {}
+        while self._completions:
+            loop, callback, transfer = self._completions.popleft()
+            batches.setdefault(loop, []).append((callback, transfer))
+        for loop, batch in batches.items():
+            try:
+                loop.call_soon_threadsafe(self._drain, batch)
+            except RuntimeError:
+                pass # event loop is closed
+
+    @staticmethod
+    def _drain(batch):
+        for callback, transfer in batch:
+            callback(transfer)
 
     def stop(self):
         self.done = True
@@ -214,38 +246,57 @@ class GlasgowDevice:
                 raise GlasgowDeviceError("found {} devices (serial numbers {}), but a serial "
                                          "number is not specified"
                                          .format(len(devices), ", ".join(devices.keys())))
-            self.revision, usb_device = next(iter(devices.values()))
+            revision, usb_device = next(iter(devices.values()))
         else:
             if serial not in devices:
                 raise GlasgowDeviceError("device with serial number {} not found"
                                          .format(serial))
-            self.revision, usb_device = devices[serial]
+            revision, usb_device = devices[serial]
 
-        self.usb_context = usb_context
-        self.usb_poller = _PollerThread(self.usb_context)
-        self.usb_poller.start()
-        self.usb_handle : usb1.USBDeviceHandle = usb_device.open()
+        usb_handle : usb1.USBDeviceHandle = usb_device.open()
         try:
-            self.usb_handle.setAutoDetachKernelDriver(True)
+            usb_handle.setAutoDetachKernelDriver(True)
         except usb1.USBErrorNotSupported:
             pass
-        device_manufacturer = self.usb_handle.getASCIIStringDescriptor(
+        device_manufacturer = usb_handle.getASCIIStringDescriptor(
             usb_device.getManufacturerDescriptor())
-        device_product = self.usb_handle.getASCIIStringDescriptor(
+        device_product = usb_handle.getASCIIStringDescriptor(
             usb_device.getProductDescriptor())
-        device_serial = self.usb_handle.getASCIIStringDescriptor(
+        device_serial = usb_handle.getASCIIStringDescriptor(
             usb_device.getSerialNumberDescriptor())
-        self._serial = device_serial
-        self._modified_design = not device_product.startswith("Glasgow Interface Explorer")
+        modified_design = not device_product.startswith("Glasgow Interface Explorer")
+        # The product string is "Glasgow Interface Explorer (git <revision>)".
+        if match := re.search(r"\(git ([0-9a-z.]+)\)$", device_product):
+            firmware_revision = match[1]
+        else:
+            firmware_revision = None
         if (device_manufacturer == "1BitSquared" and
                 device_serial in quirks.modified_design_1b2_mar2024):
-            self._modified_design = False # see quirks.py
+            modified_design = False # see quirks.py
+        self._init_transport(usb_context, usb_handle, revision=revision, serial=device_serial,
+                             modified_design=modified_design, firmware_revision=firmware_revision)
         if self._modified_design:
             logger.info("device with serial number %s was manufactured from modified design files",
                         self._serial)
             logger.info("the Glasgow Interface Explorer project is not responsible for "
                         "operation of this device")
 
+    def _init_transport(self, usb_context, usb_handle, *, revision, serial,
+                        modified_design=False, firmware_revision=None):
+        # Sets up the state used by the transfer API once the device is opened and identified.
+        # Also used by `VirtualDevice`, which has no USB device to enumerate or open.
+        self.revision = revision
+        self._serial = serial
+        self._modified_design = modified_design
+        self._firmware_revision = firmware_revision
+
+        self._transfer_pool = defaultdict(list) # {endpoint: [(transfer, buffer)]}
+
+        self.usb_context = usb_context
+        self.usb_poller = _PollerThread(self.usb_context)
+        self.usb_poller.start()
+        self.usb_handle = usb_handle
+
     @property
     def serial(self):
         return self._serial
@@ -254,20 +305,35 @@ class GlasgowDevice:
     def modified_design(self):
         return self._modified_design
 
+    @property
+    def firmware_revision(self):
+        """Git revision the device firmware was built from, or ``None`` if unknown."""
+        return self._firmware_revision
+
     def close(self):
+        self._transfer_pool.clear()
         self.usb_handle.close()
         self.usb_poller.stop()
         self.usb_context.close()
 
-    async def _do_transfer(self, is_read, setup):
+    async def _do_transfer(self, endpoint, is_read, setup):
+        # Allocating a libusb transfer (together with its ctypes callback wrapper) and a buffer
+        # for every request is expensive enough to show up in profiles at high data rates. Instead,
+        # transfers are kept in per-endpoint pools after they finish, and are resubmitted with
+        # the same buffer the next time a request of the same size is made on the same endpoint.
+        pool = self._transfer_pool[endpoint]
+        if pool:
+            transfer, buffer = pool.pop()
+        else:
+            transfer, buffer = self.usb_handle.getTransfer(), None
+        buffer = setup(transfer, buffer)
+
         # libusb transfer cancellation is asynchronous, and moreover, it is necessary to wait for
         # all transfers to finish cancelling before closing the event loop. To do this, use
-        # separate futures for result and cancel.
-        cancel_future = asyncio.Future()
-        result_future = asyncio.Future()
-
-        transfer = self.usb_handle.getTransfer()
-        setup(transfer)
+        # separate futures for result and cancel; the latter is only created when cancelling.
+        loop = asyncio.get_running_loop()
+        result_future = loop.create_future()
+        cancel_future = None
 
         def usb_callback(transfer):
             if self.usb_poller.done:
@@ -289,12 +355,16 @@ class GlasgowDevice:
                     endpoint_dir = "OUT"
                 logger.trace("USB: %s EP%d %s (cancelled)",
                              transfer_type, endpoint & 0x7f, endpoint_dir)
-                cancel_future.set_result(None)
+                if cancel_future is not None:
+                    cancel_future.set_result(None)
             elif result_future.cancelled():
                 pass
             elif status == usb1.TRANSFER_COMPLETED:
                 if is_read:
-                    result_future.set_result(transfer.getBuffer()[:transfer.getActualLength()])
+                    # The buffer will be reused by the next transfer, so the data must be copied
+                    # out of it. This is still cheaper than allocating a new zero-filled buffer.
+                    result_future.set_result(
+                        bytearray(memoryview(transfer.getBuffer())[:transfer.getActualLength()]))
                 else:
                     result_future.set_result(None)
             elif status == usb1.TRANSFER_STALL:
@@ -311,25 +381,35 @@ class GlasgowDevice:
             except usb1.USBErrorNoDevice:
                 raise GlasgowDeviceError("device disconnected") from None
 
-        loop = asyncio.get_event_loop()
-        transfer.setCallback(lambda transfer: loop.call_soon_threadsafe(usb_callback, transfer))
-        handle_usb_error(lambda: transfer.submit())
+        transfer.setCallback(lambda transfer:
+            self.usb_poller.complete(loop, usb_callback, transfer))
+        try:
+            handle_usb_error(lambda: transfer.submit())
+        except:
+            pool.append((transfer, buffer))
+            raise
         try:
             return await result_future
         finally:
             if result_future.cancelled():
                 try:
+                    cancel_future = loop.create_future()
                     handle_usb_error(lambda: transfer.cancel())
                     await cancel_future
                 except usb1.USBErrorNotFound:
-                    pass # already finished, one way or another
+                    pass # already finished, one way or another; its callback may still be pending
+                else:
+                    pool.append((transfer, buffer))
+            else:
+                pool.append((transfer, buffer))
 
     async def control_read(self, request_type, request, value, index, length):
         logger.trace("USB: CONTROL IN type=%#04x request=%#04x "
                      "value=%#06x index=%#06x length=%d (submit)",
                      request_type, request, value, index, length)
-        data = await self._do_transfer(is_read=True, setup=lambda transfer:
-            transfer.setControl(request_type|usb1.ENDPOINT_IN, request, value, index, length))
+        def setup(transfer, buffer):
+            transfer.setControl(request_type|usb1.ENDPOINT_IN, request, value, index, length)
+        data = await self._do_transfer(usb1.ENDPOINT_IN, is_read=True, setup=setup)
         logger.trace("USB: CONTROL IN data=<%s> (completed)", dump_hex(data))
         return data
 
@@ -339,14 +419,19 @@ class GlasgowDevice:
         logger.trace("USB: CONTROL OUT type=%#04x request=%#04x "
                      "value=%#06x index=%#06x data=<%s> (submit)",
                      request_type, request, value, index, dump_hex(data))
-        await self._do_transfer(is_read=False, setup=lambda transfer:
-            transfer.setControl(request_type|usb1.ENDPOINT_OUT, request, value, index, data))
+        def setup(transfer, buffer):
+            transfer.setControl(request_type|usb1.ENDPOINT_OUT, request, value, index, data)
+        await self._do_transfer(usb1.ENDPOINT_OUT, is_read=False, setup=setup)
         logger.trace("USB: CONTROL OUT (completed)")
 
     async def bulk_read(self, endpoint, length):
         logger.trace("USB: BULK EP%d IN length=%d (submit)", endpoint & 0x7f, length)
-        data = await self._do_transfer(is_read=True, setup=lambda transfer:
-            transfer.setBulk(endpoint|usb1.ENDPOINT_IN, length))
+        def setup(transfer, buffer):
+            if buffer is None or len(buffer) != length:
+                buffer = bytearray(length)
+            transfer.setBulk(endpoint|usb1.ENDPOINT_IN, buffer)
+            return buffer
+        data = await self._do_transfer(endpoint|usb1.ENDPOINT_IN, is_read=True, setup=setup)
         logger.trace("USB: BULK EP%d IN data=<%s> (completed)", endpoint & 0x7f, dump_hex(data))
         return data
 
@@ -354,8 +439,9 @@ class GlasgowDevice:
         if not isinstance(data, (bytes, bytearray)):
             data = bytes(data)
         logger.trace("USB: BULK EP%d OUT data=<%s> (submit)", endpoint & 0x7f, dump_hex(data))
-        await self._do_transfer(is_read=False, setup=lambda transfer:
-            transfer.setBulk(endpoint|usb1.ENDPOINT_OUT, data))
+        def setup(transfer, buffer):
+            transfer.setBulk(endpoint|usb1.ENDPOINT_OUT, data)
+        await self._do_transfer(endpoint|usb1.ENDPOINT_OUT, is_read=False, setup=setup)
         logger.trace("USB: BULK EP%d OUT (completed)", endpoint & 0x7f)
 
     async def _read_eeprom_raw(self, idx, addr, length, chunk_size=0x1000):
@@ -672,6 +758,21 @@ class GlasgowDevice:
         await self.control_write(usb1.REQUEST_TYPE_VENDOR, REQ_TEST_LEDS,
             0, states, [])
 
+    async def usb_frame(self):
+        """
+        Query the USB frame number the device has most recently received a SOF packet for.
+
+        Returns a tuple ``(frame, microframe)``, where ``frame`` is the 11-bit frame number and
+        ``microframe`` is the 3-bit microframe number (always 0 at full speed).
+        """
+        try:
+            frame_l, frame_h, microframe = await self.control_read(usb1.REQUEST_TYPE_VENDOR,
+                REQ_USB_FRAME, 0, 0, 3)
+        except usb1.USBErrorPipe:
+            raise GlasgowDeviceError("firmware does not support USB frame number requests; "
+                                     "run `glasgow flash` to update it")
+        return ((frame_h << 8) | frame_l) & 0x7ff, microframe & 0x7
+
     async def _register_error(self, addr):
         if await self._status() & ST_FPGA_RDY:
             raise GlasgowDeviceError(f"register 0x{addr:02x} does not exist")
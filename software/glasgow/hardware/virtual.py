@@ -0,0 +1,360 @@
+import time
+import heapq
+import logging
+import asyncio
+import threading
+from collections import defaultdict, deque
+
+import usb1
+
+from ..abstract import PipeTuning
+from .device import GlasgowDevice, REQ_REGISTER
+from .assembly import HardwareInPipe, HardwareOutPipe, HardwareInOutPipe
+
+
+__all__ = ["VirtualDevice", "benchmark_pipes"]
+
+
+logger = logging.getLogger(__name__)
+
+
+class _VirtualTransfer:
+    # Implements the subset of the `usb1.USBTransfer` interface used by `GlasgowDevice`.
+    def __init__(self, context):
+        self._context   = context
+        self._type      = None
+        self._endpoint  = None
+        self._buffer    = None
+        self._length    = 0
+        self._actual    = 0
+        self._setup     = None
+        self._status    = usb1.TRANSFER_COMPLETED
+        self._callback  = None
+        self._submitted = False
+
+    def setBulk(self, endpoint, buffer_or_len):
+        assert not self._submitted
+        if isinstance(buffer_or_len, int):
+            buffer_or_len = bytearray(buffer_or_len)
+        self._type     = usb1.TRANSFER_TYPE_BULK
+        self._endpoint = endpoint
+        self._buffer   = buffer_or_len
+        self._length   = len(buffer_or_len)
+        self._setup    = None
+        self._callback = None
+
+    def setControl(self, request_type, request, value, index, buffer_or_len):
+        assert not self._submitted
+        if isinstance(buffer_or_len, int):
+            buffer_or_len = bytearray(buffer_or_len)
+        self._type     = usb1.TRANSFER_TYPE_CONTROL
+        self._endpoint = request_type & usb1.ENDPOINT_DIR_MASK
+        self._buffer   = bytearray(buffer_or_len)
+        self._length   = len(buffer_or_len)
+        self._setup    = (request_type, request, value, index)
+        self._callback = None
+
+    def setCallback(self, callback):
+        self._callback = callback
+
+    def getType(self):
+        return self._type
+
+    def getEndpoint(self):
+        return self._endpoint
+
+    def getBuffer(self):
+        return self._buffer
+
+    def getActualLength(self):
+        return self._actual
+
+    def getStatus(self):
+        return self._status
+
+    def isSubmitted(self):
+        return self._submitted
+
+    def submit(self):
+        assert not self._submitted
+        self._submitted = True
+        self._context._submit(self)
+
+    def cancel(self):
+        self._context._cancel(self)
+
+
+class _VirtualEndpoint:
+    def __init__(self, kind):
+        self.kind    = kind
+        self.data    = deque() # loopback only
+        self.pending = deque() # IN transfers waiting for loopback data
+
+
+class _VirtualContext:
+    # Implements the subset of the `usb1.USBContext` interface used by `_PollerThread`, and
+    # schedules completion of transfers as if they were going over a bus with the given latency
+    # and bandwidth.
+    def __init__(self, *, latency, bandwidth):
+        self._latency     = latency
+        self._bandwidth   = bandwidth
+        self._lock        = threading.Condition()
+        self._endpoints   = {} # {address: _VirtualEndpoint}
+        self._loopbacks   = {} # {out_address: in_address}
+        self._registers   = defaultdict(lambda: b"\x00")
+        self._scheduled   = [] # heap of (due, serial, transfer, status)
+        self._serial      = 0
+        self._bus_free_at = 0.0
+        self._interrupted = False
+
+    def _schedule(self, transfer, actual, status=usb1.TRANSFER_COMPLETED, *, occupies_bus=True):
+        now = time.monotonic()
+        due = now + self._latency
+        if occupies_bus and self._bandwidth is not None:
+            self._bus_free_at = max(now, self._bus_free_at) + actual / self._bandwidth
+            due = max(due, self._bus_free_at)
+        transfer._actual = actual
+        heapq.heappush(self._scheduled, (due, self._serial, transfer, status))
+        self._serial += 1
+        self._lock.notify()
+
+    def _fill_in_transfer(self, endpoint, transfer):
+        buffer = memoryview(transfer._buffer).cast("B")
+        offset = 0
+        while endpoint.data and offset < transfer._length:
+            chunk = endpoint.data.popleft()
+            size  = min(len(chunk), transfer._length - offset)
+            buffer[offset:offset + size] = chunk[:size]
+            if size < len(chunk):
+                endpoint.data.appendleft(chunk[size:])
+            offset += size
+        self._schedule(transfer, offset)
+
+    def _submit(self, transfer):
+        with self._lock:
+            if transfer._type == usb1.TRANSFER_TYPE_CONTROL:
+                request_type, request, value, index = transfer._setup
+                if request == REQ_REGISTER:
+                    if transfer._endpoint == usb1.ENDPOINT_IN:
+                        data = self._registers[value][:transfer._length]
+                        transfer._buffer[:len(data)] = data
+                    else:
+                        # Register writes are big-endian, while reads are little-endian.
+                        self._registers[value] = bytes(reversed(transfer._buffer))
+                self._schedule(transfer, transfer._length, occupies_bus=False)
+                return
+
+            endpoint = self._endpoints.get(transfer._endpoint)
+            if endpoint is None:
+                self._schedule(transfer, 0, usb1.TRANSFER_STALL)
+            elif endpoint.kind == "source":
+                self._schedule(transfer, transfer._length)
+            elif endpoint.kind == "sink":
+                self._schedule(transfer, transfer._length)
+            elif endpoint.kind == "loopback-out":
+                in_endpoint = self._endpoints[self._loopbacks[transfer._endpoint]]
+                in_endpoint.data.append(bytes(transfer._buffer))
+                self._schedule(transfer, transfer._length)
+                while in_endpoint.pending and in_endpoint.data:
+                    self._fill_in_transfer(in_endpoint, in_endpoint.pending.popleft())
+            elif endpoint.kind == "loopback-in":
+                if endpoint.data:
+                    self._fill_in_transfer(endpoint, transfer)
+                else:
+                    endpoint.pending.append(transfer)
+
+    def _cancel(self, transfer):
+        with self._lock:
+            for endpoint in self._endpoints.values():
+                if transfer in endpoint.pending:
+                    endpoint.pending.remove(transfer)
+                    break
+            else:
+                for index, (_due, _serial, scheduled, _status) in enumerate(self._scheduled):
+                    if scheduled is transfer:
+                        del self._scheduled[index]
+                        heapq.heapify(self._scheduled)
+                        break
+                else:
+                    raise usb1.USBErrorNotFound
+            self._schedule(transfer, 0, usb1.TRANSFER_CANCELLED, occupies_bus=False)
+
+    def handleEvents(self):
+        with self._lock:
+            while not self._interrupted:
+                now = time.monotonic()
+                if self._scheduled and self._scheduled[0][0] <= now:
+                    break
+                self._lock.wait(self._scheduled[0][0] - now if self._scheduled else None)
+            self._interrupted = False
+            completed = []
+            now = time.monotonic()
+            while self._scheduled and self._scheduled[0][0] <= now:
+                _due, _serial, transfer, status = heapq.heappop(self._scheduled)
+                transfer._status    = status
+                transfer._submitted = False
+                completed.append(transfer)
+        for transfer in completed:
+            if transfer._callback is not None:
+                transfer._callback(transfer)
+
+    def interruptEventHandler(self):
+        with self._lock:
+            self._interrupted = True
+            self._lock.notify()
+
+    def close(self):
+        pass
+
+
+class _VirtualHandle:
+    # Implements the subset of the `usb1.USBDeviceHandle` interface used by the pipes.
+    def __init__(self, context):
+        self._context = context
+
+    def getTransfer(self):
+        return _VirtualTransfer(self._context)
+
+    def claimInterface(self, interface):
+        pass
+
+    def releaseInterface(self, interface):
+        pass
+
+    def setInterfaceAltSetting(self, interface, alt_setting):
+        pass
+
+    def setConfiguration(self, configuration):
+        pass
+
+    def getConfiguration(self):
+        return 1
+
+    def getDevice(self):
+        return self
+
+    def iterConfigurations(self):
+        return iter(())
+
+    def close(self):
+        pass
+
+
+class VirtualDevice(GlasgowDevice):
+    """
+    An in-process stand-in for a Glasgow device.
+
+    Implements the transfer API of :class:`GlasgowDevice` (bulk and control transfers, including
+    register reads and writes) on top of a simulated bus with the given per-transfer ``latency``
+    (in seconds) and shared ``bandwidth`` (in bytes per second, or ``None`` for unlimited).
+    The transfers go through the same code path as transfers to a real device, except for libusb
+    itself, which makes it possible to measure the overhead of the host software stack.
+
+    Bulk endpoints must be configured with :meth:`add_source`, :meth:`add_sink`, or
+    :meth:`add_loopback` before use; transfers to other endpoints stall.
+    """
+    def __init__(self, *, latency=0.0, bandwidth=None, revision="C3"):
+        usb_context = _VirtualContext(latency=latency, bandwidth=bandwidth)
+        self._init_transport(usb_context, _VirtualHandle(usb_context),
+                             revision=revision, serial="virtual")
+
+    def add_source(self, in_ep):
+        """Add an IN endpoint that fills every transfer completely."""
+        self.usb_context._endpoints[in_ep|usb1.ENDPOINT_IN] = _VirtualEndpoint("source")
+
+    def add_sink(self, out_ep):
+        """Add an OUT endpoint that discards every transfer."""
+        self.usb_context._endpoints[out_ep|usb1.ENDPOINT_OUT] = _VirtualEndpoint("sink")
+
+    def add_loopback(self, out_ep, in_ep):
+        """Add a pair of endpoints where data sent to the OUT endpoint is received from
+        the IN endpoint."""
+        self.usb_context._endpoints[out_ep|usb1.ENDPOINT_OUT] = _VirtualEndpoint("loopback-out")
+        self.usb_context._endpoints[in_ep|usb1.ENDPOINT_IN] = _VirtualEndpoint("loopback-in")
+        self.usb_context._loopbacks[out_ep|usb1.ENDPOINT_OUT] = in_ep|usb1.ENDPOINT_IN
+
+
+class _VirtualParent:
+    # Stands in for `HardwareAssembly` as the parent of a pipe.
+    def __init__(self, device):
+        self.device = device
+
+
+def _attach_pipe(pipe, interface, *, in_ep=None, out_ep=None, packet_size=512):
+    if in_ep is not None:
+        pipe._in_interface   = interface
+        pipe._in_ep_address  = in_ep|usb1.ENDPOINT_IN
+        pipe._in_packet_size = packet_size
+    if out_ep is not None:
+        pipe._out_interface   = interface
+        pipe._out_ep_address  = out_ep|usb1.ENDPOINT_OUT
+        pipe._out_packet_size = packet_size
+
+
+async def benchmark_pipes(*, mode, length, tuning=None, chunk_size=65536,
+                          latency=0.0, bandwidth=None):
+    """
+    Transfer ``length`` bytes through a pipe attached to a :class:`VirtualDevice`, and measure
+    the host resources this takes.
+
+    The ``mode`` is one of ``"source"`` (the device sends data to the host), ``"sink"`` (the host
+    sends data to the device), or ``"loopback"`` (the host sends data, and the device sends it
+    back). Data is sent and received in chunks of ``chunk_size`` bytes.
+
+    Returns a dictionary with the elapsed wall clock time (``"elapsed"``, in seconds), the elapsed
+    CPU time of the process (``"cpu"``, in seconds), and the amount of data that crossed the link
+    (``"length"``, in bytes).
+    """
+    tuning = PipeTuning.cast(tuning)
+    device = VirtualDevice(latency=latency, bandwidth=bandwidth)
+    parent = _VirtualParent(device)
+    try:
+        match mode:
+            case "source":
+                device.add_source(6)
+                pipe = HardwareInPipe(logger, parent, buffer_size=chunk_size * 16, tuning=tuning)
+                _attach_pipe(pipe, 0, in_ep=6)
+            case "sink":
+                device.add_sink(2)
+                pipe = HardwareOutPipe(logger, parent, tuning=tuning)
+                _attach_pipe(pipe, 0, out_ep=2)
+            case "loopback":
+                device.add_loopback(2, 6)
+                pipe = HardwareInOutPipe(logger, parent, in_buffer_size=None,
+                    out_buffer_size=None, in_tuning=tuning, out_tuning=tuning)
+                _attach_pipe(pipe, 0, in_ep=6, out_ep=2)
+            case _:
+                raise ValueError(f"unknown benchmark mode {mode!r}")
+
+        chunk = memoryview(bytes(chunk_size))
+        await pipe._start()
+        try:
+            begin_wall, begin_cpu = time.perf_counter(), time.process_time()
+            if mode in ("sink", "loopback"):
+                async def sender():
+                    remaining = length
+                    while remaining > 0:
+                        await pipe.send(chunk[:remaining])
+                        remaining -= chunk_size
+                    await pipe.flush()
+                sender_task = asyncio.ensure_future(sender())
+            if mode in ("source", "loopback"):
+                buffer = bytearray(chunk_size)
+                remaining = length
+                while remaining > 0:
+                    size = min(remaining, chunk_size)
+                    await pipe.recv_into(memoryview(buffer)[:size])
+                    remaining -= size
+            if mode in ("sink", "loopback"):
+                await sender_task
+            end_wall, end_cpu = time.perf_counter(), time.process_time()
+        finally:
+            await pipe._stop()
+    finally:
+        device.close()
+
+    return {
+        "elapsed": end_wall - begin_wall,
+        "cpu":     end_cpu - begin_cpu,
+        "length":  length * (2 if mode == "loopback" else 1),
+    }
@@ -18,6 +18,13 @@ class GDBRemoteError(Exception):
 
 
 class GDBRemote(metaclass=ABCMeta):
+    # Largest packet the stub accepts; this determines the size of memory reads and writes GDB
+    # will request at once, so it should be large enough to amortize the per-command latency.
+    gdb_packet_size = 0x4000
+
+    # Granularity of the target memory cache; see :meth:`target_memory_cacheable`.
+    gdb_cache_block_size = 0x40
+
     @abstractmethod
     def gdb_log(self, level, message, *args):
         pass
@@ -83,6 +90,14 @@ class GDBRemote(metaclass=ABCMeta):
     async def target_write_memory(self, address: int, data: bytes):
         """Writes system memory."""
 
+    def target_memory_cacheable(self, address: int, length: int) -> bool:
+        """Whether reads of the given memory range may be cached while the target is stopped.
+
+        Reads of cacheable memory are widened to :attr:`gdb_cache_block_size` aligned blocks,
+        which are then reused until the target is resumed, stepped, or its memory is written.
+        Memory-mapped I/O must never be considered cacheable. By default, no memory is."""
+        return False
+
     @abstractmethod
     async def target_set_software_breakpt(self, address: int, kind: int):
         """Sets software breakpoint at given address. This could fail if the memory at this address
@@ -116,6 +131,7 @@ class GDBRemote(metaclass=ABCMeta):
     async def gdb_run(self, endpoint):
         self.__error_strings = None
         self.__quirk_byteorder = False
+        self.__memory_cache = {} # {block_address: bytes}
         self.__eval_environment = getattr(self, "_GDBRemote__eval_environment", {"iface": self})
 
         try:
@@ -205,10 +221,43 @@ class GDBRemote(metaclass=ABCMeta):
         except EOFError:
             pass
 
+    async def _gdb_read_memory(self, address, length):
+        block_size = self.gdb_cache_block_size
+        first = address - address % block_size
+        last  = address + length - 1 - (address + length - 1) % block_size
+        if length == 0 or not self.target_memory_cacheable(first, last + block_size - first):
+            return await self.target_read_memory(address, length)
+
+        # Fetch each run of consecutive missing blocks with a single read.
+        cache = self.__memory_cache
+        block = first
+        while block <= last:
+            if block in cache:
+                block += block_size
+                continue
+            run_end = block + block_size
+            while run_end <= last and run_end not in cache:
+                run_end += block_size
+            data = await self.target_read_memory(block, run_end - block)
+            for offset in range(0, run_end - block, block_size):
+                cache[block + offset] = bytes(data[offset:offset + block_size])
+            block = run_end
+
+        data = b"".join(cache[block] for block in range(first, last + 1, block_size))
+        return data[address - first:address - first + length]
+
     async def _gdb_process(self, command, make_recv_fut):
         def binary_escape(data):
             return re.sub(rb"[#$}*]", lambda m: bytes([0x7d, m[0][0] ^ 0x20]), data)
 
+        def binary_unescape(data):
+            return re.sub(rb"}(.)", lambda m: bytes([m[1][0] ^ 0x20]), data, flags=re.S)
+
+        # Any command that could change target memory behind our back invalidates the cache.
+        if command.startswith((b"?", b"c", b"s", b"vCont;", b"D", b"M", b"X", b"Z", b"z",
+                               b"qRcmd,")):
+            self.__memory_cache.clear()
+
         word_size, byteorder = self.target_word_size(), self.target_endianness()
 
         if self.__quirk_byteorder:
@@ -262,7 +311,11 @@ class GDBRemote(metaclass=ABCMeta):
             gdb_features = command[11:].split(b";")
             if b"error-message+" in gdb_features:
                 self.__error_strings = "gdb"
-            stub_features = [b"vContSupported+", b"qXfer:features:read+"]
+            stub_features = [
+                b"PacketSize=%x" % self.gdb_packet_size,
+                b"vContSupported+",
+                b"qXfer:features:read+",
+            ]
             return b";".join(stub_features)
 
         # "Which resume actions do you support?"
@@ -377,7 +430,7 @@ class GDBRemote(metaclass=ABCMeta):
         # "Read specified memory range of the target."
         if command.startswith(b"m"):
             address, length = map(lambda x: int(x, 16), command[1:].split(b","))
-            data = await self.target_read_memory(address, length)
+            data = await self._gdb_read_memory(address, length)
             return data.hex().encode("ascii")
 
         # "Write specified memory range of the target."
@@ -387,6 +440,18 @@ class GDBRemote(metaclass=ABCMeta):
             await self.target_write_memory(address, bytes.fromhex(data.decode("ascii")))
             return b"OK"
 
+        # "Write specified memory range of the target [in binary]."
+        if command.startswith(b"X"):
+            location, data = command[1:].split(b":", 1)
+            address, length = map(lambda x: int(x, 16), location.split(b","))
+            data = binary_unescape(data)
+            if len(data) != length:
+                return (2, f"expected {length} bytes of data, got {len(data)}")
+            # GDB probes for `X` packet support with an empty write.
+            if length > 0:
+                await self.target_write_memory(address, data)
+            return b"OK"
+
         # "Set software breakpoint."
         if command.startswith(b"Z0"):
             address, kind = map(lambda x: int(x, 16), command[3:].split(b","))
@@ -44,6 +44,10 @@ class SVFLexer:
     """
     A Serial Vector Format lexer.
 
+    The input is lexed on demand, one token at a time. It may be a ``str`` or any bytes-like object
+    supported by :mod:`re` (such as a :class:`mmap.mmap`), which allows playing very large files
+    without reading them into memory first.
+
     Comments (``! comment``, ``// comment``) are ignored.
 
     The following tokens are recognized:
@@ -54,7 +58,7 @@ class SVFLexer:
         * Literal (``(HLUDXZHHLL)``, ``(IN FOO)``, ...), returned as Python ``tuple(str,)``;
         * End of file, returned as Python ``None``.
 
-    :type buffer: str
+    :type buffer: str or bytes-like
     :attr buffer:
         Input buffer.
 
@@ -64,7 +68,7 @@ class SVFLexer:
     """
 
     _keywords = _commands + _parameters + _trst_modes + _tap_states + (";",)
-    _scanner  = tuple((re.compile(src, re.A|re.I|re.M), act) for src, act in (
+    _rules    = (
         (r"\s+",
          None),
         (r"(?:!|//)([^\n]*)(?:\n|\Z)",
@@ -81,30 +85,51 @@ class SVFLexer:
          lambda m: (m[1],)),
         (r"\Z",
          lambda m: None),
-    ))
+    )
+    _scanner_str = tuple((re.compile(src, re.A|re.I|re.M), act) for src, act in _rules)
+    _scanner_bytes = tuple(
+        (re.compile(src.encode("ascii"), re.I|re.M),
+         # Actions only ever look at the first group, so present them with its decoded value.
+         act and (lambda m, act=act: act((None, m.re.groups and m[1].decode("latin-1")))))
+        for src, act in _rules)
 
     def __init__(self, buffer):
         self.buffer   = buffer
         self.position = 0
 
+        if isinstance(buffer, str):
+            self._scanner = self._scanner_str
+            self._newline = "\n"
+        else:
+            self._scanner = self._scanner_bytes
+            self._newline = b"\n"
+        self._newline_re = re.compile(self._newline)
+
+    def _text(self, start, end):
+        text = self.buffer[start:end]
+        if not isinstance(text, str):
+            text = bytes(text).decode("latin-1")
+        return text
+
     def line_column(self, position=None):
         """
         Return a ``(line, column)`` tuple for the given or, if not specified, current position.
 
         Both the line and the column start at 1.
         """
-        line = len(re.compile(r"\n").findall(self.buffer, endpos=self.position))
-        if line > 1:
-            column = self.position - self.buffer.rindex("\n", 0, self.position)
+        if position is None:
+            position = self.position
+        line = len(self._newline_re.findall(self.buffer, endpos=position))
+        if line > 0:
+            column = position - self.buffer.rfind(self._newline, 0, position) - 1
         else:
-            column = self.position
+            column = position
         return line + 1, column + 1
 
     def _lex(self):
         while True:
             for token_re, action in self._scanner:
                 match = token_re.match(self.buffer, self.position)
-                # print(token_re, match)
                 if match:
                     if action is None:
                         self.position = match.end()
@@ -114,7 +139,7 @@ class SVFLexer:
             else:
                 raise SVFParsingError("unrecognized SVF data at line %d, column %d (%s...)"
                                     % (*self.line_column(),
-                                       self.buffer[self.position:self.position + 16]))
+                                       self._text(self.position, self.position + 16)))
 
     def peek(self):
         """Return the next token without advancing the position."""
@@ -151,6 +176,7 @@ class SVFParser:
         self._position  = 0
         self._token     = None
         self._cmd_pos   = 0
+        self._cmd_start = 0
 
         self._param_tdi   = \
             {"HIR": None, "HDR": None, "SIR": None, "SDR": None, "TIR": None, "TDR": None}
@@ -265,6 +291,8 @@ class SVFParser:
         self._cmd_pos = self._lexer.position
 
         command = self._parse_token()
+        if isinstance(command, str):
+            self._cmd_start = self._lexer.position - len(command)
         if command is None:
             return False
 
@@ -441,7 +469,15 @@ class SVFParser:
         return result or True
 
     def last_command(self):
-        return self._lexer.buffer[self._cmd_pos:self._lexer.position]
+        return self._lexer._text(self._cmd_pos, self._lexer.position)
+
+    def last_command_position(self):
+        """Return the offset of the first token of the last parsed command."""
+        return self._cmd_start
+
+    def line_column(self, position):
+        """Return a ``(line, column)`` tuple for the given position."""
+        return self._lexer.line_column(position)
 
     def parse_file(self):
         while self.parse_command(): pass
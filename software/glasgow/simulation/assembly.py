@@ -11,7 +11,7 @@ from ..gateware.stream import stream_get, stream_put
 from ..abstract import *
 
 
-__all__ = ["SimulationPipe", "SimulationRegister", "SimulationAssembly"]
+__all__ = ["SimulationPipe", "SimulationRegister", "SimulationAssembly", "ModelAssembly"]
 
 
 logger = logging.getLogger(__name__)
@@ -36,6 +36,16 @@ class SimulationPipe(AbstractInOutPipe):
         del self._i_buffer[:length]
         return data
 
+    async def recv_into(self, buffer: bytearray | memoryview) -> int:
+        assert self._i_buffer is not None, "recv_into() called on an out pipe"
+        buffer = memoryview(buffer).cast("B")
+        while len(self._i_buffer) < len(buffer):
+            clk_hit, rst_hit = await self._parent._context.tick()
+            assert not rst_hit
+        buffer[:] = self._i_buffer[:len(buffer)]
+        del self._i_buffer[:len(buffer)]
+        return len(buffer)
+
     @property
     def writable(self) -> Optional[int]:
         return None
@@ -111,20 +121,24 @@ class SimulationAssembly(AbstractAssembly):
         self._jumpers.append(pin_names)
 
     def add_in_pipe(self, in_stream, *, in_flush=C(1),
-                    fifo_depth=None, buffer_size=None) -> AbstractInPipe:
+                    fifo_depth=None, buffer_size=None, tuning=None) -> AbstractInPipe:
         return self.add_inout_pipe(
             in_stream=in_stream, out_stream=None, in_flush=in_flush,
-            in_fifo_depth=fifo_depth, in_buffer_size=buffer_size)
+            in_fifo_depth=fifo_depth, in_buffer_size=buffer_size, in_tuning=tuning)
 
     def add_out_pipe(self, out_stream, *,
-                     fifo_depth=None, buffer_size=None) -> AbstractOutPipe:
+                     fifo_depth=None, buffer_size=None, tuning=None) -> AbstractOutPipe:
         return self.add_inout_pipe(
             in_stream=None, out_stream=out_stream,
-            out_fifo_depth=fifo_depth, out_buffer_size=buffer_size)
+            out_fifo_depth=fifo_depth, out_buffer_size=buffer_size, out_tuning=tuning)
 
     def add_inout_pipe(self, in_stream, out_stream, *, in_flush=C(1),
-                       in_fifo_depth=None, in_buffer_size=None,
-                       out_fifo_depth=None, out_buffer_size=None) -> AbstractInOutPipe:
+                       in_fifo_depth=None, in_buffer_size=None, in_tuning=None,
+                       out_fifo_depth=None, out_buffer_size=None, out_tuning=None
+                       ) -> AbstractInOutPipe:
+        # Tuning only affects USB transfers, and is validated but otherwise ignored here.
+        PipeTuning.cast(in_tuning)
+        PipeTuning.cast(out_tuning)
         if in_stream is None:
             i_buffer = None
         else:
@@ -175,6 +189,9 @@ class SimulationAssembly(AbstractAssembly):
     def add_testbench(self, constructor, *, background=False):
         self._benches.append((constructor, background))
 
+    def use_pipe_registers(self):
+        pass # registers are accessed directly in simulation
+
     def use_voltage(self, ports: Mapping[GlasgowPort, GlasgowVio | float]):
         for port, vio in ports.items():
             port = GlasgowPort(port)
@@ -253,3 +270,37 @@ class SimulationAssembly(AbstractAssembly):
                 sim.run()
         finally:
             self.__context = None
+
+
+class ModelAssembly:
+    """An assembly that connects the pipe of an applet interface to a Python model of its
+    gateware (and of the target), instead of simulating the gateware.
+
+    This is much faster than :class:`SimulationAssembly`, and is used to test the host side of
+    interfaces that exchange many commands with the device. The ``pipe`` must implement ``send``,
+    ``flush``, and ``recv``. The gateware is not elaborated, and the registers and clock divisors
+    it would have are replaced with ``None``.
+    """
+
+    sys_clk_period = 1e-8
+
+    def __init__(self, pipe):
+        self._pipe = pipe
+
+    def add_port_group(self, **kwargs):
+        return None
+
+    def add_submodule(self, elaboratable, *, name=None):
+        return elaboratable
+
+    def add_inout_pipe(self, *args, **kwargs):
+        return self._pipe
+
+    def add_clock_divisor(self, *args, **kwargs):
+        return None
+
+    def add_ro_register(self, signal):
+        return None
+
+    def add_rw_register(self, signal):
+        return None
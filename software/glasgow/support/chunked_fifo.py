@@ -75,6 +75,19 @@ class ChunkedFIFO:
         self._rtotal += len(result)
         return result
 
+    def read_into(self, buffer):
+        """
+        Dequeue at most ``len(buffer)`` bytes into ``buffer``, copying directly from the chunks
+        in the FIFO. Returns the number of bytes dequeued.
+        """
+        buffer = memoryview(buffer).cast("B")
+        offset = 0
+        while offset < len(buffer) and self:
+            chunk = self.read(len(buffer) - offset)
+            buffer[offset:offset + len(chunk)] = chunk
+            offset += len(chunk)
+        return offset
+
     def __bool__(self):
         """Check whether there are any bytes in the FIFO."""
         return bool(self._queue) or self._chunk is not None
@@ -0,0 +1,80 @@
+import sys
+import time
+import importlib.abc
+
+
+__all__ = ["ImportProfiler"]
+
+
+class _TimedLoader(importlib.abc.Loader):
+    def __init__(self, profiler, loader):
+        self._profiler = profiler
+        self._loader   = loader
+
+    def create_module(self, spec):
+        return self._loader.create_module(spec)
+
+    def exec_module(self, module):
+        # Make the module look exactly as if it was loaded without the profiler; some modules
+        # (e.g. those using `importlib.resources`) inspect their own loader.
+        module.__spec__.loader = self._loader
+        module.__loader__ = self._loader
+        self._profiler._enter(module.__name__)
+        try:
+            self._loader.exec_module(module)
+        finally:
+            self._profiler._leave(module.__name__)
+
+
+class ImportProfiler(importlib.abc.MetaPathFinder):
+    """Import time profiler.
+
+    Measures the time it takes to execute the body of every module imported after :meth:`install`
+    is called, both including (cumulative time) and excluding (self time) the time spent importing
+    its own dependencies. This is similar to ``python -X importtime``, but is usable from within
+    the process and does not require restarting the interpreter.
+    """
+
+    def __init__(self):
+        self._stack     = []
+        self.started    = None
+        self.total_time = 0.0
+        self.cum_time   = {}
+        self.self_time  = {}
+
+    def install(self):
+        self.started = time.perf_counter()
+        sys.meta_path.insert(0, self)
+
+    def uninstall(self):
+        if self in sys.meta_path:
+            sys.meta_path.remove(self)
+
+    def find_spec(self, fullname, path, target=None):
+        for finder in sys.meta_path:
+            if finder is self or not hasattr(finder, "find_spec"):
+                continue
+            spec = finder.find_spec(fullname, path, target)
+            if spec is not None:
+                if spec.loader is not None and hasattr(spec.loader, "exec_module"):
+                    spec.loader = _TimedLoader(self, spec.loader)
+                return spec
+        return None
+
+    def _enter(self, name):
+        self._stack.append([name, time.perf_counter(), 0.0])
+
+    def _leave(self, name):
+        name, started, children = self._stack.pop()
+        elapsed = time.perf_counter() - started
+        self.cum_time[name]  = elapsed
+        self.self_time[name] = elapsed - children
+        if self._stack:
+            self._stack[-1][2] += elapsed
+        else:
+            self.total_time += elapsed
+
+    def top(self, count, *, cumulative=False):
+        """Return ``count`` slowest modules as ``(name, seconds)`` pairs."""
+        times = self.cum_time if cumulative else self.self_time
+        return sorted(times.items(), key=lambda item: item[1], reverse=True)[:count]
@@ -119,32 +119,54 @@ class PluginMetadata:
 
         # Person-side metadata (how to display it, etc.)
         self.handle = entry_point.name
-        if not self.unmet_requirements:
-            try:
-                self._cls = entry_point.load()
-                self.synopsis = self._cls.help
-                self.description = self._cls.description
-            except Exception as exn:
-                self._cls = None
-                # traceback.format_exception_only can return multiple lines
-                self.synopsis = (
-                    f"/!\\ unavailable due to a load error: "
-                    "".join(traceback.format_exception_only(exn)).splitlines()[0])
-                # traceback.format_exception can return lines with internal newlines
-                self.description = (
-                    f"\nThis plugin is unavailable because attempting to load it has raised "
-                    f"an exception. The exception is:\n\n    " +
-                    "".join(traceback.format_exception(exn)).replace("\n", "\n    "))
-        else:
-            self._cls = None
-            self.synopsis = (
+
+        # Importing the plugin is deferred until it is needed, since importing every plugin
+        # (together with all of their dependencies) dominates the startup time of the CLI.
+        self._entry_point = entry_point
+        self._loaded = False
+        self._cls = None
+        self._exn = None
+
+    def _load(self):
+        if not self._loaded:
+            self._loaded = True
+            if not self.unmet_requirements:
+                try:
+                    self._cls = self._entry_point.load()
+                except Exception as exn:
+                    self._exn = exn
+        return self._cls
+
+    @property
+    def synopsis(self):
+        if self.unmet_requirements:
+            return (
                 f"/!\\ unavailable due to unmet requirements: "
                 f"{', '.join(str(r) for r in self.unmet_requirements)}")
-            self.description = (
+        elif self._load() is None:
+            # traceback.format_exception_only can return multiple lines
+            return (
+                f"/!\\ unavailable due to a load error: "
+                "".join(traceback.format_exception_only(self._exn)).splitlines()[0])
+        else:
+            return self._cls.help
+
+    @property
+    def description(self):
+        if self.unmet_requirements:
+            return (
                 f"\nThis plugin is unavailable because it requires additional packages to function "
                 f"that are not installed. To install them, run:\n\n    " +
                 _install_command_for_requirements(self.unmet_requirements) +
                 f"\n")
+        elif self._load() is None:
+            # traceback.format_exception can return lines with internal newlines
+            return (
+                f"\nThis plugin is unavailable because attempting to load it has raised "
+                f"an exception. The exception is:\n\n    " +
+                "".join(traceback.format_exception(self._exn)).replace("\n", "\n    "))
+        else:
+            return self._cls.description
 
     @property
     def unmet_requirements(self):
@@ -156,12 +178,12 @@ class PluginMetadata:
 
     @property
     def loadable(self):
-        return self._cls is not None
+        return self._load() is not None
 
     def load(self):
         if self.unmet_requirements:
             raise PluginRequirementsUnmet(self)
-        if self._cls is None:
+        if self._load() is None:
             raise PluginLoadError(self)
         return self._cls
 
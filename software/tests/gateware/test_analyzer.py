@@ -1,9 +1,10 @@
 import unittest
 from amaranth import *
 from amaranth.lib.fifo import SyncFIFOBuffered
+from amaranth.sim import Simulator
 
 from glasgow.gateware import simulation_test
-from glasgow.gateware.analyzer import EventAnalyzer, TraceDecoder, REPORT_DELAY, REPORT_EVENT, REPORT_SPECIAL, SPECIAL_DONE, SPECIAL_OVERRUN
+from glasgow.gateware.analyzer import EventAnalyzer, TraceCompressor, TraceDecoder, REPORT_DELAY, REPORT_EVENT, REPORT_SPECIAL, SPECIAL_DONE, SPECIAL_OVERRUN, SPECIAL_REPEAT_1, SPECIAL_REPEAT_2
 
 
 class EventAnalyzerTestbench(Elaboratable):
@@ -378,3 +379,249 @@ class EventAnalyzerTestCase(unittest.TestCase):
         ], [
             (0x10000, "overrun"),
         ], flush_pending=False)
+
+
+def ref_compress(data, event_sources, group_depth=8):
+    output    = []
+    group     = []
+    previous  = [None, None]
+    run       = [0, 0] # distance, count
+    nondelay  = False
+    data_left = 0
+    long      = False
+
+    def emit_run():
+        if run[0] != 0:
+            output.extend([REPORT_SPECIAL|(SPECIAL_REPEAT_1 if run[0] == 1 else SPECIAL_REPEAT_2),
+                           run[1]])
+            run[:] = [0, 0]
+
+    def end_group():
+        nonlocal previous
+        if long:
+            previous = [None, previous[0]]
+            return
+        if not group:
+            return
+        if run[0] != 0 and previous[run[0] - 1] == group:
+            run[1] += 1
+        else:
+            emit_run()
+            if previous[0] == group:
+                run[:] = [1, 1]
+            elif previous[1] == group:
+                run[:] = [2, 1]
+            else:
+                output.extend(group)
+        previous = [list(group), previous[0]]
+        if run[1] == 0xff:
+            emit_run()
+
+    def append(octet):
+        nonlocal nondelay, data_left, long
+        if data_left:
+            data_left -= 1
+            nondelay = True
+        else:
+            if octet & 0b11000000 == REPORT_EVENT:
+                data_left = (event_sources[octet & 0b111111].width + 7) // 8
+            nondelay = nondelay or not (octet & REPORT_DELAY)
+        if long:
+            output.append(octet)
+        elif len(group) == group_depth:
+            emit_run()
+            output.extend(group)
+            output.append(octet)
+            long = True
+        else:
+            group.append(octet)
+
+    for octet in data:
+        is_terminal = octet in (REPORT_SPECIAL|SPECIAL_DONE, REPORT_SPECIAL|SPECIAL_OVERRUN)
+        if data_left == 0 and is_terminal:
+            end_group()
+            emit_run()
+            output.append(octet)
+            previous = [None, None]
+            group, nondelay, long = [], False, False
+        elif data_left == 0 and octet & REPORT_DELAY and nondelay:
+            end_group()
+            group, nondelay, long = [], False, False
+            append(octet)
+        else:
+            append(octet)
+    return output
+
+
+class TraceCompressorTestCase(unittest.TestCase):
+    def setUp(self):
+        self.analyzer = EventAnalyzer(None)
+        self.analyzer.add_event_source("clk",  "change", 1)
+        self.analyzer.add_event_source("data", "change", 16)
+        self.analyzer.add_event_source("stb",  "strobe", 0)
+        self.event_sources = self.analyzer.event_sources
+
+    def group(self, delay, *events):
+        return [REPORT_DELAY|delay, *events]
+
+    def done(self):
+        return [REPORT_DELAY|1, REPORT_SPECIAL|SPECIAL_DONE]
+
+    def assertDecodesSame(self, data, compressed):
+        decoder = TraceDecoder(self.event_sources)
+        decoder.process(data)
+        expected = decoder.flush(pending=True)
+        decoder = TraceDecoder(self.event_sources, compressed=True)
+        decoder.process(compressed)
+        self.assertEqual(decoder.flush(pending=True), expected)
+
+    def test_ref_repeat_1(self):
+        data = [*self.group(3, REPORT_EVENT|2) * 10, *self.done()]
+        compressed = ref_compress(data, self.event_sources)
+        self.assertEqual(compressed, [
+            REPORT_DELAY|3, REPORT_EVENT|2,
+            REPORT_SPECIAL|SPECIAL_REPEAT_1, 9,
+            REPORT_DELAY|1, REPORT_SPECIAL|SPECIAL_DONE,
+        ])
+        self.assertDecodesSame(data, compressed)
+
+    def test_ref_repeat_2(self):
+        data = []
+        for n in range(100):
+            data += self.group(5, REPORT_EVENT|0, n & 1)
+        data += self.done()
+        compressed = ref_compress(data, self.event_sources)
+        self.assertEqual(compressed, [
+            REPORT_DELAY|5, REPORT_EVENT|0, 0,
+            REPORT_DELAY|5, REPORT_EVENT|0, 1,
+            REPORT_SPECIAL|SPECIAL_REPEAT_2, 98,
+            *self.done(),
+        ])
+        self.assertDecodesSame(data, compressed)
+
+    def test_ref_data_like_reports(self):
+        data = []
+        for n in range(20):
+            data += self.group(1, REPORT_EVENT|1, 0x80, REPORT_SPECIAL|SPECIAL_REPEAT_1)
+            data += self.group(1, REPORT_EVENT|1, REPORT_SPECIAL|SPECIAL_DONE, 0x81)
+        data += self.done()
+        self.assertDecodesSame(data, ref_compress(data, self.event_sources))
+
+    def test_ref_long(self):
+        data = []
+        for n in range(20):
+            data += self.group(1, REPORT_DELAY|0, REPORT_DELAY|0,
+                               REPORT_EVENT|0, 1, REPORT_EVENT|1, 0x12, 0x34, REPORT_EVENT|2)
+            data += self.group(2, REPORT_EVENT|2)
+        data += self.done()
+        self.assertDecodesSame(data, ref_compress(data, self.event_sources))
+
+    def test_ref_saturate(self):
+        data = self.group(1, REPORT_EVENT|2) * 600
+        compressed = ref_compress(data, self.event_sources)
+        self.assertEqual(compressed, [
+            REPORT_DELAY|1, REPORT_EVENT|2,
+            REPORT_SPECIAL|SPECIAL_REPEAT_1, 0xff,
+            REPORT_SPECIAL|SPECIAL_REPEAT_1, 0xff,
+        ])
+        self.assertDecodesSame(data, compressed + [REPORT_SPECIAL|SPECIAL_REPEAT_1, 600 - 511])
+
+    def rtl_compress(self, data):
+        fifo = SyncFIFOBuffered(width=8, depth=len(data) + 2)
+        dut  = TraceCompressor(fifo, self.event_sources, idle_cycles=len(data) * 4)
+        m = Module()
+        m.submodules.fifo = fifo
+        m.submodules.dut  = dut
+        cycles = Signal(32)
+        m.d.sync += cycles.eq(cycles + 1)
+
+        async def testbench_i(ctx):
+            for octet in data:
+                ctx.set(dut.w_data, octet)
+                ctx.set(dut.w_en, 1)
+                await ctx.tick().until(dut.w_rdy)
+            ctx.set(dut.w_en, 0)
+            self.input_cycles = ctx.get(cycles)
+
+        output = []
+        async def testbench_o(ctx):
+            ctx.set(fifo.r_en, 1)
+            for _ in range(len(data) * 4):
+                _, _, r_rdy, r_data = await ctx.tick().sample(fifo.r_rdy).sample(fifo.r_data)
+                if r_rdy:
+                    output.append(r_data)
+
+        sim = Simulator(m)
+        sim.add_clock(1e-8)
+        sim.add_testbench(testbench_i)
+        sim.add_testbench(testbench_o)
+        sim.run()
+        return output
+
+    def test_rtl_matches_ref(self):
+        data = []
+        for n in range(40):
+            data += self.group(5, REPORT_EVENT|0, n & 1)
+        data += self.group(1, REPORT_DELAY|0, REPORT_DELAY|0,
+                           REPORT_EVENT|0, 1, REPORT_EVENT|1, 0x12, 0x34, REPORT_EVENT|2)
+        data += self.group(1, REPORT_EVENT|1, 0x80, REPORT_SPECIAL|SPECIAL_DONE) * 5
+        data += self.done()
+        self.assertEqual(self.rtl_compress(data), ref_compress(data, self.event_sources))
+
+    def test_rtl_bypass(self):
+        # groups that cannot be compressed are passed through with one cycle of overhead each
+        data = []
+        for n in range(100):
+            data += self.group(n + 1, REPORT_EVENT|0, n & 1)
+        data += self.done()
+        self.assertEqual(self.rtl_compress(data), ref_compress(data, self.event_sources))
+        self.assertLessEqual(self.input_cycles, len(data) + 100 + 4)
+
+
+class TraceDecoderColumnsTestCase(unittest.TestCase):
+    def setUp(self):
+        self.analyzer = EventAnalyzer(None)
+        self.analyzer.add_event_source("a", "change", 12)
+        self.analyzer.add_event_source("b", "change", 16)
+        self.event_sources = self.analyzer.event_sources
+
+    def trace(self):
+        data = []
+        for n in range(200):
+            delay = (n * 37) % 300 + 1
+            if delay >= 128:
+                data += [REPORT_DELAY|(delay >> 7), REPORT_DELAY|(delay & 0x7f)]
+            else:
+                data += [REPORT_DELAY|delay]
+            data += [REPORT_EVENT|(n & 1), (n * 7) & 0xff, (n * 13) & 0xff]
+            if n == 100:
+                # an irregular group, with two events in one cycle
+                data += [REPORT_EVENT|1, 0x40, 0x41]
+        return bytes(data)
+
+    def expected(self, data, chunk):
+        decoder = TraceDecoder(self.event_sources)
+        rows = []
+        for offset in range(0, len(data), chunk):
+            decoder.process(data[offset:offset + chunk])
+            for timestamp, events in decoder.flush():
+                for name, value in events.items():
+                    rows.append((timestamp, "ab".index(name), value))
+        for timestamp, events in decoder.flush(pending=True):
+            for name, value in events.items():
+                rows.append((timestamp, "ab".index(name), value))
+        return rows
+
+    def actual(self, data, chunk):
+        decoder = TraceDecoder(self.event_sources)
+        rows = []
+        for offset in range(0, len(data), chunk):
+            columns = decoder.process_columns(data[offset:offset + chunk])
+            rows += zip(columns.timestamps, columns.sources, columns.values)
+        return rows
+
+    def test_columns(self):
+        data = self.trace()
+        for chunk in (len(data), 1000, 7, 1):
+            with self.subTest(chunk=chunk):
+                self.assertEqual(self.actual(data, chunk), self.expected(data, chunk))
@@ -1,8 +1,10 @@
 import unittest
 from amaranth import *
+from amaranth.sim import Simulator
 
 from glasgow.gateware import simulation_test
-from glasgow.gateware.registers import I2CRegisters
+from glasgow.gateware.registers import I2CRegisters, StreamRegisters
+from glasgow.gateware.stream import stream_put, stream_get
 
 from .test_i2c import I2CTargetTestbench
 
@@ -163,3 +165,85 @@ class I2CRegistersTestCase(unittest.TestCase):
         yield tb.cd_app.rst.eq(0)
         yield
         self.assertEqual((yield tb.reg_app), 0)
+
+
+class StreamRegistersTestCase(unittest.TestCase):
+    def setUp(self):
+        self.dut = StreamRegisters()
+        self.reg_rw_8,  self.addr_rw_8  = self.dut.add_rw(8)
+        self.reg_ro_8,  self.addr_ro_8  = self.dut.add_ro(8)
+        self.reg_rw_12, self.addr_rw_12 = self.dut.add_rw(12)
+        self.reg_ro_24, self.addr_ro_24 = self.dut.add_ro(24)
+
+    def run_frames(self, data_i, length_o, *, setup=lambda ctx: None):
+        dut = self.dut
+
+        async def testbench_i(ctx):
+            setup(ctx)
+            ctx.set(dut.i.valid, 1)
+            for byte in data_i:
+                ctx.set(dut.i.payload, byte)
+                await ctx.tick().until(dut.i.ready)
+            ctx.set(dut.i.valid, 0)
+
+        data_o = bytearray()
+        async def testbench_o(ctx):
+            ctx.set(dut.o.ready, 1)
+            while len(data_o) < length_o:
+                _, _, valid, payload = await ctx.tick().sample(dut.o.valid).sample(dut.o.payload)
+                if valid:
+                    data_o.append(payload)
+            ctx.set(dut.o.ready, 0)
+
+        sim = Simulator(dut)
+        sim.add_clock(1e-6)
+        sim.add_testbench(testbench_i)
+        sim.add_testbench(testbench_o)
+        sim.run()
+        return bytes(data_o)
+
+    def test_read_8(self):
+        def setup(ctx):
+            ctx.set(self.reg_ro_8, 0xa5)
+        self.assertEqual(self.run_frames([0x00, self.addr_ro_8], 1, setup=setup), b"\xa5")
+
+    def test_read_24(self):
+        def setup(ctx):
+            ctx.set(self.reg_ro_24, 0x123456)
+        self.assertEqual(self.run_frames([0x00, self.addr_ro_24], 3, setup=setup),
+                         b"\x56\x34\x12")
+
+    def test_write_read_8(self):
+        self.assertEqual(self.run_frames([
+            0x01, self.addr_rw_8, 0x5a,
+            0x00, self.addr_rw_8,
+        ], 2), b"\x00\x5a")
+
+    def test_write_read_12(self):
+        self.assertEqual(self.run_frames([
+            0x01, self.addr_rw_12, 0xa5, 0xfe,
+            0x00, self.addr_rw_12,
+        ], 3), b"\x00\xa5\x0e")
+
+    def test_reset(self):
+        dut = self.dut
+        data_o = bytearray()
+
+        async def testbench(ctx):
+            # abandon a write after the first data byte, then read the register back
+            for byte in [0x01, self.addr_rw_12, 0xa5]:
+                await stream_put(ctx, dut.i, byte)
+            ctx.set(dut.reset, 1)
+            await ctx.tick()
+            ctx.set(dut.reset, 0)
+            for byte in [0x00, self.addr_rw_12]:
+                await stream_put(ctx, dut.i, byte)
+            for _ in range(2):
+                data_o.append(await stream_get(ctx, dut.o))
+            self.assertEqual(ctx.get(self.reg_rw_12), 0)
+
+        sim = Simulator(dut)
+        sim.add_clock(1e-6)
+        sim.add_testbench(testbench)
+        sim.run()
+        self.assertEqual(bytes(data_o), b"\x00\x00")
@@ -71,13 +71,14 @@ class SWDTarget:
 
 class Scenario:
     dut_cls = None
+    dut_kwargs = {}
 
     def __init__(self):
         self.ports = PortGroup()
         self.ports.swclk = io.SimulationPort("o",  1, name="swclk")
         self.ports.swdio = io.SimulationPort("io", 1, name="swdio")
 
-        self.dut = self.dut_cls(self.ports)
+        self.dut = self.dut_cls(self.ports, **self.dut_kwargs)
         self.tgt = SWDTarget(self.ports)
 
     def run(self):
@@ -391,6 +392,124 @@ class ControllerScenario(Scenario):
         await self.tgt.assert_wdata(ctx, 0x01010102)
 
 
+class StickyControllerScenario(Scenario):
+    dut_cls = Controller
+    dut_kwargs = {"sticky": True}
+
+    async def i_testbench(self, ctx):
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 1, "r_nw": 1, "addr": 0xC}
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 1, "r_nw": 1, "addr": 0xC}
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 1, "r_nw": 0, "addr": 0x4},
+            "data": 0x20000000,
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 0, "r_nw": 1, "addr": 0x4}
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 1, "r_nw": 1, "addr": 0xC}
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 0, "r_nw": 0, "addr": 0x0},
+            "data": 0x0000001e,
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 0, "r_nw": 1, "addr": 0x0}
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 1, "r_nw": 1, "addr": 0xC}
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 0, "r_nw": 1, "addr": 0x0}
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "cmd":  Command.Sequence,
+            "len":  8,
+            "data": 0xff,
+        })
+        await stream_put(ctx, self.dut.i_stream, {
+            "hdr":  {"ap_ndp": 0, "r_nw": 1, "addr": 0x0}
+        })
+
+    async def o_testbench(self, ctx):
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.NoData,
+            "ack":  Ack.FAULT
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Skipped,
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Skipped,
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Data,
+            "ack":  Ack.OK,
+            "data": 0xf0000020
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Skipped,
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.NoData,
+            "ack":  Ack.OK
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Data,
+            "ack":  Ack.OK,
+            "data": 0x12345678
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Error,
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Skipped,
+        })
+        await stream_assert(ctx, self.dut.o_stream, {
+            "rsp":  Response.Data,
+            "ack":  Ack.OK,
+            "data": 0x12345678
+        })
+
+    async def t_testbench(self, ctx):
+        await self.tgt.assert_packet(ctx, ap_ndp=1, r_nw=1, addr=0xC)
+        await self.tgt.ack(ctx, Ack.FAULT)
+        await self.tgt.turnaround(ctx)
+
+        # two transfers skipped
+
+        await self.tgt.assert_packet(ctx, ap_ndp=0, r_nw=1, addr=0x4)
+        await self.tgt.ack(ctx, Ack.OK)
+        await self.tgt.rdata(ctx, 0xf0000020)
+
+        # one transfer skipped, DP CTRL/STAT read does not clear the failure
+
+        await self.tgt.assert_packet(ctx, ap_ndp=0, r_nw=0, addr=0x0)
+        await self.tgt.ack(ctx, Ack.OK)
+        await self.tgt.assert_wdata(ctx, 0x0000001e)
+
+        await self.tgt.assert_packet(ctx, ap_ndp=0, r_nw=1, addr=0x0)
+        await self.tgt.ack(ctx, Ack.OK)
+        await self.tgt.rdata(ctx, 0x12345678)
+
+        await self.tgt.assert_packet(ctx, ap_ndp=1, r_nw=1, addr=0xC)
+        await self.tgt.ack(ctx, Ack.OK, error=True)
+        await self.tgt.nop(ctx)
+
+        # one transfer skipped
+
+        for _ in range(8):
+            assert await self.tgt.get(ctx) == 1
+
+        await self.tgt.assert_packet(ctx, ap_ndp=0, r_nw=1, addr=0x0)
+        await self.tgt.ack(ctx, Ack.OK)
+        await self.tgt.rdata(ctx, 0x12345678)
+
+
 class JTAGToSWDScenario(Scenario):
     dut_cls = Controller
 
@@ -440,5 +559,8 @@ class SWDTestCase(unittest.TestCase):
     def test_controller(self):
         ControllerScenario().run()
 
+    def test_controller_sticky(self):
+        StickyControllerScenario().run()
+
     def test_jtag_to_swd(self):
         JTAGToSWDScenario().run()
@@ -0,0 +1,163 @@
+import asyncio
+import logging
+import unittest
+from unittest.mock import Mock
+from amaranth import *
+
+from glasgow.abstract import PipeTuning
+from glasgow.gateware.registers import StreamRegisters
+from glasgow.hardware.assembly import HardwareAssembly, HardwareInPipe
+
+
+class _MockRegisterPipe:
+    """Emulates the framing of :class:`StreamRegisters` on the host side of a register pipe."""
+
+    def __init__(self, widths):
+        self.widths = widths
+        self.values = {address: 0 for address in widths}
+        self.frames = []
+        self.responding = asyncio.Event()
+        self.responding.set()
+        self._buffer = bytearray()
+        self._output = bytearray()
+
+    async def send(self, data):
+        self._buffer += data
+        await asyncio.sleep(0)
+
+    async def flush(self):
+        command, address = self._buffer[:2]
+        if command == StreamRegisters.CMD_READ:
+            frame = bytes(self._buffer[:2])
+            self._output += self.values[address].to_bytes(self.widths[address], "little")
+        elif command == StreamRegisters.CMD_WRITE:
+            frame = bytes(self._buffer[:2 + self.widths[address]])
+            self.values[address] = int.from_bytes(frame[2:], "little")
+            self._output += b"\x00"
+        self.frames.append(frame)
+        del self._buffer[:len(frame)]
+        assert not self._buffer, "flushed a partial frame"
+
+    async def recv(self, length):
+        await self.responding.wait()
+        assert len(self._output) >= length, "received more than the device sent"
+        data = bytes(self._output[:length])
+        del self._output[:length]
+        return data
+
+
+class _MockInDevice:
+    """Completes IN transfers with scripted lengths, and then stops completing them."""
+
+    def __init__(self, lengths):
+        self.usb_handle = Mock()
+        self.lengths    = list(lengths)
+        self.requests   = []
+
+    async def bulk_read(self, address, size):
+        self.requests.append(size)
+        if not self.lengths:
+            await asyncio.Future()
+        return bytes(min(size, self.lengths.pop(0)))
+
+
+class HardwareInPipeTestCase(unittest.TestCase):
+    async def do_test_adaptive(self):
+        device = _MockInDevice([
+            1 << 20, 1 << 20, 1 << 20, 1 << 20, # full
+            3000,                               # at least half full
+            100, 100, 100, 100,                 # mostly empty
+        ])
+        pipe = HardwareInPipe(logging.getLogger(__name__), Mock(device=device),
+            tuning=PipeTuning(packets_per_xfer=8, xfers_per_queue=1, adaptive=True))
+        pipe._in_interface   = 0
+        pipe._in_packet_size = 512
+        await pipe._start()
+        while len(device.requests) < 10:
+            await asyncio.sleep(0)
+        await pipe._stop()
+        self.assertEqual([size // 512 for size in device.requests],
+                         [1, 2, 4, 8, 8, 8, 4, 2, 1, 1])
+
+    def test_adaptive(self):
+        asyncio.run(self.do_test_adaptive())
+
+    async def do_test_adaptive_per_transfer(self):
+        # each of the transfers in flight is resized based on its own completions only
+        device = _MockInDevice([1 << 20] * 6)
+        pipe = HardwareInPipe(logging.getLogger(__name__), Mock(device=device),
+            tuning=PipeTuning(packets_per_xfer=8, xfers_per_queue=2, adaptive=True))
+        pipe._in_interface   = 0
+        pipe._in_packet_size = 512
+        await pipe._start()
+        while len(device.requests) < 8:
+            await asyncio.sleep(0)
+        await pipe._stop()
+        self.assertEqual([size // 512 for size in device.requests],
+                         [1, 1, 2, 2, 4, 4, 8, 8])
+
+    def test_adaptive_per_transfer(self):
+        asyncio.run(self.do_test_adaptive_per_transfer())
+
+
+class HardwareAssemblyTestCase(unittest.TestCase):
+    def setUp(self):
+        self.assembly = HardwareAssembly(revision="C0")
+        self.reg_rw_8  = self.assembly.add_rw_register(Signal(8))
+        self.reg_rw_12 = self.assembly.add_rw_register(Signal(12))
+        self.reg_ro_24 = self.assembly.add_ro_register(Signal(24))
+        self.assembly.use_pipe_registers()
+        self.pipe = self.assembly._reg_pipe = _MockRegisterPipe({
+            self.reg_rw_8._address:  1,
+            self.reg_rw_12._address: 2,
+            self.reg_ro_24._address: 3,
+        })
+
+    async def do_test_pipe_registers(self):
+        await self.reg_rw_12.set(0xa5e)
+        self.pipe.values[self.reg_ro_24._address] = 0x123456
+        self.assertEqual(await self.reg_rw_12.get(), 0xa5e)
+        self.assertEqual(await self.reg_ro_24.get(), 0x123456)
+        self.assertEqual(self.pipe.frames, [
+            bytes([StreamRegisters.CMD_WRITE, self.reg_rw_12._address, 0x5e, 0x0a]),
+            bytes([StreamRegisters.CMD_READ,  self.reg_rw_12._address]),
+            bytes([StreamRegisters.CMD_READ,  self.reg_ro_24._address]),
+        ])
+
+    def test_pipe_registers(self):
+        asyncio.run(self.do_test_pipe_registers())
+
+    async def do_test_pipe_registers_concurrent(self):
+        # accesses from concurrent tasks must not interleave their frames
+        await asyncio.gather(
+            self.reg_rw_8.set(0x5a),
+            self.reg_rw_12.set(0x123),
+        )
+        self.assertEqual(await asyncio.gather(
+            self.reg_rw_8.get(),
+            self.reg_rw_12.get(),
+            self.reg_ro_24.get(),
+        ), [0x5a, 0x123, 0])
+        self.assertEqual(len(self.pipe.frames), 5)
+
+    def test_pipe_registers_concurrent(self):
+        asyncio.run(self.do_test_pipe_registers_concurrent())
+
+    async def do_test_pipe_registers_cancel(self):
+        # an access cancelled after its command was sent must not desynchronize the framing
+        # of the accesses that follow it
+        await self.reg_rw_12.set(0xa5e)
+        self.pipe.values[self.reg_ro_24._address] = 0x123456
+        self.pipe.responding.clear()
+        read_task = asyncio.ensure_future(self.reg_ro_24.get())
+        while len(self.pipe.frames) < 2:
+            await asyncio.sleep(0)
+        read_task.cancel()
+        with self.assertRaises(asyncio.CancelledError):
+            await read_task
+        self.pipe.responding.set()
+        self.assertEqual(await self.reg_rw_12.get(), 0xa5e)
+        self.assertEqual(self.pipe._output, b"")
+
+    def test_pipe_registers_cancel(self):
+        asyncio.run(self.do_test_pipe_registers_cancel())
@@ -0,0 +1,83 @@
+import unittest
+
+from glasgow.hardware.build_plan import GatewareBuildError, _timing_margin, _split_script, _set_seed
+
+
+# Excerpt of a nextpnr-ice40 log; the timing report is printed once after placement, and once
+# again after routing.
+NEXTPNR_LOG = b"""\
+Info: Program finished normally.
+Info: Running main analytical placer, max placement attempts per cell = 1000000.
+Info: Max frequency for clock 'clk_fx$glb_clk': 79.66 MHz (PASS at 48.00 MHz)
+Info: Max frequency for clock 'clk_sys$glb_clk': 63.12 MHz (PASS at 48.00 MHz)
+Info: Routing globals...
+Info: Routing complete.
+Info: Max frequency for clock 'clk_fx$glb_clk': 71.25 MHz (PASS at 48.00 MHz)
+Info: Max frequency for clock 'clk_sys$glb_clk': 43.20 MHz (FAIL at 48.00 MHz)
+Info: Program finished normally.
+"""
+
+# Build script as emitted by Amaranth for the iCE40 toolchain.
+BUILD_SCRIPT = """\
+# Automatically generated by Amaranth 0.5.4. Do not edit.
+set -e
+[ -n "$AMARANTH_ENV_ICESTORM" ] && . "$AMARANTH_ENV_ICESTORM"
+: ${YOSYS:=yosys}
+: ${NEXTPNR_ICE40:=nextpnr-ice40}
+: ${ICEPACK:=icepack}
+"$YOSYS" -abc9 -l top.rpt top.ys
+"$NEXTPNR_ICE40" --placer heap --log top.tim --hx8k --package bg121 --json top.json \
+--pcf top.pcf --asc top.asc
+"$ICEPACK" top.asc top.bin
+"""
+
+
+class TimingMarginTestCase(unittest.TestCase):
+    def test_post_route(self):
+        # post-route results replace post-placement ones, and the worst clock wins
+        self.assertAlmostEqual(_timing_margin(NEXTPNR_LOG), 43.20 / 48.00)
+
+    def test_pass(self):
+        log = NEXTPNR_LOG.replace(b"43.20 MHz (FAIL", b"50.40 MHz (PASS")
+        self.assertAlmostEqual(_timing_margin(log), 50.40 / 48.00)
+
+    def test_no_report(self):
+        self.assertIsNone(_timing_margin(b"Info: Program finished normally.\n"))
+
+
+class BuildScriptTestCase(unittest.TestCase):
+    def test_split(self):
+        synth_script, pnr_script = _split_script(BUILD_SCRIPT)
+        self.assertIn("top.ys", synth_script)
+        self.assertNotIn("NEXTPNR_ICE40\" ", synth_script)
+        self.assertNotIn("ICEPACK\" ", synth_script)
+        self.assertNotIn("top.ys", pnr_script)
+        self.assertIn("--log top.tim", pnr_script)
+        self.assertIn("\"$ICEPACK\" top.asc top.bin", pnr_script)
+        for script in (synth_script, pnr_script):
+            self.assertTrue(script.startswith("# Automatically generated"))
+            self.assertIn(": ${NEXTPNR_ICE40:=nextpnr-ice40}\n", script)
+
+    def test_split_batch(self):
+        script = BUILD_SCRIPT.replace("top.ys\n", "top.ys || exit /b\n")
+        synth_script, pnr_script = _split_script(script)
+        self.assertIn("top.ys || exit /b", synth_script)
+        self.assertNotIn("top.ys", pnr_script)
+
+    def test_split_wrong(self):
+        with self.assertRaisesRegex(GatewareBuildError,
+                r"^cannot find nextpnr invocation in the build script$"):
+            _split_script(BUILD_SCRIPT.replace("--log top.tim ", ""))
+        with self.assertRaisesRegex(GatewareBuildError,
+                r"^cannot find yosys invocation in the build script$"):
+            _split_script(BUILD_SCRIPT.replace(" top.ys", ""))
+
+    def test_set_seed(self):
+        script = _set_seed(BUILD_SCRIPT, 5)
+        self.assertIn("\"$NEXTPNR_ICE40\" --placer heap --seed 5 --log top.tim --hx8k", script)
+        self.assertEqual(script.count("--seed"), 1)
+
+    def test_set_seed_wrong(self):
+        with self.assertRaisesRegex(GatewareBuildError,
+                r"^cannot find nextpnr invocation in the build script$"):
+            _set_seed(BUILD_SCRIPT.replace("--log top.tim ", ""), 5)
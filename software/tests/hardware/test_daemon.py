@@ -0,0 +1,110 @@
+import asyncio
+import pathlib
+import tempfile
+import unittest
+
+import usb1
+
+from glasgow.hardware.device import GlasgowDeviceError
+from glasgow.hardware.virtual import VirtualDevice
+from glasgow.hardware.daemon import DeviceDaemon, DaemonDevice
+
+
+class DeviceDaemonTestCase(unittest.TestCase):
+    async def do_test_session(self):
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            socket_path = pathlib.Path(tmp_dir) / "daemon.sock"
+            daemon = DeviceDaemon(socket_path)
+            daemon._devices["virtual"] = virtual_device = VirtualDevice()
+            virtual_device.add_loopback(2, 6)
+            server_fut = asyncio.ensure_future(daemon.serve())
+            while not socket_path.exists():
+                await asyncio.sleep(0.01)
+
+            device = await DaemonDevice.connect(socket_path=socket_path)
+            try:
+                self.assertEqual(device.serial, "virtual")
+                self.assertEqual(device.revision, "C3")
+                await device.write_register(3, 0x1234, width=2)
+                self.assertEqual(await device.read_register(3, width=2), 0x1234)
+                await device.bulk_write(2, b"hello")
+                self.assertEqual(await device.bulk_read(6, 512), b"hello")
+                with self.assertRaises(usb1.USBErrorPipe):
+                    await device.bulk_read(8, 512)
+            finally:
+                device.close()
+
+            # The device stays open between sessions.
+            device = await DaemonDevice.connect("virtual", socket_path=socket_path)
+            try:
+                self.assertEqual(await device.read_register(3, width=2), 0x1234)
+                read_fut = asyncio.ensure_future(device.bulk_read(6, 512))
+                await asyncio.sleep(0.01)
+                read_fut.cancel()
+                with self.assertRaises(asyncio.CancelledError):
+                    await read_fut
+            finally:
+                device.close()
+
+            server_fut.cancel()
+            with self.assertRaises(asyncio.CancelledError):
+                await server_fut
+            self.assertFalse(socket_path.exists())
+
+    def test_session(self):
+        asyncio.run(self.do_test_session())
+
+    async def do_test_cancel_before_configure(self):
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            socket_path = pathlib.Path(tmp_dir) / "daemon.sock"
+            daemon = DeviceDaemon(socket_path)
+            daemon._devices["virtual"] = virtual_device = VirtualDevice()
+            virtual_device.add_loopback(2, 6)
+            server_fut = asyncio.ensure_future(daemon.serve())
+            while not socket_path.exists():
+                await asyncio.sleep(0.01)
+
+            in_flight = 0
+            bulk_read = virtual_device.bulk_read
+            async def counting_bulk_read(*args):
+                nonlocal in_flight
+                in_flight += 1
+                try:
+                    return await bulk_read(*args)
+                finally:
+                    in_flight -= 1
+            virtual_device.bulk_read = counting_bulk_read
+            alt_settings = [] # (args, transfers in flight)
+            virtual_device.usb_handle.setInterfaceAltSetting = \
+                lambda *args: alt_settings.append((args, in_flight))
+
+            device = await DaemonDevice.connect(socket_path=socket_path)
+            try:
+                # This is what a pipe does when it is stopped.
+                read_fut = asyncio.ensure_future(device.bulk_read(6, 512))
+                await asyncio.sleep(0.01)
+                self.assertEqual(in_flight, 1)
+                read_fut.cancel()
+                with self.assertRaises(asyncio.CancelledError):
+                    await read_fut
+                device.usb_handle.setInterfaceAltSetting(1, 0)
+                # Configuration requests are not acknowledged; wait for a later transfer instead.
+                await device.read_register(3, width=2)
+                self.assertEqual(alt_settings, [((1, 0), 0)])
+            finally:
+                device.close()
+
+            server_fut.cancel()
+            with self.assertRaises(asyncio.CancelledError):
+                await server_fut
+
+    def test_cancel_before_configure(self):
+        asyncio.run(self.do_test_cancel_before_configure())
+
+    async def do_test_not_running(self):
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            with self.assertRaisesRegex(GlasgowDeviceError, r"not running"):
+                await DaemonDevice.connect(socket_path=pathlib.Path(tmp_dir) / "daemon.sock")
+
+    def test_not_running(self):
+        asyncio.run(self.do_test_not_running())
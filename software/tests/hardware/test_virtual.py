@@ -0,0 +1,62 @@
+import asyncio
+import unittest
+
+from glasgow.hardware.virtual import VirtualDevice, benchmark_pipes
+
+
+class VirtualDeviceTestCase(unittest.TestCase):
+    async def do_test_register(self):
+        device = VirtualDevice()
+        try:
+            await device.write_register(3, 0x1234, width=2)
+            self.assertEqual(await device.read_register(3, width=2), 0x1234)
+        finally:
+            device.close()
+
+    def test_register(self):
+        asyncio.run(self.do_test_register())
+
+    async def do_test_loopback(self):
+        device = VirtualDevice()
+        device.add_loopback(2, 6)
+        try:
+            await device.bulk_write(2, b"hello")
+            self.assertEqual(await device.bulk_read(6, 512), b"hello")
+        finally:
+            device.close()
+
+    def test_loopback(self):
+        asyncio.run(self.do_test_loopback())
+
+    async def do_test_source(self):
+        device = VirtualDevice()
+        device.add_source(6)
+        try:
+            self.assertEqual(len(await device.bulk_read(6, 1024)), 1024)
+        finally:
+            device.close()
+
+    def test_source(self):
+        asyncio.run(self.do_test_source())
+
+
+class BenchmarkPipesTestCase(unittest.TestCase):
+    def do_test_mode(self, mode, tuning):
+        result = asyncio.run(benchmark_pipes(mode=mode, length=1 << 20, tuning=tuning))
+        self.assertEqual(result["length"], (2 if mode == "loopback" else 1) << 20)
+        self.assertGreater(result["elapsed"], 0)
+
+    def test_source(self):
+        for tuning in ("throughput", "latency", "adaptive"):
+            with self.subTest(tuning=tuning):
+                self.do_test_mode("source", tuning)
+
+    def test_sink(self):
+        for tuning in ("throughput", "latency", "adaptive"):
+            with self.subTest(tuning=tuning):
+                self.do_test_mode("sink", tuning)
+
+    def test_loopback(self):
+        for tuning in ("throughput", "latency", "adaptive"):
+            with self.subTest(tuning=tuning):
+                self.do_test_mode("loopback", tuning)
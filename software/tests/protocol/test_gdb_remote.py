@@ -0,0 +1,146 @@
+import re
+import asyncio
+import unittest
+
+from glasgow.protocol.gdb_remote import GDBRemote
+
+
+class MockEndpoint:
+    def __init__(self, commands):
+        self._input  = bytearray()
+        for command in commands:
+            self._input += b"$%s#%02x+" % (command, sum(command) & 0xff)
+        self.responses = []
+
+    async def recv(self, length=0):
+        if not self._input:
+            raise EOFError
+        data, self._input = self._input[:length], self._input[length:]
+        return data
+
+    async def recv_until(self, separator):
+        index = self._input.index(separator)
+        data, self._input = self._input[:index], self._input[index + 1:]
+        return data
+
+    async def send(self, data):
+        if data != b"+":
+            self.responses.append(re.fullmatch(rb"\$(.*)#[0-9a-f]{2}", data, re.S)[1])
+
+
+class MockTarget(GDBRemote):
+    gdb_cache_block_size = 0x10
+
+    def __init__(self):
+        self.memory = bytearray(range(256))
+        self.reads  = []
+        self.writes = []
+
+    def gdb_log(self, level, message, *args):
+        pass
+
+    def target_word_size(self):
+        return 4
+
+    def target_endianness(self):
+        return "little"
+
+    def target_triple(self):
+        return "none"
+
+    def target_features(self):
+        return {}
+
+    def target_running(self):
+        return False
+
+    async def target_stop(self):
+        pass
+
+    async def target_continue(self):
+        pass
+
+    async def target_single_step(self):
+        pass
+
+    async def target_detach(self):
+        pass
+
+    async def target_get_registers(self):
+        return []
+
+    async def target_set_registers(self, values):
+        pass
+
+    async def target_get_register(self, number):
+        return 0
+
+    async def target_set_register(self, number, value):
+        pass
+
+    def target_memory_cacheable(self, address, length):
+        return address + length <= 0x80
+
+    async def target_read_memory(self, address, length):
+        self.reads.append((address, length))
+        return self.memory[address:address + length]
+
+    async def target_write_memory(self, address, data):
+        self.writes.append((address, bytes(data)))
+        self.memory[address:address + len(data)] = data
+
+    async def target_set_software_breakpt(self, address, kind):
+        raise NotImplementedError
+
+    async def target_clear_software_breakpt(self, address, kind):
+        raise NotImplementedError
+
+    async def target_set_instr_breakpt(self, address, kind):
+        raise NotImplementedError
+
+    async def target_clear_instr_breakpt(self, address, kind):
+        raise NotImplementedError
+
+
+class GDBRemoteTestCase(unittest.TestCase):
+    def setUp(self):
+        self.target = MockTarget()
+
+    def run_commands(self, *commands):
+        endpoint = MockEndpoint(commands)
+        asyncio.run(self.target.gdb_run(endpoint))
+        return endpoint.responses
+
+    def test_packet_size(self):
+        response, = self.run_commands(b"qSupported:multiprocess+")
+        self.assertIn(b"PacketSize=4000", response.split(b";"))
+
+    def test_write_binary(self):
+        self.assertEqual(self.run_commands(
+            b"X10,0:",
+            b"X10,5:\x01}\x03}\x5d\x02*",
+            b"X10,2:\x01",
+        ), [b"OK", b"OK", b"E02"])
+        self.assertEqual(self.target.writes, [(0x10, b"\x01#}\x02*")])
+
+    def test_read_cached(self):
+        self.assertEqual(self.run_commands(
+            b"m14,4",
+            b"m18,10",
+            b"m30,4",
+        ), [b"14151617", b"18191a1b1c1d1e1f2021222324252627", b"30313233"])
+        self.assertEqual(self.target.reads, [(0x10, 0x10), (0x20, 0x10), (0x30, 0x10)])
+
+    def test_read_uncacheable(self):
+        self.run_commands(b"m7e,4", b"m7e,4")
+        self.assertEqual(self.target.reads, [(0x7e, 4), (0x7e, 4)])
+
+    def test_invalidate(self):
+        self.assertEqual(self.run_commands(
+            b"m10,1",
+            b"M10,1:aa",
+            b"m10,1",
+            b"s",
+            b"m10,1",
+        ), [b"10", b"OK", b"aa", b"T05thread:0;", b"aa"])
+        self.assertEqual(self.target.reads, [(0x10, 0x10), (0x10, 0x10), (0x10, 0x10)])
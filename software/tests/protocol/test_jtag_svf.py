@@ -63,6 +63,20 @@ class SVFLexerTestCase(unittest.TestCase):
         with self.assertRaises(SVFParsingError):
             SVFLexer("XXX").next()
 
+    def test_bytes(self):
+        self.assertLexes(b"//foo\nSIR 8 TDI (aa) SMASK (IN FOO) 1E6;",
+                         ["SIR", 8, "TDI", bits("10101010"), "SMASK", ("IN FOO",), 1e6, ";"])
+        self.assertLexes(memoryview(b"TRST OFF;"),
+                         ["TRST", "OFF", ";"])
+
+    def test_line_column(self):
+        for source in ("TRST\n  OFF;\n", b"TRST\n  OFF;\n"):
+            lexer = SVFLexer(source)
+            self.assertEqual(lexer.line_column(), (1, 1))
+            self.assertEqual(lexer.line_column(3), (1, 4))
+            self.assertEqual(lexer.line_column(7), (2, 3))
+            self.assertEqual(lexer.line_column(12), (3, 1))
+
 
 class SVFMockEventHandler:
     def __init__(self):
@@ -361,6 +375,14 @@ class SVFParserTestCase(unittest.TestCase):
         parser.parse_command()
         self.assertEqual(parser.last_command(), " SIR 8 TDI (aa);")
 
+    def test_last_command_position(self):
+        handler = SVFMockEventHandler()
+        parser = SVFParser(b" TRST OFF;\n! comment\n  SIR 8 TDI (aa); ", handler)
+        parser.parse_command()
+        self.assertEqual(parser.last_command_position(), 1)
+        parser.parse_command()
+        self.assertEqual(parser.line_column(parser.last_command_position()), (3, 3))
+
 # -------------------------------------------------------------------------------------------------
 
 class SVFPrintingEventHandler:
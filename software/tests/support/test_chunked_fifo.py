@@ -70,6 +70,27 @@ class ChunkedFIFOTestCase(unittest.TestCase):
         self.fifo.read(3)
         self.assertEqual(len(self.fifo), 2)
 
+    def test_read_into(self):
+        self.fifo.write(b"ABCD")
+        self.fifo.write(b"EF")
+        self.fifo.read(1)
+        buffer = bytearray(4)
+        self.assertEqual(self.fifo.read_into(buffer), 4)
+        self.assertEqual(buffer, b"BCDE")
+        self.assertEqual(len(self.fifo), 1)
+        buffer = bytearray(4)
+        self.assertEqual(self.fifo.read_into(buffer), 1)
+        self.assertEqual(buffer, b"F\x00\x00\x00")
+        self.assertFalse(self.fifo)
+
+    def test_read_into_empty(self):
+        buffer = bytearray(2)
+        self.assertEqual(self.fifo.read_into(buffer), 0)
+        self.assertEqual(self.fifo.read_into(bytearray()), 0)
+        self.fifo.write(b"AB")
+        self.assertEqual(self.fifo.read_into(bytearray()), 0)
+        self.assertEqual(len(self.fifo), 2)
+
     def test_write_bits(self):
         self.fifo.write(bits("1010"))
         self.assertEqual(len(self.fifo), 1)
@@ -0,0 +1,33 @@
+import sys
+import unittest
+
+from glasgow.support.import_profile import ImportProfiler
+
+
+class ImportProfilerTestCase(unittest.TestCase):
+    def import_fresh(self, name):
+        for module_name in list(sys.modules):
+            if module_name == name or module_name.startswith(name + "."):
+                del sys.modules[module_name]
+        profiler = ImportProfiler()
+        profiler.install()
+        try:
+            module = __import__(name, fromlist=["*"])
+        finally:
+            profiler.uninstall()
+        return profiler, module
+
+    def test_timing(self):
+        profiler, _ = self.import_fresh("email.mime.text")
+        self.assertNotIn(profiler, sys.meta_path)
+        self.assertIn("email.mime.text", profiler.cum_time)
+        for name, elapsed in profiler.cum_time.items():
+            self.assertGreaterEqual(elapsed, profiler.self_time[name])
+        self.assertAlmostEqual(profiler.total_time, profiler.cum_time["email.mime.text"],
+                               delta=profiler.total_time * 0.5)
+        self.assertLessEqual(len(profiler.top(3)), 3)
+
+    def test_loader_restored(self):
+        _, module = self.import_fresh("email.mime.text")
+        self.assertIs(module.__loader__, module.__spec__.loader)
+        self.assertNotEqual(type(module.__loader__).__name__, "_TimedLoader")
@@ -0,0 +1,32 @@
+import unittest
+
+from glasgow.abstract import PipeTuning
+
+
+class PipeTuningTestCase(unittest.TestCase):
+    def test_cast_profiles(self):
+        self.assertEqual(PipeTuning.cast(None), PipeTuning())
+        self.assertEqual(PipeTuning.cast("throughput"), PipeTuning())
+        self.assertEqual(PipeTuning.cast("latency"),
+                         PipeTuning(packets_per_xfer=4, xfers_per_queue=8))
+        self.assertEqual(PipeTuning.cast("adaptive"), PipeTuning(adaptive=True))
+
+    def test_cast_tuning(self):
+        tuning = PipeTuning(packets_per_xfer=16)
+        self.assertIs(PipeTuning.cast(tuning), tuning)
+
+    def test_cast_wrong(self):
+        with self.assertRaisesRegex(ValueError,
+                r"^'fast' is not a valid pipe tuning profile$"):
+            PipeTuning.cast("fast")
+        with self.assertRaisesRegex(ValueError,
+                r"^4 is not a valid pipe tuning profile$"):
+            PipeTuning.cast(4)
+
+    def test_wrong_values(self):
+        with self.assertRaisesRegex(ValueError,
+                r"^packets per transfer must be positive, not 0$"):
+            PipeTuning(packets_per_xfer=0)
+        with self.assertRaisesRegex(ValueError,
+                r"^transfers per queue must be positive, not -1$"):
+            PipeTuning(xfers_per_queue=-1)